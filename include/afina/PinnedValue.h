@@ -0,0 +1,93 @@
+#ifndef AFINA_PINNED_VALUE_H
+#define AFINA_PINNED_VALUE_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+namespace Afina {
+
+/**
+ * # Immutable view of the stored value
+ * Handle either owns private copy of value bytes or pins bytes living inside of the storage engine. Pinned
+ * bytes stay valid and unchanged after engine lock gets released, engine is notified by release callback
+ * once handle is gone and could reclaim memory then.
+ *
+ * Default constructed handle is null, i.e doesn't reference any value. Handles could be moved but not copied
+ */
+class PinnedValue {
+public:
+    // Drops pin on owner passed into constructor, could be called from any thread
+    using Release = void (*)(void *owner);
+
+    PinnedValue() : _data(nullptr), _size(0), _owner(nullptr), _release(nullptr), _valid(false) {}
+
+    // Takes ownership of the given bytes
+    explicit PinnedValue(std::string value)
+        : _data(nullptr), _size(0), _owner(nullptr), _release(nullptr), _own(std::move(value)), _valid(true) {}
+
+    // Refers bytes pinned by owner, owner's pin is released by the given callback
+    PinnedValue(const char *data, std::size_t size, void *owner, Release release)
+        : _data(data), _size(size), _owner(owner), _release(release), _valid(true) {}
+
+    PinnedValue(PinnedValue &&other)
+        : _data(other._data), _size(other._size), _owner(other._owner), _release(other._release),
+          _own(std::move(other._own)), _valid(other._valid) {
+        other._release = nullptr;
+        other._valid = false;
+    }
+
+    PinnedValue &operator=(PinnedValue &&other) {
+        if (this != &other) {
+            reset();
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            std::swap(_owner, other._owner);
+            std::swap(_release, other._release);
+            std::swap(_own, other._own);
+            std::swap(_valid, other._valid);
+        }
+        return *this;
+    }
+
+    ~PinnedValue() { reset(); }
+
+    const char *data() const { return _release != nullptr ? _data : _own.data(); }
+    std::size_t size() const { return _release != nullptr ? _size : _own.size(); }
+
+    // Returns true if handle references some value
+    explicit operator bool() const { return _valid; }
+
+    std::string str() const { return std::string(data(), size()); }
+
+    // Drops referenced value, handle becomes null
+    void reset() {
+        if (_release != nullptr) {
+            _release(_owner);
+        }
+        _data = nullptr;
+        _size = 0;
+        _owner = nullptr;
+        _release = nullptr;
+        _own.clear();
+        _valid = false;
+    }
+
+private:
+    PinnedValue(const PinnedValue &);            // = delete;
+    PinnedValue &operator=(const PinnedValue &); // = delete;
+
+    const char *_data;
+    std::size_t _size;
+    void *_owner;
+    Release _release;
+
+    // Private copy of value, used if there is no owner
+    std::string _own;
+
+    bool _valid;
+};
+
+} // namespace Afina
+
+#endif // AFINA_PINNED_VALUE_H
@@ -1,7 +1,15 @@
 #ifndef AFINA_STORAGE_H
 #define AFINA_STORAGE_H
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <afina/PinnedValue.h>
 
 namespace Afina {
 
@@ -23,12 +31,22 @@ public:
      *
      * Method returns true if success and false in case of any error. Once
      * method returns true any subsequent access to storage must indicates that
-     * key->value association exists
+     * key->value association exists, until it expires
      *
      * @param key to be associated with value
      * @param value to be assigned for the key
+     * @param ttl number of seconds association lives for, 0 means forever and negative value means it
+     *        expires right away
      */
-    virtual bool Put(const std::string &key, const std::string &value) = 0;
+    virtual bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) = 0;
+
+    /**
+     * Same as Put, but storage could take value over instead of copying it, so that large value read off
+     * the network is stored without another copy. Value is left unspecified then
+     *
+     * Default implementation calls Put above
+     */
+    virtual bool Put(const std::string &key, std::string &&value, int32_t ttl = 0) { return Put(key, value, ttl); }
 
     /**
      * Stores association between given key/value pair if key isn't present in
@@ -40,8 +58,16 @@ public:
      *
      * @param key to be associated with value
      * @param value to be assigned for the key
+     * @param ttl number of seconds association lives for, see Put
+     */
+    virtual bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) = 0;
+
+    /**
+     * Same as PutIfAbsent, but value could be taken over, see Put
      */
-    virtual bool PutIfAbsent(const std::string &key, const std::string &value) = 0;
+    virtual bool PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl = 0) {
+        return PutIfAbsent(key, value, ttl);
+    }
 
     /**
      * Updates existing association between given key/value pair
@@ -53,8 +79,14 @@ public:
      *
      * @param key to be associated with value
      * @param value to be assigned for the key
+     * @param ttl number of seconds updated association lives for, see Put
+     */
+    virtual bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) = 0;
+
+    /**
+     * Same as Set, but value could be taken over, see Put
      */
-    virtual bool Set(const std::string &key, const std::string &value) = 0;
+    virtual bool Set(const std::string &key, std::string &&value, int32_t ttl = 0) { return Set(key, value, ttl); }
 
     /**
      * Removes association for the given key
@@ -84,6 +116,298 @@ public:
      * @param value output parameter to copy value to
      */
     virtual bool Get(const std::string &key, std::string &value) = 0;
+
+    /**
+     * Retrive value for the given key without copying it
+     * If there is an association for the given key then method sets output parameter to the immutable
+     * view of the value and returns true. View stays valid after method returns, even if key gets
+     * updated or deleted later, so it could be sent to the network directly.
+     *
+     * In case if given key not found method returns false and doesn't perform any changes on the output
+     * parameter
+     *
+     * Default implementation copies value once by Get, engines could override it to pin value in place
+     *
+     * @param key to retrive value for
+     * @param value output parameter to put value view into
+     */
+    virtual bool GetPinned(const std::string &key, PinnedValue &value) {
+        std::string copy;
+        if (!Get(key, copy)) {
+            return false;
+        }
+        value = PinnedValue(std::move(copy));
+        return true;
+    }
+
+    /**
+     * Retrive value for the given key along with its version, see GetPinned
+     * Each store of the key gives it a new non-zero version, which is passed to CompareAndSet later to
+     * make sure key wasn't changed in between
+     *
+     * Default implementation calls GetPinned and reports version 0, that is engine has no versions
+     *
+     * @param key to retrive value for
+     * @param value output parameter to put value view into
+     * @param cas output parameter to put value version into
+     */
+    virtual bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) {
+        cas = 0;
+        return GetPinned(key, value);
+    }
+
+    /**
+     * Result of CompareAndSet:
+     * - Stored: value was replaced
+     * - Exists: key was changed since version was retrived
+     * - NotFound: key doesn't present in storage
+     * - NotStored: value can't be stored, i.e it is too large
+     */
+    enum class CasResult { Stored, Exists, NotFound, NotStored };
+
+    /**
+     * Updates existing association only if it still has the given version, see GetCas and Set
+     *
+     * Default implementation throws std::runtime_error, as engine has no versions
+     *
+     * @param key to be associated with value
+     * @param value to be assigned for the key
+     * @param cas version association must have
+     * @param ttl number of seconds updated association lives for, see Put
+     */
+    virtual CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                                    int32_t ttl = 0) {
+        throw std::runtime_error("Storage doesn't support cas");
+    }
+
+    /**
+     * Same as CompareAndSet, but value could be taken over, see Put
+     */
+    virtual CasResult CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl = 0) {
+        return CompareAndSet(key, value, cas, ttl);
+    }
+
+    /**
+     * Adds data to the end of the existing value
+     * If requested key doesn't present in storage method returns false and doesnt change anything.
+     * Expiration time of the association stays the same, its version changes, see GetCas
+     *
+     * Default implementation is neither atomic nor keeps expiration time: it reads value by Get and stores
+     * concatenation by Set. Engines override it to grow value in place
+     *
+     * @param key to be updated
+     * @param data to be added to the value
+     */
+    virtual bool Append(const std::string &key, const std::string &data) {
+        std::string value;
+        return Get(key, value) && Set(key, value + data);
+    }
+
+    /**
+     * Adds data to the beginning of the existing value, see Append
+     *
+     * @param key to be updated
+     * @param data to be added to the value
+     */
+    virtual bool Prepend(const std::string &key, const std::string &data) {
+        std::string value;
+        return Get(key, value) && Set(key, data + value);
+    }
+
+    /**
+     * Result of Incr and Decr:
+     * - Stored: counter was updated
+     * - NotFound: key doesn't present in storage
+     * - NotNumber: value isn't a decimal number which fits into 64 bits
+     * - NotStored: updated value can't be stored, i.e storage is too small
+     */
+    enum class CounterResult { Stored, NotFound, NotNumber, NotStored };
+
+    /**
+     * Adds delta to the counter kept as decimal value, wrapping around at 2^64 as memcached does.
+     * Expiration time of the association stays the same, its version changes, see GetCas
+     *
+     * Default implementation is neither atomic nor keeps expiration time, see Append. Engines override it
+     * to update value under a single lookup
+     *
+     * @param key to be updated
+     * @param delta to add to the counter
+     * @param value output parameter to put updated counter into
+     */
+    virtual CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) {
+        return _counter(key, delta, false, value);
+    }
+
+    /**
+     * Subtracts delta from the counter, see Incr. Counter never goes below 0
+     *
+     * @param key to be updated
+     * @param delta to subtract from the counter
+     * @param value output parameter to put updated counter into
+     */
+    virtual CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) {
+        return _counter(key, delta, true, value);
+    }
+
+    /**
+     * Retrive values for the given keys at once, see GetPinned
+     * Output parameter gets one handle per key in the same order, handle of the key not found is null.
+     *
+     * Default implementation calls GetPinned or GetCas for each key, engines could override it to group
+     * keys and take each lock once per batch
+     *
+     * @param keys to retrive values for
+     * @param values output parameter to put value views into
+     * @param cas optional output parameter to put value versions into, see GetCas
+     */
+    virtual void MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                          std::vector<uint64_t> *cas = nullptr) {
+        values.clear();
+        values.resize(keys.size());
+        if (cas != nullptr) {
+            cas->assign(keys.size(), 0);
+        }
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            if (cas != nullptr) {
+                GetCas(keys[i], values[i], (*cas)[i]);
+            } else {
+                GetPinned(keys[i], values[i]);
+            }
+        }
+    }
+
+    /**
+     * Stores given key/value pairs at once, see Put
+     * Pairs are stored in the given order, so the last one wins if key repeats.
+     *
+     * Default implementation calls Put for each pair
+     *
+     * @param items key/value pairs to store
+     * @param ttl number of seconds each association lives for, see Put
+     * @return number of pairs stored successfully
+     */
+    virtual std::size_t MultiPut(const std::vector<std::pair<std::string, std::string>> &items,
+                                 int32_t ttl = 0) {
+        std::size_t stored = 0;
+        for (auto &item : items) {
+            stored += Put(item.first, item.second, ttl);
+        }
+        return stored;
+    }
+
+    /**
+     * Removes associations for the given keys at once, see Delete
+     *
+     * Default implementation calls Delete for each key
+     *
+     * @param keys to be removed
+     * @return number of associations removed
+     */
+    virtual std::size_t MultiDelete(const std::vector<std::string> &keys) {
+        std::size_t deleted = 0;
+        for (auto &key : keys) {
+            deleted += Delete(key);
+        }
+        return deleted;
+    }
+
+    /**
+     * Appends storage statistics as name/value pairs, names follow memcached "stats" command where
+     * possible
+     *
+     * Default implementation reports nothing
+     *
+     * @param stats output parameter to append statistics to
+     */
+    virtual void GetStats(std::vector<std::pair<std::string, std::string>> &stats) {}
+
+    /**
+     * Receives stored associations one by one, ttl is number of seconds association has left to live or 0
+     * if it never expires
+     */
+    using Visitor = std::function<void(const char *key, std::size_t key_size, const char *value,
+                                       std::size_t value_size, int32_t ttl)>;
+
+    /**
+     * Passes every live association into visitor, least recently used first, so that putting them into
+     * empty storage in the same order restores eviction order as well.
+     *
+     * Method takes no locks: caller must guarantee storage doesn't change meanwhile, for example by
+     * scanning a copy of the process made by fork under Freeze
+     *
+     * Default implementation returns false, that is storage can't be scanned
+     *
+     * @param visitor callback to pass associations into
+     */
+    virtual bool Scan(const Visitor &visitor) { return false; }
+
+    /**
+     * Calls action while no other call changes storage, storage is in consistent state then
+     *
+     * Default implementation just calls action, that is enough for storages which aren't thread safe
+     *
+     * @param action callback to call, must not access storage through its public methods
+     */
+    virtual void Freeze(const std::function<void()> &action) { action(); }
+
+    /**
+     * Changes memory limit of running storage. Growth takes effect at once, on shrink items are evicted
+     * in small slices, so that concurrent calls keep being served. Returns once storage fits new limit
+     *
+     * Default implementation returns false, that is storage can't be resized
+     *
+     * @param memory_limit new number of bytes storage could take
+     */
+    virtual bool Resize(std::size_t memory_limit) { return false; }
+
+    /**
+     * Changes number of shards of running storage. Keys move to new shards in small batches while
+     * concurrent calls keep being served. Returns once all keys are moved
+     *
+     * Default implementation returns false, that is storage isn't sharded
+     *
+     * @param shard_count new number of shards
+     */
+    virtual bool Reshard(std::size_t shard_count) { return false; }
+
+protected:
+    /**
+     * Parses counter value and applies delta to it, see Incr and Decr. Returns false if value isn't a
+     * counter
+     */
+    static bool Count(const char *data, std::size_t size, uint64_t delta, bool decrement, uint64_t &value) {
+        if (size == 0 || size > 20) {
+            return false;
+        }
+
+        uint64_t counter = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            unsigned digit = static_cast<unsigned char>(data[i]) - '0';
+            if (digit > 9 || counter > (UINT64_MAX - digit) / 10) {
+                return false;
+            }
+            counter = counter * 10 + digit;
+        }
+
+        if (decrement) {
+            value = counter > delta ? counter - delta : 0;
+        } else {
+            value = counter + delta;
+        }
+        return true;
+    }
+
+private:
+    CounterResult _counter(const std::string &key, uint64_t delta, bool decrement, uint64_t &value) {
+        std::string current;
+        if (!Get(key, current)) {
+            return CounterResult::NotFound;
+        }
+        if (!Count(current.data(), current.size(), delta, decrement, value)) {
+            return CounterResult::NotNumber;
+        }
+        return Set(key, std::to_string(value)) ? CounterResult::Stored : CounterResult::NotStored;
+    }
 };
 
 } // namespace Afina
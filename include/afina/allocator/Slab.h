@@ -0,0 +1,134 @@
+#ifndef AFINA_ALLOCATOR_SLAB_H
+#define AFINA_ALLOCATOR_SLAB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Afina {
+namespace Allocator {
+
+/**
+ * # Slab allocator
+ * Wraps given memory area and splits it into pages of equal size. Each page belongs to at most one size class
+ * and is carved into chunks of the class size, chunk sizes grow geometrically from the minimal one up to
+ * the page size. Allocation and free are O(1) pops and pushes of the class free list, so there is no
+ * external fragmentation: free chunk is always reusable by the next allocation of the same class.
+ *
+ * Pages are taken by classes on demand. Once all pages are taken, class could get more memory only if some
+ * page is moved to it from another class, see reclaim.
+ *
+ * Allocator instance doesn't take ownership of wrapped memory and do not delete it on destruction, as Simple
+ * does. Not thread safe
+ */
+class Slab {
+public:
+    /**
+     * @param base memory area to allocate from
+     * @param size number of bytes in the area, rest of the last page is not used
+     * @param page_size number of bytes in a page, also the largest chunk size
+     * @param min_chunk size of the smallest chunk
+     * @param factor growth factor of chunk sizes
+     */
+    Slab(void *base, size_t size, size_t page_size = 1024 * 1024, size_t min_chunk = 64, double factor = 1.25);
+
+    /**
+     * Returns number of size classes
+     */
+    size_t classes() const { return _classes.size(); }
+
+    /**
+     * Returns chunk size of the class
+     */
+    size_t chunk_size(unsigned cls) const { return _classes[cls].chunk_size; }
+
+    /**
+     * Returns the smallest class able to keep given number of bytes, or -1 if it is larger than page
+     */
+    int class_of(size_t size) const;
+
+    /**
+     * Returns class of the chunk allocated by alloc
+     */
+    unsigned class_of(const void *p) const { return _pages[_page_of(p)].cls; }
+
+    /**
+     * Allocates chunk of the class. Returns nullptr if class has no free chunks and there are no free pages,
+     * memory is full then and caller should free some chunks or reclaim a page for this class
+     */
+    void *alloc(unsigned cls);
+
+    /**
+     * Returns chunk allocated by alloc back to its class
+     */
+    void free(void *p);
+
+    /**
+     * Moves page of the class into pool of free pages, so that any class could take it. Page with the
+     * least number of used chunks is taken, each chunk of the page in use is passed into release callback,
+     * which must free it.
+     *
+     * Returns false if class has no pages
+     */
+    bool reclaim(unsigned cls, const std::function<void(void *)> &release);
+
+    /**
+     * Returns number of pages taken by the class
+     */
+    size_t pages(unsigned cls) const { return _classes[cls].pages; }
+
+    /**
+     * Returns number of chunks of the class in use
+     */
+    size_t used(unsigned cls) const { return _classes[cls].used; }
+
+    /**
+     * Returns number of chunks of the class single page keeps
+     */
+    size_t per_page(unsigned cls) const { return _page_size / _classes[cls].chunk_size; }
+
+    /**
+     * Returns number of pages not taken by any class
+     */
+    size_t free_pages() const { return _free_pages.size(); }
+
+    size_t page_size() const { return _page_size; }
+
+    /**
+     * Returns human readable state of all classes
+     */
+    std::string dump() const;
+
+private:
+    struct Class {
+        size_t chunk_size;
+        size_t pages;
+        size_t used;
+        // singly linked list over the first word of free chunks
+        void *free_list;
+    };
+
+    struct Page {
+        // owning class, -1 if page is free
+        int cls;
+        // page is being reclaimed, chunks freed into it are dropped
+        bool draining;
+        uint32_t used;
+    };
+
+    size_t _page_of(const void *p) const { return (static_cast<const char *>(p) - _base) / _page_size; }
+
+    char *_base;
+    const size_t _page_size;
+
+    std::vector<Class> _classes;
+    std::vector<Page> _pages;
+    std::vector<size_t> _free_pages;
+};
+
+} // namespace Allocator
+} // namespace Afina
+
+#endif // AFINA_ALLOCATOR_SLAB_H
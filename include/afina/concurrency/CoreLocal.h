@@ -1,10 +1,150 @@
 #ifndef AFINA_CONCURRENCY_CORE_LOCAL_H
 #define AFINA_CONCURRENCY_CORE_LOCAL_H
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
 namespace Afina {
 namespace Concurrency {
 
-template <typename T> class CoreLocal {};
+/**
+ * # Instance per CPU core
+ * Keeps one instance of T per core, each one on its own cache lines. Thread works with instance of the
+ * core it runs on, so threads of different cores never touch the same memory. Scheduler could migrate
+ * thread at any moment though, so instance isn't exclusive: it only makes contention unlikely, T must
+ * still be synchronized
+ */
+template <typename T> class CoreLocal {
+public:
+    /**
+     * Creates instance for each of size cores, passing args to every constructor
+     */
+    template <typename... Args> explicit CoreLocal(std::size_t size, Args &&... args) {
+        _cells.reserve(size);
+        for (std::size_t i = 0; i < size; i++) {
+            _cells.emplace_back(new Cell(args...));
+        }
+    }
+
+    /**
+     * Returns instance of the core calling thread runs on
+     */
+    T &local() { return _cells[current() % _cells.size()]->value; }
+
+    T &operator[](std::size_t core) { return _cells[core]->value; }
+
+    std::size_t size() const { return _cells.size(); }
+
+    /**
+     * Returns number of cores, at least 1
+     */
+    static std::size_t cores() {
+        unsigned count = std::thread::hardware_concurrency();
+        return count > 0 ? count : 1;
+    }
+
+    /**
+     * Returns number of the core calling thread runs on now
+     */
+    static std::size_t current() {
+        int cpu = sched_getcpu();
+        return cpu >= 0 ? cpu : 0;
+    }
+
+    /**
+     * Binds calling thread to the given core, returns false if it is not possible
+     */
+    static bool pin(std::size_t core) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core % cores(), &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+private:
+    CoreLocal(const CoreLocal &);            // = delete;
+    CoreLocal &operator=(const CoreLocal &); // = delete;
+
+    // Padding on both sides keeps neighbour allocations off the instance cache lines
+    struct Cell {
+        char before[64];
+        T value;
+        char after[64];
+
+        template <typename... Args> explicit Cell(Args &&... args) : value(std::forward<Args>(args)...) {}
+    };
+
+    std::vector<std::unique_ptr<Cell>> _cells;
+};
+
+/**
+ * # Bounded single producer single consumer queue
+ * Wait free ring of pointers: exactly one thread pushes and exactly one thread pops at a time. Head and
+ * tail live on different cache lines, so producer and consumer only share lines of the slots they pass
+ */
+template <typename T> class SpscRing {
+public:
+    /**
+     * @param capacity number of slots, rounded up to power of two
+     */
+    explicit SpscRing(std::size_t capacity) : _head(0), _tail(0) {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        _mask = size - 1;
+        _slots.reset(new T *[size]);
+    }
+
+    /**
+     * Called by producer, returns false if ring is full
+     */
+    bool push(T *item) {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) > _mask) {
+            return false;
+        }
+        _slots[tail & _mask] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Called by consumer, returns nullptr if ring is empty
+     */
+    T *pop() {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        T *item = _slots[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        return item;
+    }
+
+    bool empty() const { return _head.load(std::memory_order_seq_cst) == _tail.load(std::memory_order_seq_cst); }
+
+private:
+    SpscRing(const SpscRing &);            // = delete;
+    SpscRing &operator=(const SpscRing &); // = delete;
+
+    // Written by consumer
+    std::atomic<std::size_t> _head;
+    char _head_padding[64 - sizeof(std::atomic<std::size_t>)];
+    // Written by producer
+    std::atomic<std::size_t> _tail;
+    char _tail_padding[64 - sizeof(std::atomic<std::size_t>)];
+
+    std::size_t _mask;
+    std::unique_ptr<T *[]> _slots;
+};
 
 } // namespace Concurrency
 } // namespace Afina
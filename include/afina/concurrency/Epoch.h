@@ -0,0 +1,156 @@
+#ifndef AFINA_CONCURRENCY_EPOCH_H
+#define AFINA_CONCURRENCY_EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Afina {
+namespace Concurrency {
+
+/**
+ * # Epoch based memory reclamation
+ * Readers traverse shared structure inside of Guard and never block. Writer unlinks object so that new
+ * readers can't reach it, and retires it into Limbo stamped with the current epoch. Object is freed once
+ * epoch advanced twice since then: advance from e to e + 1 takes place only when no reader entered in
+ * e - 1 is still inside, so readers which could have seen the object are all gone by then.
+ *
+ * Readers are counted in a fixed number of cache line sized slots picked by thread id, two counters per
+ * slot for odd and even epochs. Threads could share a slot, counter just gets larger, so there is no
+ * thread registration. Reader section must be short: it delays reclamation, not writers
+ */
+class Epoch {
+    struct Slot;
+
+public:
+    Epoch() : _epoch(2) {
+        for (auto &slot : _slots) {
+            slot.readers[0].store(0, std::memory_order_relaxed);
+            slot.readers[1].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * # Reader section
+     * Objects reached while guard is alive stay valid until it is destroyed
+     */
+    class Guard {
+    public:
+        explicit Guard(Epoch &epoch) : _slot(epoch._slots[_slot_index()]) {
+            // Recheck makes sure reader is counted in the epoch it has seen, otherwise advance could miss it
+            for (;;) {
+                uint64_t e = epoch._epoch.load(std::memory_order_seq_cst);
+                _parity = e & 1;
+                _slot.readers[_parity].fetch_add(1, std::memory_order_seq_cst);
+                if (epoch._epoch.load(std::memory_order_seq_cst) == e) {
+                    break;
+                }
+                _slot.readers[_parity].fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        ~Guard() { _slot.readers[_parity].fetch_sub(1, std::memory_order_release); }
+
+    private:
+        Guard(const Guard &);            // = delete;
+        Guard &operator=(const Guard &); // = delete;
+
+        Slot &_slot;
+        unsigned _parity;
+    };
+
+    /**
+     * Returns current epoch, objects get retired with it
+     */
+    uint64_t current() const {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return _epoch.load(std::memory_order_seq_cst);
+    }
+
+    /**
+     * Moves epoch forward if no reader of the previous one is still inside. Never blocks, returns current
+     * epoch after the attempt
+     */
+    uint64_t advance() {
+        uint64_t e = _epoch.load(std::memory_order_seq_cst);
+        unsigned previous = (e + 1) & 1;
+        for (auto &slot : _slots) {
+            if (slot.readers[previous].load(std::memory_order_seq_cst) != 0) {
+                return e;
+            }
+        }
+        _epoch.compare_exchange_strong(e, e + 1, std::memory_order_seq_cst);
+        return _epoch.load(std::memory_order_seq_cst);
+    }
+
+private:
+    Epoch(const Epoch &);            // = delete;
+    Epoch &operator=(const Epoch &); // = delete;
+
+    static constexpr std::size_t _slot_count = 64;
+
+    // Slot takes whole cache line, so readers of different slots don't bounce it
+    struct Slot {
+        std::atomic<uint32_t> readers[2];
+        char padding[64 - 2 * sizeof(std::atomic<uint32_t>)];
+    };
+
+    static std::size_t _slot_index() {
+        static thread_local std::size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % _slot_count;
+        return index;
+    }
+
+    std::atomic<uint64_t> _epoch;
+    Slot _slots[_slot_count];
+};
+
+/**
+ * # Objects retired but not freed yet
+ * Not thread safe, each writer keeps its own one or guards it by lock it already holds
+ */
+template <typename T> class Limbo {
+public:
+    /**
+     * Adds object unlinked at the given epoch, see Epoch#current
+     */
+    void retire(T *object, uint64_t epoch) { _objects.emplace_back(object, epoch); }
+
+    /**
+     * Passes objects which can't be reached by readers anymore into free, epoch is the current one
+     */
+    template <typename Free> void reclaim(uint64_t epoch, Free free) {
+        std::size_t kept = 0;
+        for (auto &object : _objects) {
+            if (object.second + 2 <= epoch) {
+                free(object.first);
+            } else {
+                _objects[kept++] = object;
+            }
+        }
+        _objects.resize(kept);
+    }
+
+    /**
+     * Passes all objects into free, no reader must be active
+     */
+    template <typename Free> void clear(Free free) {
+        for (auto &object : _objects) {
+            free(object.first);
+        }
+        _objects.clear();
+    }
+
+    std::size_t size() const { return _objects.size(); }
+
+private:
+    std::vector<std::pair<T *, uint64_t>> _objects;
+};
+
+} // namespace Concurrency
+} // namespace Afina
+
+#endif // AFINA_CONCURRENCY_EPOCH_H
@@ -1,10 +1,153 @@
 #ifndef AFINA_CONCURRENCY_FLAT_COMBINE_H
 #define AFINA_CONCURRENCY_FLAT_COMBINE_H
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <afina/concurrency/SpinLock.h>
+#include <afina/concurrency/ThreadLocal.h>
+
 namespace Afina {
 namespace Concurrency {
 
-template <typename Op> class FlatCombine {};
+/**
+ * # Flat combining
+ * Serializes operations on a sequential structure without each thread taking the lock in turn. Thread
+ * publishes its operation in its own slot and then either waits until somebody applies it, or takes the
+ * lock and becomes the combiner: the one applying pending operations of all slots in a batch. Lock and
+ * structure stay in the cache of the combiner for the whole batch instead of bouncing between cores with
+ * every operation.
+ *
+ * Operations are applied one by one in some order, so structure sees the same sequence as under a plain
+ * lock. Op is applied by the given function in the thread of combiner, that function must not throw.
+ *
+ * Slot is claimed by thread on its first operation and released once the thread exits, then it could be
+ * claimed by another thread. Slots are never freed before FlatCombine is destroyed, so combiner could scan
+ * them without locks
+ */
+template <typename Op> class FlatCombine {
+public:
+    explicit FlatCombine(std::function<void(Op &)> apply)
+        : _apply(std::move(apply)), _handles([this]() { return new Handle(_claim()); }) {}
+
+    /**
+     * Applies op and returns once it is done, either by calling thread or by another one
+     */
+    void Apply(Op &op) {
+        Slot &slot = *_handles.local().slot;
+        slot.pending.store(&op, std::memory_order_release);
+
+        for (unsigned spins = 0; slot.pending.load(std::memory_order_acquire) != nullptr;) {
+            if (_lock.try_lock()) {
+                // own slot is scanned as well, so op is done once combiner is
+                _combine();
+                _lock.unlock();
+            } else if (++spins % 1024 == 0) {
+                std::this_thread::yield();
+            } else {
+                _pause();
+            }
+        }
+    }
+
+    /**
+     * Calls action with no operations running, operations published meanwhile wait until it returns
+     */
+    void Exclusive(const std::function<void()> &action) {
+        std::lock_guard<SpinLock> lock(_lock);
+        action();
+    }
+
+private:
+    FlatCombine(const FlatCombine &);            // = delete;
+    FlatCombine &operator=(const FlatCombine &); // = delete;
+
+    // Publication slot of one thread
+    struct Slot {
+        // Operation waiting to be applied, reset by combiner once it is done
+        std::atomic<Op *> pending;
+        // Set while slot is claimed by a thread
+        std::atomic<bool> claimed;
+        // Slots are only pushed at the list head and never unlinked
+        Slot *next;
+        // keeps neighbour allocations off the cache line owner thread and combiner pass it through
+        char padding[64];
+
+        Slot() : pending(nullptr), claimed(true), next(nullptr) {}
+    };
+
+    // Frees slots when FlatCombine is gone, once handles are released
+    struct Slots {
+        std::atomic<Slot *> head;
+
+        Slots() : head(nullptr) {}
+        ~Slots() {
+            for (Slot *slot = head.load(); slot != nullptr;) {
+                Slot *next = slot->next;
+                delete slot;
+                slot = next;
+            }
+        }
+    };
+
+    // Thread local claim of a slot
+    struct Handle {
+        Slot *slot;
+
+        explicit Handle(Slot *slot) : slot(slot) {}
+        ~Handle() { slot->claimed.store(false, std::memory_order_release); }
+    };
+
+    // Number of scans of all slots by combiner at most, threads often come back with the next operation
+    // while the batch is being applied
+    static constexpr unsigned _passes = 4;
+
+    Slot *_claim() {
+        for (Slot *slot = _slots.head.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            bool claimed = false;
+            if (!slot->claimed.load(std::memory_order_relaxed) &&
+                slot->claimed.compare_exchange_strong(claimed, true, std::memory_order_acquire)) {
+                return slot;
+            }
+        }
+
+        Slot *slot = new Slot();
+        slot->next = _slots.head.load(std::memory_order_relaxed);
+        while (!_slots.head.compare_exchange_weak(slot->next, slot, std::memory_order_acq_rel)) {
+        }
+        return slot;
+    }
+
+    void _combine() {
+        for (unsigned pass = 0; pass < _passes; pass++) {
+            bool applied = false;
+            for (Slot *slot = _slots.head.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+                Op *op = slot->pending.load(std::memory_order_acquire);
+                if (op != nullptr) {
+                    _apply(*op);
+                    slot->pending.store(nullptr, std::memory_order_release);
+                    applied = true;
+                }
+            }
+            if (!applied) {
+                break;
+            }
+        }
+    }
+
+    static void _pause() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    std::function<void(Op &)> _apply;
+    SpinLock _lock;
+    Slots _slots;
+    ThreadLocal<Handle> _handles;
+};
 
 } // namespace Concurrency
 } // namespace Afina
@@ -0,0 +1,65 @@
+#ifndef AFINA_CONCURRENCY_SHARED_MUTEX_H
+#define AFINA_CONCURRENCY_SHARED_MUTEX_H
+
+#include <pthread.h>
+#include <stdexcept>
+
+namespace Afina {
+namespace Concurrency {
+
+/**
+ * # Reader-writer lock
+ * Thin wrapper over pthread rwlock with the same interface as C++17 std::shared_mutex. Writers are
+ * preferred where platform supports it, so stream of readers doesn't starve them
+ */
+class SharedMutex {
+public:
+    SharedMutex() {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+#ifdef PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+        int err = pthread_rwlock_init(&_lock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+        if (err != 0) {
+            throw std::runtime_error("Failed to create rwlock");
+        }
+    }
+
+    ~SharedMutex() { pthread_rwlock_destroy(&_lock); }
+
+    void lock() { pthread_rwlock_wrlock(&_lock); }
+    bool try_lock() { return pthread_rwlock_trywrlock(&_lock) == 0; }
+    void unlock() { pthread_rwlock_unlock(&_lock); }
+
+    void lock_shared() { pthread_rwlock_rdlock(&_lock); }
+    bool try_lock_shared() { return pthread_rwlock_tryrdlock(&_lock) == 0; }
+    void unlock_shared() { pthread_rwlock_unlock(&_lock); }
+
+private:
+    SharedMutex(const SharedMutex &);            // = delete;
+    SharedMutex &operator=(const SharedMutex &); // = delete;
+
+    pthread_rwlock_t _lock;
+};
+
+/**
+ * # RAII holder of shared ownership, like C++14 std::shared_lock
+ */
+template <typename Mutex> class SharedLockGuard {
+public:
+    explicit SharedLockGuard(Mutex &m) : _m(m) { _m.lock_shared(); }
+    ~SharedLockGuard() { _m.unlock_shared(); }
+
+private:
+    SharedLockGuard(const SharedLockGuard &);            // = delete;
+    SharedLockGuard &operator=(const SharedLockGuard &); // = delete;
+
+    Mutex &_m;
+};
+
+} // namespace Concurrency
+} // namespace Afina
+
+#endif // AFINA_CONCURRENCY_SHARED_MUTEX_H
@@ -0,0 +1,54 @@
+#ifndef AFINA_CONCURRENCY_SPIN_LOCK_H
+#define AFINA_CONCURRENCY_SPIN_LOCK_H
+
+#include <atomic>
+#include <thread>
+
+namespace Afina {
+namespace Concurrency {
+
+/**
+ * # Test-and-test-and-set spin lock
+ * Meets Lockable requirements, so could be used with std::lock_guard. Good for very short critical
+ * sections only, waiting thread burns CPU
+ */
+class SpinLock {
+public:
+    SpinLock() : _locked(false) {}
+
+    void lock() {
+        for (unsigned spins = 0; _locked.exchange(true, std::memory_order_acquire);) {
+            // Wait on local cache line copy until lock looks free, so that waiters don't bounce it
+            while (_locked.load(std::memory_order_relaxed)) {
+                if (++spins % 1024 == 0) {
+                    std::this_thread::yield();
+                } else {
+                    pause();
+                }
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !_locked.load(std::memory_order_relaxed) && !_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() { _locked.store(false, std::memory_order_release); }
+
+private:
+    SpinLock(const SpinLock &);            // = delete;
+    SpinLock &operator=(const SpinLock &); // = delete;
+
+    static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    std::atomic<bool> _locked;
+};
+
+} // namespace Concurrency
+} // namespace Afina
+
+#endif // AFINA_CONCURRENCY_SPIN_LOCK_H
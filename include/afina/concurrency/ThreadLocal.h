@@ -1,10 +1,96 @@
 #ifndef AFINA_CONCURRENCY_THREAD_LOCAL_H
 #define AFINA_CONCURRENCY_THREAD_LOCAL_H
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+
+#include <pthread.h>
+
 namespace Afina {
 namespace Concurrency {
 
-template <typename T> class ThreadLocal {};
+/**
+ * # Instance per thread
+ * Keeps one instance of T for each thread that uses it, so unlike thread_local it could be a member of
+ * an object. Instance is made by the given factory on the first local() call of a thread and destroyed
+ * once the thread exits or ThreadLocal is destroyed, whichever comes first.
+ *
+ * Instance is exclusive to its thread, but for_each could visit it from another one, so anything it reads
+ * must be synchronized. ThreadLocal must not be destroyed while other threads use it
+ */
+template <typename T> class ThreadLocal {
+public:
+    explicit ThreadLocal(std::function<T *()> make = []() { return new T(); }) : _make(std::move(make)) {
+        if (pthread_key_create(&_key, &ThreadLocal::_release) != 0) {
+            throw std::runtime_error("Failed to create thread key");
+        }
+    }
+
+    ~ThreadLocal() {
+        // destructors of threads still running aren't called after the key is gone
+        pthread_key_delete(_key);
+        for (Cell *cell : _cells) {
+            delete cell;
+        }
+    }
+
+    /**
+     * Returns instance of the calling thread
+     */
+    T &local() {
+        Cell *cell = static_cast<Cell *>(pthread_getspecific(_key));
+        if (cell == nullptr) {
+            cell = new Cell(this, _make());
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _cells.insert(cell);
+            }
+            pthread_setspecific(_key, cell);
+        }
+        return *cell->value;
+    }
+
+    /**
+     * Calls visitor for instance of each thread, instances stay alive meanwhile
+     */
+    void for_each(const std::function<void(T &)> &visitor) {
+        std::lock_guard<std::mutex> lock(_lock);
+        for (Cell *cell : _cells) {
+            visitor(*cell->value);
+        }
+    }
+
+private:
+    ThreadLocal(const ThreadLocal &);            // = delete;
+    ThreadLocal &operator=(const ThreadLocal &); // = delete;
+
+    struct Cell {
+        ThreadLocal *owner;
+        std::unique_ptr<T> value;
+
+        Cell(ThreadLocal *owner, T *value) : owner(owner), value(value) {}
+    };
+
+    // Called on exit of thread having an instance
+    static void _release(void *p) {
+        Cell *cell = static_cast<Cell *>(p);
+        {
+            std::lock_guard<std::mutex> lock(cell->owner->_lock);
+            cell->owner->_cells.erase(cell);
+        }
+        delete cell;
+    }
+
+    std::function<T *()> _make;
+    pthread_key_t _key;
+
+    // Instances of all threads, guarded by _lock
+    std::mutex _lock;
+    std::set<Cell *> _cells;
+};
 
 } // namespace Concurrency
 } // namespace Afina
@@ -1,8 +1,11 @@
 #ifndef AFINA_EXECUTE_COMMAND_H
 #define AFINA_EXECUTE_COMMAND_H
 
+#include <deque>
 #include <string>
 
+#include <afina/PinnedValue.h>
+
 namespace Afina {
 
 class Storage;
@@ -19,6 +22,30 @@ public:
     virtual ~Command() {}
 
     virtual void Execute(Storage &storage, const std::string &args, std::string &out) = 0;
+
+    /**
+     * Same as Execute, but command could take args over, i.e. move value into the storage instead of copying
+     * it. Args are left unspecified then.
+     *
+     * Default implementation calls Execute above
+     */
+    virtual void Execute(Storage &storage, std::string &&args, std::string &out);
+
+    /**
+     * Executes command and appends complete response, including the last \r\n, to the output queue as a
+     * sequence of chunks. Unlike Execute command could put views of values pinned in the storage into
+     * output, so that network layer sends them without copying.
+     *
+     * Default implementation puts result of Execute as a single chunk
+     */
+    virtual void ExecutePinned(Storage &storage, const std::string &args, std::deque<PinnedValue> &out);
+
+    /**
+     * Same as ExecutePinned, but args could be taken over as by Execute.
+     *
+     * Default implementation calls ExecutePinned above
+     */
+    virtual void ExecutePinned(Storage &storage, std::string &&args, std::deque<PinnedValue> &out);
 };
 
 } // namespace Execute
@@ -1,6 +1,7 @@
 #ifndef AFINA_EXECUTE_GET_H
 #define AFINA_EXECUTE_GET_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -31,18 +32,29 @@ namespace Execute {
  * hold items with such keys (because they were never stored, or stored
  * but deleted to make space for more items, or expired, or explicitly
  * deleted by a client).
+ *
+ * "gets" command is the same, but each item also carries version of the value to pass into "cas" command:
+ * VALUE <key> <bytes> <cas unique>\r\n
  */
 class Get : public Command {
 public:
-    Get(const std::vector<std::string> &keys) : _keys(keys) {}
+    Get(const std::vector<std::string> &keys, bool with_cas = false) : _keys(keys), _with_cas(with_cas) {}
     ~Get() {}
 
     inline const std::vector<std::string> &keys() const { return _keys; }
+    inline bool with_cas() const { return _with_cas; }
 
     void Execute(Storage &storage, const std::string &args, std::string &out) override;
 
+    // Values are put into output as pinned views, see Command.h
+    void ExecutePinned(Storage &storage, const std::string &args, std::deque<PinnedValue> &out) override;
+
 private:
+    // Appends item header line to the output
+    void _header(const std::string &key, size_t size, uint64_t cas, std::string &out) const;
+
     std::vector<std::string> _keys;
+    bool _with_cas;
 };
 
 } // namespace Execute
@@ -0,0 +1,45 @@
+#ifndef AFINA_EXECUTE_INCR_H
+#define AFINA_EXECUTE_INCR_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Increment or decrement counter
+ * Changes value for the given key by delta, value must be a decimal representation of 64-bit unsigned
+ * integer. Increment wraps around at 2^64, decrement stops at 0. "decr" command is the same as "incr" but
+ * subtracts delta
+ *
+ * Command must write result to the output, which could be:
+ * - "<value>", new value of the counter, to indicate success.
+ * - "NOT_FOUND" to indicate that the item with this key was not found
+ * - "CLIENT_ERROR ..." if value isn't a counter
+ * - "SERVER_ERROR ..." if new value can't be stored
+ */
+class Incr : public Command {
+public:
+    Incr(const std::string &key, uint64_t delta, bool decrement = false)
+        : _key(key), _delta(delta), _decrement(decrement) {}
+    ~Incr() {}
+
+    inline const std::string &key() const { return _key; }
+    inline uint64_t delta() const { return _delta; }
+    inline bool decrement() const { return _decrement; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    std::string _key;
+    const uint64_t _delta;
+    const bool _decrement;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_INCR_H
@@ -2,7 +2,10 @@
 #define AFINA_EXECUTE_INSERT_COMMAND_H
 
 #include <cstdint>
+#include <ctime>
+#include <deque>
 #include <string>
+#include <utility>
 
 #include "Command.h"
 
@@ -22,6 +25,32 @@ public:
     inline const uint32_t flags() const { return _flags; }
     inline const int32_t expire() const { return _expire; }
 
+    using Command::ExecutePinned;
+
+    /**
+     * Passes args to the Execute taking them over, so that value read off the network is moved into the
+     * storage
+     */
+    void ExecutePinned(Storage &storage, std::string &&args, std::deque<PinnedValue> &out) override {
+        std::string result;
+        Execute(storage, std::move(args), result);
+        result += "\r\n";
+        out.emplace_back(std::move(result));
+    }
+
+    /**
+     * Returns number of seconds item lives for, as Storage expects it. Protocol exptime is either number of
+     * seconds up to 30 days or unix time, 0 means item never expires
+     */
+    int32_t ttl() const {
+        const int32_t max_relative = 60 * 60 * 24 * 30;
+        if (_expire <= max_relative) {
+            return _expire;
+        }
+        std::time_t left = std::time_t(_expire) - std::time(nullptr);
+        return left > 0 ? int32_t(left) : -1;
+    }
+
 protected:
     const std::string _key;
     const uint32_t _flags;
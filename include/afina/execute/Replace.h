@@ -25,6 +25,9 @@ public:
     ~Replace() {}
 
     void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+    // Moves value into the storage, see Command
+    void Execute(Storage &storage, std::string &&args, std::string &out) override;
 };
 
 } // namespace Execute
@@ -0,0 +1,41 @@
+#ifndef AFINA_EXECUTE_RESIZE_H
+#define AFINA_EXECUTE_RESIZE_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Resize running storage
+ * "cache_memlimit <megabytes>" changes memory limit, see Storage#Resize. "cache_shards <count>" changes
+ * number of shards, see Storage#Reshard, it is not a part of memcached protocol. Command returns once
+ * storage fits new layout, meanwhile other connections are served
+ *
+ * Command must write result to the output, which could be:
+ * - "OK" to indicate success
+ * - "SERVER_ERROR ..." if storage can't be resized so
+ */
+class Resize : public Command {
+public:
+    Resize(uint64_t amount, bool shards = false) : _amount(amount), _shards(shards) {}
+    ~Resize() {}
+
+    inline uint64_t amount() const { return _amount; }
+    inline bool shards() const { return _shards; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    // Megabytes or number of shards
+    const uint64_t _amount;
+    const bool _shards;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_RESIZE_H
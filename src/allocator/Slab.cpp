@@ -0,0 +1,161 @@
+#include <afina/allocator/Slab.h>
+
+#include <afina/allocator/Error.h>
+
+#include <sstream>
+
+namespace Afina {
+namespace Allocator {
+
+Slab::Slab(void *base, size_t size, size_t page_size, size_t min_chunk, double factor)
+    : _base(static_cast<char *>(base)), _page_size(page_size) {
+    if (page_size == 0 || min_chunk < sizeof(void *) || min_chunk > page_size || factor <= 1.0) {
+        throw std::invalid_argument("Invalid slab configuration");
+    }
+
+    // Chunks are aligned to pointer size, so that any chunk could be a free list entry
+    const size_t align = sizeof(void *);
+    size_t chunk = (min_chunk + align - 1) & ~(align - 1);
+    while (chunk < page_size) {
+        _classes.push_back(Class{chunk, 0, 0, nullptr});
+
+        size_t next = (size_t(chunk * factor) + align - 1) & ~(align - 1);
+        chunk = next > chunk ? next : chunk + align;
+    }
+    _classes.push_back(Class{page_size, 0, 0, nullptr});
+
+    // Free pages are taken from the beginning of the area
+    _pages.assign(size / page_size, Page{-1, false, 0});
+    for (size_t i = _pages.size(); i > 0; i--) {
+        _free_pages.push_back(i - 1);
+    }
+}
+
+// See Slab.h
+int Slab::class_of(size_t size) const {
+    if (size > _page_size) {
+        return -1;
+    }
+
+    size_t lo = 0, hi = _classes.size() - 1;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (_classes[mid].chunk_size < size) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// See Slab.h
+void *Slab::alloc(unsigned cls) {
+    Class &c = _classes[cls];
+    if (c.free_list == nullptr) {
+        if (_free_pages.empty()) {
+            return nullptr;
+        }
+
+        // Carve the whole page at once, chunks go to the list in address order
+        size_t page = _free_pages.back();
+        _free_pages.pop_back();
+        _pages[page].cls = cls;
+        _pages[page].used = 0;
+        c.pages++;
+
+        char *begin = _base + page * _page_size;
+        for (size_t i = per_page(cls); i > 0; i--) {
+            void *chunk = begin + (i - 1) * c.chunk_size;
+            *static_cast<void **>(chunk) = c.free_list;
+            c.free_list = chunk;
+        }
+    }
+
+    void *p = c.free_list;
+    c.free_list = *static_cast<void **>(p);
+    c.used++;
+    _pages[_page_of(p)].used++;
+    return p;
+}
+
+// See Slab.h
+void Slab::free(void *p) {
+    if (p == nullptr) {
+        return;
+    }
+
+    size_t page = _page_of(p);
+    if (page >= _pages.size() || _pages[page].cls < 0) {
+        throw AllocError(AllocErrorType::InvalidFree, "Chunk doesn't belong to any class");
+    }
+
+    Page &pg = _pages[page];
+    Class &c = _classes[pg.cls];
+    c.used--;
+    pg.used--;
+    if (!pg.draining) {
+        *static_cast<void **>(p) = c.free_list;
+        c.free_list = p;
+    }
+}
+
+// See Slab.h
+bool Slab::reclaim(unsigned cls, const std::function<void(void *)> &release) {
+    Class &c = _classes[cls];
+    if (c.pages == 0) {
+        return false;
+    }
+
+    // The least used page costs the least number of released chunks
+    size_t page = _pages.size();
+    for (size_t i = 0; i < _pages.size(); i++) {
+        if (_pages[i].cls == int(cls) && (page == _pages.size() || _pages[i].used < _pages[page].used)) {
+            page = i;
+        }
+    }
+
+    char *begin = _base + page * _page_size;
+    char *end = begin + per_page(cls) * c.chunk_size;
+    std::vector<bool> is_free(per_page(cls), false);
+
+    // Take free chunks of the page off the list
+    for (void **link = &c.free_list; *link != nullptr;) {
+        char *chunk = static_cast<char *>(*link);
+        if (chunk >= begin && chunk < end) {
+            is_free[(chunk - begin) / c.chunk_size] = true;
+            *link = *reinterpret_cast<void **>(chunk);
+        } else {
+            link = reinterpret_cast<void **>(chunk);
+        }
+    }
+
+    // Rest of chunks are in use, owner frees them, but they don't get back into the list
+    _pages[page].draining = true;
+    for (size_t i = 0; i < is_free.size(); i++) {
+        if (!is_free[i]) {
+            release(begin + i * c.chunk_size);
+        }
+    }
+
+    _pages[page] = Page{-1, false, 0};
+    _free_pages.push_back(page);
+    c.pages--;
+    return true;
+}
+
+// See Slab.h
+std::string Slab::dump() const {
+    std::stringstream out;
+    for (size_t i = 0; i < _classes.size(); i++) {
+        const Class &c = _classes[i];
+        if (c.pages > 0) {
+            out << i << ": chunk " << c.chunk_size << ", pages " << c.pages << ", used " << c.used << std::endl;
+        }
+    }
+    out << "free pages " << _free_pages.size() << std::endl;
+    return out.str();
+}
+
+} // namespace Allocator
+} // namespace Afina
@@ -2,6 +2,7 @@
 #include <afina/execute/Add.h>
 
 #include <iostream>
+#include <utility>
 
 namespace Afina {
 namespace Execute {
@@ -10,7 +11,13 @@ namespace Execute {
 // hold data for this key".
 void Add::Execute(Storage &storage, const std::string &args, std::string &out) {
     std::cout << "Add(" << _key << ")" << args << std::endl;
-    out = storage.PutIfAbsent(_key, args) ? "STORED" : "NOT_STORED";
+    out = storage.PutIfAbsent(_key, args, ttl()) ? "STORED" : "NOT_STORED";
+}
+
+// See Add.h
+void Add::Execute(Storage &storage, std::string &&args, std::string &out) {
+    std::cout << "Add(" << _key << ")" << args << std::endl;
+    out = storage.PutIfAbsent(_key, std::move(args), ttl()) ? "STORED" : "NOT_STORED";
 }
 
 } // namespace Execute
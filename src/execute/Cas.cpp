@@ -0,0 +1,42 @@
+#include <afina/Storage.h>
+#include <afina/execute/Cas.h>
+
+#include <iostream>
+#include <utility>
+
+namespace Afina {
+namespace Execute {
+
+// Maps result of the storage to the protocol reply
+static void reply(Storage::CasResult result, std::string &out) {
+    switch (result) {
+    case Storage::CasResult::Stored:
+        out = "STORED";
+        break;
+    case Storage::CasResult::Exists:
+        out = "EXISTS";
+        break;
+    case Storage::CasResult::NotFound:
+        out = "NOT_FOUND";
+        break;
+    case Storage::CasResult::NotStored:
+        out = "NOT_STORED";
+        break;
+    }
+}
+
+// memcached protocol: "cas" is a check and set operation which means "store this data but only if no one
+// else has updated since I last fetched it."
+void Cas::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << "Cas(" << _key << ", " << _cas << "): " << args << std::endl;
+    reply(storage.CompareAndSet(_key, args, _cas, ttl()), out);
+}
+
+// See Cas.h
+void Cas::Execute(Storage &storage, std::string &&args, std::string &out) {
+    std::cout << "Cas(" << _key << ", " << _cas << "): " << args << std::endl;
+    reply(storage.CompareAndSet(_key, std::move(args), _cas, ttl()), out);
+}
+
+} // namespace Execute
+} // namespace Afina
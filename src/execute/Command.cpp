@@ -1 +1,25 @@
 #include <afina/execute/Command.h>
+
+namespace Afina {
+namespace Execute {
+
+// See Command.h
+void Command::Execute(Storage &storage, std::string &&args, std::string &out) {
+    Execute(storage, static_cast<const std::string &>(args), out);
+}
+
+// See Command.h
+void Command::ExecutePinned(Storage &storage, const std::string &args, std::deque<PinnedValue> &out) {
+    std::string result;
+    Execute(storage, args, result);
+    result += "\r\n";
+    out.emplace_back(std::move(result));
+}
+
+// See Command.h
+void Command::ExecutePinned(Storage &storage, std::string &&args, std::deque<PinnedValue> &out) {
+    ExecutePinned(storage, static_cast<const std::string &>(args), out);
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -12,7 +12,7 @@ namespace Execute {
 
 Each item sent by the server looks like this:
 
-VALUE <key> <flags> <bytes>\r\n
+VALUE <key> <flags> <bytes> [<cas unique>]\r\n
 <data block>\r\n
 
 After all the items have been transmitted, the server sends the string
@@ -21,23 +21,51 @@ to indicate the end of response.
 
 */
 
+// See Get.h
+void Get::_header(const std::string &key, size_t size, uint64_t cas, std::string &out) const {
+    out.append("VALUE ").append(key).append(" 0 ").append(std::to_string(size));
+    if (_with_cas) {
+        out.append(" ").append(std::to_string(cas));
+    }
+    out.append("\r\n");
+}
+
 void Get::Execute(Storage &storage, const std::string &args, std::string &out) {
     std::stringstream keyStream;
     copy(_keys.begin(), _keys.end(), std::ostream_iterator<std::string>(keyStream, " "));
     std::cout << "Get(" << keyStream.str() << ")" << std::endl;
 
-    std::stringstream outStream;
-
-    std::string value;
-    for (auto &key : _keys) {
-        if (!storage.Get(key, value))
+    out.clear();
+    std::vector<PinnedValue> values;
+    std::vector<uint64_t> cas;
+    storage.MultiGet(_keys, values, _with_cas ? &cas : nullptr);
+    for (size_t i = 0; i < _keys.size(); i++) {
+        PinnedValue &value = values[i];
+        if (!value)
             continue;
-        outStream << "VALUE " << key << " 0 " << value.size() << "\r\n";
-        outStream << value << "\r\n";
+        _header(_keys[i], value.size(), _with_cas ? cas[i] : 0, out);
+        out.append(value.data(), value.size()).append("\r\n");
     }
-    outStream << "END"; // networking layer should add the last \r\n
+    out.append("END"); // networking layer should add the last \r\n
+}
 
-    out = outStream.str();
+void Get::ExecutePinned(Storage &storage, const std::string &args, std::deque<PinnedValue> &out) {
+    // Text between values, each value goes as a separate chunk
+    std::string head;
+    std::vector<PinnedValue> values;
+    std::vector<uint64_t> cas;
+    storage.MultiGet(_keys, values, _with_cas ? &cas : nullptr);
+    for (size_t i = 0; i < _keys.size(); i++) {
+        PinnedValue &value = values[i];
+        if (!value)
+            continue;
+        _header(_keys[i], value.size(), _with_cas ? cas[i] : 0, head);
+        out.emplace_back(std::move(head));
+        out.emplace_back(std::move(value));
+        head.assign("\r\n");
+    }
+    head.append("END\r\n");
+    out.emplace_back(std::move(head));
 }
 
 } // namespace Execute
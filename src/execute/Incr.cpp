@@ -0,0 +1,33 @@
+#include <afina/Storage.h>
+#include <afina/execute/Incr.h>
+
+#include <iostream>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "incr" and "decr" change counter in place, so that clients need neither to read value
+// first nor to retry on concurrent update
+void Incr::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << (_decrement ? "Decr(" : "Incr(") << _key << ", " << _delta << ")" << std::endl;
+    uint64_t value = 0;
+    Storage::CounterResult result =
+        _decrement ? storage.Decr(_key, _delta, value) : storage.Incr(_key, _delta, value);
+    switch (result) {
+    case Storage::CounterResult::Stored:
+        out = std::to_string(value);
+        break;
+    case Storage::CounterResult::NotFound:
+        out = "NOT_FOUND";
+        break;
+    case Storage::CounterResult::NotNumber:
+        out = "CLIENT_ERROR cannot increment or decrement non-numeric value";
+        break;
+    case Storage::CounterResult::NotStored:
+        out = "SERVER_ERROR out of memory";
+        break;
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
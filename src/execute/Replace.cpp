@@ -2,6 +2,7 @@
 #include <afina/execute/Replace.h>
 
 #include <iostream>
+#include <utility>
 
 namespace Afina {
 namespace Execute {
@@ -11,13 +12,13 @@ namespace Execute {
 
 void Replace::Execute(Storage &storage, const std::string &args, std::string &out) {
     std::cout << "Replace(" << _key << "): " << args << std::endl;
-    std::string value;
-    if (storage.Get(_key, value)) {
-        storage.Set(_key, args);
-        out = "STORED";
-    } else {
-        out = "NOT_STORED";
-    }
+    out = storage.Set(_key, args, ttl()) ? "STORED" : "NOT_STORED";
+}
+
+// See Replace.h
+void Replace::Execute(Storage &storage, std::string &&args, std::string &out) {
+    std::cout << "Replace(" << _key << "): " << args << std::endl;
+    out = storage.Set(_key, std::move(args), ttl()) ? "STORED" : "NOT_STORED";
 }
 
 } // namespace Execute
@@ -0,0 +1,23 @@
+#include <afina/Storage.h>
+#include <afina/execute/Resize.h>
+
+#include <iostream>
+#include <limits>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "cache_memlimit" takes megabytes and answers "OK"
+void Resize::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << (_shards ? "Reshard(" : "Resize(") << _amount << ")" << std::endl;
+    bool resized = false;
+    if (_shards) {
+        resized = _amount <= std::numeric_limits<std::size_t>::max() && storage.Reshard(_amount);
+    } else {
+        resized = _amount <= (std::numeric_limits<std::size_t>::max() >> 20) && storage.Resize(_amount << 20);
+    }
+    out = resized ? "OK" : "SERVER_ERROR cannot resize storage";
+}
+
+} // namespace Execute
+} // namespace Afina
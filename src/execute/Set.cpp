@@ -2,6 +2,7 @@
 #include <afina/execute/Set.h>
 
 #include <iostream>
+#include <utility>
 
 namespace Afina {
 namespace Execute {
@@ -9,7 +10,14 @@ namespace Execute {
 // memcached protocol: "set" means "store this data".
 void Set::Execute(Storage &storage, const std::string &args, std::string &out) {
     std::cout << "Set(" << _key << "): " << args << std::endl;
-    storage.Put(_key, args);
+    storage.Put(_key, args, ttl());
+    out = "STORED";
+}
+
+// See Set.h
+void Set::Execute(Storage &storage, std::string &&args, std::string &out) {
+    std::cout << "Set(" << _key << "): " << args << std::endl;
+    storage.Put(_key, std::move(args), ttl());
     out = "STORED";
 }
 
@@ -8,7 +8,17 @@
 namespace Afina {
 namespace Execute {
 
-void Stats::Execute(Storage &storage, const std::string &args, std::string &out) { out.assign("END"); }
+// memcached protocol: "stats" reports server statistics, one "STAT <name> <value>" line each
+void Stats::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+
+    out.clear();
+    for (auto &stat : stats) {
+        out.append("STAT ").append(stat.first).append(" ").append(stat.second).append("\r\n");
+    }
+    out.append("END");
+}
 
 } // namespace Execute
 } // namespace Afina
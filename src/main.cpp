@@ -1,6 +1,7 @@
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 
 #include <atomic>
 #include <semaphore.h>
@@ -21,12 +22,50 @@
 #include "network/st_coroutine/ServerImpl.h"
 #include "network/st_nonblocking/ServerImpl.h"
 
+#include "storage/CombinedLRU.h"
+#include "storage/CoreLRU.h"
+#include "storage/LockFreeLRU.h"
+#include "storage/LoggedStorage.h"
+#include "storage/NearCache.h"
+#include "storage/ShmLRU.h"
 #include "storage/SimpleLRU.h"
+#include "storage/SlabLRU.h"
+#include "storage/Snapshot.h"
 #include "storage/StripedLRU.h"
+#include "storage/Sweeper.h"
 #include "storage/ThreadSafeSimpleLRU.h"
 
 using namespace Afina;
 
+/**
+ * Parses number of bytes with optional K, M or G suffix, i.e 64M
+ */
+std::size_t parse_size(const std::string &value) {
+    std::size_t pos = 0;
+    unsigned long long size = std::stoull(value, &pos);
+    if (pos + 1 == value.size()) {
+        switch (value[pos]) {
+        case 'G':
+        case 'g':
+            size *= 1024;
+            // fall through
+        case 'M':
+        case 'm':
+            size *= 1024;
+            // fall through
+        case 'K':
+        case 'k':
+            size *= 1024;
+            break;
+        default:
+            throw std::runtime_error("Invalid size suffix: " + value);
+        }
+    } else if (pos != value.size()) {
+        throw std::runtime_error("Invalid size: " + value);
+    }
+    return size;
+}
+
 /**
  * Whole application class
  */
@@ -52,16 +91,154 @@ public:
             storage_type = options["storage"].as<std::string>();
         }
 
+        // Suffix selects key index, i.e st_lru_hash is st_lru with hash index
+        Afina::Backend::IndexType index_type = Afina::Backend::IndexType::Map;
+        for (auto &index : {std::make_pair(std::string("_hash"), Afina::Backend::IndexType::Hash),
+                            std::make_pair(std::string("_swiss"), Afina::Backend::IndexType::Swiss)}) {
+            const std::string &suffix = index.first;
+            if (storage_type.size() > suffix.size() &&
+                storage_type.compare(storage_type.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                index_type = index.second;
+                storage_type.resize(storage_type.size() - suffix.size());
+                break;
+            }
+        }
+
+        std::size_t memory_limit = 16ULL * 1024 * 1024;
+        if (options.count("memory") > 0) {
+            memory_limit = parse_size(options["memory"].as<std::string>());
+        }
+
+        std::size_t stripe_count = 4;
+        if (options.count("stripes") > 0) {
+            stripe_count = options["stripes"].as<std::size_t>();
+        }
+
+        Afina::Backend::LockType lock_type = Afina::Backend::LockType::Mutex;
+        if (options.count("lock") > 0) {
+            std::string lock = options["lock"].as<std::string>();
+            if (lock == "mutex") {
+                lock_type = Afina::Backend::LockType::Mutex;
+            } else if (lock == "rw") {
+                lock_type = Afina::Backend::LockType::RW;
+            } else if (lock == "spin") {
+                lock_type = Afina::Backend::LockType::Spin;
+            } else {
+                throw std::runtime_error("Unknown lock type");
+            }
+        }
+
+        Afina::Backend::EvictionPolicy policy = Afina::Backend::EvictionPolicy::LRU;
+        if (options.count("policy") > 0) {
+            std::string name = options["policy"].as<std::string>();
+            if (name == "lru") {
+                policy = Afina::Backend::EvictionPolicy::LRU;
+            } else if (name == "clock") {
+                policy = Afina::Backend::EvictionPolicy::Clock;
+            } else if (name == "slru") {
+                policy = Afina::Backend::EvictionPolicy::Segmented;
+            } else {
+                throw std::runtime_error("Unknown eviction policy");
+            }
+        }
+
+        Afina::Backend::Admission admission = Afina::Backend::Admission::All;
+        if (options.count("admission") > 0) {
+            std::string name = options["admission"].as<std::string>();
+            if (name == "all") {
+                admission = Afina::Backend::Admission::All;
+            } else if (name == "tinylfu") {
+                admission = Afina::Backend::Admission::TinyLFU;
+            } else {
+                throw std::runtime_error("Unknown admission policy");
+            }
+        }
+
+        Afina::Backend::Accounting accounting = Afina::Backend::Accounting::Payload;
+        if (options.count("accounting") > 0) {
+            std::string name = options["accounting"].as<std::string>();
+            if (name == "payload") {
+                accounting = Afina::Backend::Accounting::Payload;
+            } else if (name == "precise") {
+                accounting = Afina::Backend::Accounting::Precise;
+            } else {
+                throw std::runtime_error("Unknown accounting mode");
+            }
+        }
+
         if (storage_type == "st_lru") {
-            storage = std::make_shared<Afina::Backend::SimpleLRU>();
+            storage = std::make_shared<Afina::Backend::SimpleLRU>(memory_limit, index_type, policy, admission,
+                                                                  accounting);
         } else if (storage_type == "mt_lru") {
-            storage = std::make_shared<Afina::Backend::ThreadSafeSimplLRU>();
+            storage = std::make_shared<Afina::Backend::ThreadSafeSimplLRU>(memory_limit, index_type, policy,
+                                                                           lock_type, admission, accounting);
+        } else if (storage_type == "mt_fc") {
+            storage = std::make_shared<Afina::Backend::CombinedLRU>(memory_limit, index_type, policy, admission,
+                                                                    accounting);
         } else if (storage_type == "mt_slru") {
-            storage = std::shared_ptr<Afina::Backend::StripedLRU>(Afina::Backend::StripedLRU::create_cache(4, 16ULL * 1024 * 1024));
+            storage = std::shared_ptr<Afina::Backend::StripedLRU>(Afina::Backend::StripedLRU::create_cache(
+                stripe_count, memory_limit, lock_type, index_type, policy, admission, accounting));
+        } else if (storage_type == "st_slab") {
+            storage = std::make_shared<Afina::Backend::SlabLRU>(memory_limit, index_type);
+        } else if (storage_type == "st_shm") {
+            std::string name = "afina";
+            if (options.count("shm") > 0) {
+                name = options["shm"].as<std::string>();
+            }
+            storage = std::make_shared<Afina::Backend::ShmLRU>("/dev/shm/" + name, memory_limit);
+        } else if (storage_type == "mt_lockfree") {
+            storage = std::make_shared<Afina::Backend::LockFreeLRU>(memory_limit);
+        } else if (storage_type == "mt_core") {
+            // one shard per core unless asked otherwise
+            std::size_t shard_count = Afina::Concurrency::CoreLocal<int>::cores();
+            if (options.count("stripes") > 0) {
+                shard_count = stripe_count;
+            }
+            storage = std::make_shared<Afina::Backend::CoreLRU>(shard_count, memory_limit, index_type, policy,
+                                                                admission, accounting);
         } else {
             throw std::runtime_error("Unknown storage type");
         }
 
+        // Mutations are logged by decorator, log is replayed on start
+        if (options.count("log") > 0) {
+            Afina::Backend::SyncPolicy sync = Afina::Backend::SyncPolicy::Interval;
+            if (options.count("log-sync") > 0) {
+                std::string name = options["log-sync"].as<std::string>();
+                if (name == "none") {
+                    sync = Afina::Backend::SyncPolicy::None;
+                } else if (name == "interval") {
+                    sync = Afina::Backend::SyncPolicy::Interval;
+                } else if (name == "always") {
+                    sync = Afina::Backend::SyncPolicy::Always;
+                } else {
+                    throw std::runtime_error("Unknown log sync policy");
+                }
+            }
+
+            std::chrono::milliseconds interval(1000);
+            if (options.count("log-interval") > 0) {
+                interval = std::chrono::milliseconds(options["log-interval"].as<std::size_t>());
+            }
+
+            logged = std::make_shared<Afina::Backend::LoggedStorage>(storage, options["log"].as<std::string>(), sync,
+                                                                     interval);
+            storage = logged;
+        }
+
+        // Hot keys are served by worker threads from their own copies, see NearCache
+        if (options.count("near-cache") > 0 && options["near-cache"].as<std::size_t>() > 0) {
+            storage = std::make_shared<Afina::Backend::NearCache>(storage, options["near-cache"].as<std::size_t>());
+        }
+
+        // Storage image is loaded on start and saved on stop, optionally also once per interval
+        if (options.count("snapshot") > 0) {
+            snapshot.reset(new Afina::Backend::Snapshot(options["snapshot"].as<std::string>()));
+        }
+        if (options.count("snapshot-interval") > 0) {
+            snapshot_interval = std::chrono::seconds(options["snapshot-interval"].as<std::size_t>());
+        }
+
         // Step 2: Configure network
         std::string network_type = "st_block";
         if (options.count("network") > 0) {
@@ -92,6 +269,39 @@ public:
         log->warn("Start storage");
         storage->Start();
 
+        if (logged) {
+            log->warn("Replayed {} mutations from the log", logged->Replayed());
+        }
+
+        // Non empty log has everything snapshot could have
+        if (snapshot && (!logged || logged->Replayed() == 0)) {
+            auto started = std::chrono::steady_clock::now();
+            std::size_t loaded = snapshot->Load(*storage);
+            log->warn("Loaded {} items from {} in {} ms", loaded, snapshot->path(),
+                      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started)
+                          .count());
+        }
+
+        if (snapshot && snapshot_interval.count() > 0) {
+            // first slice runs right away, there is nothing new to save yet
+            bool first = true;
+            snapshot_saver.Start(
+                [this, first]() mutable {
+                    // failed fork must not stop the saver, the next slice tries again
+                    try {
+                        if (!first && snapshot->Save(*storage) && !snapshot->Wait()) {
+                            logService->select("root")->error("Failed to save snapshot {}", snapshot->path());
+                        }
+                    } catch (std::runtime_error &e) {
+                        logService->select("root")->error("Failed to save snapshot {}: {}", snapshot->path(),
+                                                          e.what());
+                    }
+                    first = false;
+                    return false;
+                },
+                snapshot_interval);
+        }
+
         // TODO: configure network service
         const uint16_t port = 8080;
         log->warn("Start network on {}", port);
@@ -107,6 +317,19 @@ public:
         server->Join();
         //log->warn("Join in main");
 
+        if (snapshot) {
+            snapshot_saver.Stop();
+            log->warn("Save snapshot {}", snapshot->path());
+            // storage must be stopped anyway, so that mutation log gets its last sync
+            try {
+                if (!snapshot->Save(*storage) || !snapshot->Wait()) {
+                    log->error("Failed to save snapshot {}", snapshot->path());
+                }
+            } catch (std::runtime_error &e) {
+                log->error("Failed to save snapshot {}: {}", snapshot->path(), e.what());
+            }
+        }
+
         storage->Stop();
         logService->Stop();
     }
@@ -117,6 +340,12 @@ private:
 
     std::shared_ptr<Afina::Storage> storage;
     std::shared_ptr<Network::Server> server;
+
+    std::shared_ptr<Backend::LoggedStorage> logged;
+
+    std::unique_ptr<Backend::Snapshot> snapshot;
+    std::chrono::seconds snapshot_interval{0};
+    Backend::Sweeper snapshot_saver;
 };
 
 // Signal set that to notify application about time to stop
@@ -135,8 +364,30 @@ int main(int argc, char **argv) {
     try {
         // TODO: use custom cxxopts::value to print options possible values in help message
         // and simplify validation below
-        options.add_options()("s,storage", "Type of storage service to use", cxxopts::value<std::string>());
+        options.add_options()("s,storage",
+                              "Type of storage service to use, mt_core is experimental: slower than mt_lru "
+                              "unless each shard has a free core",
+                              cxxopts::value<std::string>());
         options.add_options()("n,network", "Type of network service to use", cxxopts::value<std::string>());
+        options.add_options()("m,memory", "Storage memory limit in bytes, K/M/G suffixes allowed",
+                              cxxopts::value<std::string>());
+        options.add_options()("stripes", "Number of shards of striped storage", cxxopts::value<std::size_t>());
+        options.add_options()("lock", "Kind of storage lock: mutex, rw, spin", cxxopts::value<std::string>());
+        options.add_options()("policy", "Eviction policy: lru, clock, slru", cxxopts::value<std::string>());
+        options.add_options()("admission", "Admission policy: all, tinylfu", cxxopts::value<std::string>());
+        options.add_options()("accounting", "Memory accounting: payload, precise", cxxopts::value<std::string>());
+        options.add_options()("shm", "Name of shared memory segment of st_shm storage", cxxopts::value<std::string>());
+        options.add_options()("snapshot", "File to load storage from on start and save it to on stop",
+                              cxxopts::value<std::string>());
+        options.add_options()("snapshot-interval", "Seconds between background snapshots, 0 to save on stop only",
+                              cxxopts::value<std::size_t>());
+        options.add_options()("log", "File to log storage mutations to, replayed on start",
+                              cxxopts::value<std::string>());
+        options.add_options()("log-sync", "When log is synced: none, interval, always", cxxopts::value<std::string>());
+        options.add_options()("log-interval", "Milliseconds between log syncs of interval policy",
+                              cxxopts::value<std::size_t>());
+        options.add_options()("near-cache", "Number of entries in near cache of each worker thread, 0 to disable",
+                              cxxopts::value<std::size_t>());
         options.add_options()("h,help", "Print usage info");
         options.parse(argc, argv);
 
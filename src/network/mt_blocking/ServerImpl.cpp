@@ -5,6 +5,7 @@
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <utility>
 
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -134,6 +135,9 @@ void ServerImpl::Worker(int client_socket) {
                         command_to_execute = parser.Build(arg_remains);
                         if (arg_remains > 0) {
                             arg_remains += 2;
+                            if (arg_remains <= Protocol::Parser::max_reserved_body) {
+                                argument_for_command.reserve(arg_remains);
+                            }
                         }
                     }
                     // Parsed might fails to consume any bytes from input stream. In real life that could happens,
@@ -162,7 +166,7 @@ void ServerImpl::Worker(int client_socket) {
                     if (argument_for_command.size()) {
                         argument_for_command.resize(argument_for_command.size() - 2);
                     }
-                    command_to_execute->Execute(*pStorage, argument_for_command, result);
+                    command_to_execute->Execute(*pStorage, std::move(argument_for_command), result);
 
                     // Send response
                     result += "\r\n";
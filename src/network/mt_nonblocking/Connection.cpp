@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include <iostream>
+#include <utility>
 #include <sys/uio.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -50,6 +51,9 @@ void Connection::DoRead() {
                         command_to_execute = parser.Build(arg_remains);
                         if (arg_remains > 0) {
                             arg_remains += 2;
+                            if (arg_remains <= Protocol::Parser::max_reserved_body) {
+                                argument_for_command.reserve(arg_remains);
+                            }
                         }
                     }
 
@@ -74,17 +78,14 @@ void Connection::DoRead() {
 
                 if (command_to_execute && arg_remains == 0) {
 
-                    std::string result = "";
                     if (argument_for_command.size()) {
                         argument_for_command.resize(argument_for_command.size() - 2);
                     }
-                    command_to_execute->Execute(*pStorage, argument_for_command, result);
 
-                    result += "\r\n";
                     if (_results.empty()) {
                         _event.events |= EPOLLOUT;
                     }
-                    _results.push_back(result);
+                    command_to_execute->ExecutePinned(*pStorage, std::move(argument_for_command), _results);
                     if (_results.size() >= MAX_QUEUE_SIZE_HIGH) {
                         _event.events &= ~EPOLLIN;
                     }
@@ -107,10 +108,8 @@ void Connection::DoRead() {
     } catch (std::runtime_error &ex) {
         // _logger->error("Failed to process connection on descriptor {}: {}", _socket, ex.what());
         std::cerr << ("Failed to process connection on descriptor {}: {}", _socket, ex.what()) << std::endl;
-        _results.push_back("ERROR\r\n");
-        if (_results.empty()) {
-            _event.events |= EPOLLOUT;
-        }
+        _results.emplace_back(std::string("ERROR\r\n"));
+        _event.events |= EPOLLOUT;
         shutdown(_socket, SHUT_RD);
         _output_only = true;
         _event.events &= ~EPOLLIN;
@@ -123,31 +122,29 @@ void Connection::DoWrite() {
     std::atomic_thread_fence(std::memory_order_acquire);
     iovec iovecs[IOVEC_SIZE] = {};
     auto it = _results.begin();
-    iovecs[0].iov_base = &((*it)[0]) + _write_offset;
+    iovecs[0].iov_base = const_cast<char *>(it->data()) + _write_offset;
     iovecs[0].iov_len = it->size() - _write_offset;
     ++it;
     size_t in_iovec = 1;
 
     while (it != _results.end() && in_iovec < IOVEC_SIZE) {
-        iovecs[in_iovec].iov_base = &((*it)[0]);
+        iovecs[in_iovec].iov_base = const_cast<char *>(it->data());
         iovecs[in_iovec].iov_len = it->size();
         it++;
         in_iovec++;
     }
 
-    int written = 0;
-    if ((written = writev(_socket, iovecs, in_iovec)) > 0) {
-        for (size_t i = 0; i < in_iovec; ++i) {
-            if (written >= iovecs[i].iov_len) {
-                written -= iovecs[i].iov_len;
-                _results.pop_front();
-            }
-            else {
-                break;
-            }
+    ssize_t written = 0;
+    if ((written = writev(_socket, iovecs, in_iovec)) >= 0) {
+        size_t done = 0;
+        while (done < in_iovec && size_t(written) >= iovecs[done].iov_len) {
+            written -= iovecs[done].iov_len;
+            _results.pop_front();
+            _write_offset = 0;
+            done++;
         }
-        _write_offset = written;
-    } else if (written < 0 && !(errno == EAGAIN || errno == EINTR)) {
+        _write_offset += written;
+    } else if (!(errno == EAGAIN || errno == EINTR)) {
         this->OnError();
     }
 
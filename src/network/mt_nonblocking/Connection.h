@@ -21,7 +21,8 @@ namespace MTnonblock {
 
 class Connection {
 public:
-    Connection(int s, std::shared_ptr<Afina::Storage> ps) : _socket(s), pStorage(ps), _output_only(false) {
+    Connection(int s, std::shared_ptr<spdlog::logger> log, std::shared_ptr<Afina::Storage> ps)
+        : _socket(s), _logger(log), pStorage(ps), _output_only(false) {
         std::memset(&_event, 0, sizeof(struct epoll_event));
         _event.data.ptr = this;
     }
@@ -46,8 +47,9 @@ private:
     std::shared_ptr<spdlog::logger> _logger;
     std::shared_ptr<Afina::Storage> pStorage;
 
+    // Responses to be sent, values pinned in the storage are written directly from there
     std::size_t _write_offset;
-    std::deque<std::string> _results;
+    std::deque<PinnedValue> _results;
 
     std::size_t arg_remains;
     Protocol::Parser parser;
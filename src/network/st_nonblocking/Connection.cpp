@@ -1,6 +1,7 @@
 #include "Connection.h"
 
 #include <iostream>
+#include <utility>
 #include <unistd.h>
 #include <sys/uio.h>
 
@@ -54,6 +55,9 @@ void Connection::DoRead() {
                         command_to_execute = parser.Build(arg_remains);
                         if (arg_remains > 0) {
                             arg_remains += 2;
+                            if (arg_remains <= Protocol::Parser::max_reserved_body) {
+                                argument_for_command.reserve(arg_remains);
+                            }
                         }
                     }
 
@@ -79,7 +83,7 @@ void Connection::DoRead() {
                     _logger->debug("Execute command");
 
                     std::string result;
-                    command_to_execute->Execute(*pStorage, argument_for_command, result);
+                    command_to_execute->Execute(*pStorage, std::move(argument_for_command), result);
 
                     result += "\r\n";
                     _results.push_back(result);
@@ -6,9 +6,13 @@
 
 #include <afina/execute/Add.h>
 #include <afina/execute/Append.h>
+#include <afina/execute/Cas.h>
 #include <afina/execute/Command.h>
 #include <afina/execute/Delete.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Prepend.h>
+#include <afina/execute/Resize.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
 
@@ -28,10 +32,17 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
         case State::sName: {
             if (c == ' ' || c == '\r') {
                 // std::cout << "parser debug: name='" << name << "'" << std::endl;
-                if (name == "set" || name == "add" || name == "append" || name == "prepend") {
+                if (name == "set" || name == "add" || name == "append" || name == "prepend" || name == "cas") {
                     state = State::spKey;
                 } else if (name == "get" || name == "gets") {
                     state = State::sgKey;
+                } else if (name == "incr" || name == "decr") {
+                    state = State::siKey;
+                } else if (name == "cache_memlimit" || name == "cache_shards") {
+                    if (c == '\r') {
+                        throw std::runtime_error("Client provides no amount for " + name);
+                    }
+                    state = State::siDelta;
                 } else if (name == "stats") {
                     state = State::sLF;
                     continue;
@@ -77,6 +88,39 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             break;
         }
 
+        case State::siKey: {
+            if (c == ' ') {
+                state = State::siDelta;
+                keys.push_back(curKey);
+                curKey.clear();
+            } else if (c == '\r') {
+                throw std::runtime_error("Client provides no delta for " + name);
+            } else {
+                curKey.push_back(c);
+            }
+            break;
+        }
+
+        case State::siDelta: {
+            if (c == '\r') {
+                if (!has_delta) {
+                    throw std::runtime_error("Client provides no delta for " + name);
+                }
+                state = State::sLF;
+            } else if (c >= '0' && c <= '9') {
+                uint64_t d = (delta * 10) + (c - '0');
+                if (d / 10 != delta) {
+                    // Overflow
+                    throw std::runtime_error("Delta field overflow");
+                }
+                delta = d;
+                has_delta = true;
+            } else if (c != ' ') {
+                throw std::runtime_error("Delta field isn't a decimal number");
+            }
+            break;
+        }
+
         case State::spFlags: {
             if (c == ' ') {
                 negative = false;
@@ -109,15 +153,15 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
                 state = State::spBytes;
                 // std::cout << "parser debug: ExprTime='" << exprtime << "'" << std::endl;
             } else if (c >= '0' && c <= '9') {
-                int32_t et = exprtime;
+                int64_t et = int64_t(exprtime) * 10;
                 if (negative) {
                     et -= (c - '0');
-                    if (et > exprtime) {
+                    if (et < INT32_MIN) {
                         throw std::runtime_error("Expire time field overflow");
                     }
                 } else {
                     et += (c - '0');
-                    if (et < exprtime) {
+                    if (et > INT32_MAX) {
                         throw std::runtime_error("Expire time field overflow");
                     }
                 }
@@ -130,6 +174,8 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             if (c == '\r') {
                 state = State::sLF;
                 // std::cout << "parser debug: bytes='" << bytes << "'" << std::endl;
+            } else if (c == ' ' && name == "cas") {
+                state = State::spCas;
             } else if (c >= '0' && c <= '9') {
                 uint32_t b = (bytes * 10) + (c - '0');
                 if (b < bytes) {
@@ -141,6 +187,20 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             break;
         }
 
+        case State::spCas: {
+            if (c == '\r') {
+                state = State::sLF;
+            } else if (c >= '0' && c <= '9') {
+                uint64_t u = (cas * 10) + (c - '0');
+                if (u / 10 != cas) {
+                    // Overflow
+                    throw std::runtime_error("Cas unique field overflow");
+                }
+                cas = u;
+            }
+            break;
+        }
+
         case State::sLF: {
             if (c == '\n') {
                 parse_complete = true;
@@ -174,8 +234,22 @@ std::unique_ptr<Execute::Command> Parser::Build(size_t &body_size) const {
         return std::unique_ptr<Execute::Command>(new Execute::Add(keys[0], flags, exprtime));
     } else if (name == "append") {
         return std::unique_ptr<Execute::Command>(new Execute::Append(keys[0], flags, exprtime));
+    } else if (name == "prepend") {
+        return std::unique_ptr<Execute::Command>(new Execute::Prepend(keys[0], flags, exprtime));
+    } else if (name == "cas") {
+        return std::unique_ptr<Execute::Command>(new Execute::Cas(keys[0], flags, exprtime, cas));
     } else if (name == "get") {
         return std::unique_ptr<Execute::Command>(new Execute::Get(keys));
+    } else if (name == "gets") {
+        return std::unique_ptr<Execute::Command>(new Execute::Get(keys, true));
+    } else if (name == "incr") {
+        return std::unique_ptr<Execute::Command>(new Execute::Incr(keys[0], delta));
+    } else if (name == "decr") {
+        return std::unique_ptr<Execute::Command>(new Execute::Incr(keys[0], delta, true));
+    } else if (name == "cache_memlimit") {
+        return std::unique_ptr<Execute::Command>(new Execute::Resize(delta));
+    } else if (name == "cache_shards") {
+        return std::unique_ptr<Execute::Command>(new Execute::Resize(delta, true));
     } else if (name == "stats") {
         return std::unique_ptr<Execute::Command>(new Execute::Stats());
     } else {
@@ -193,6 +267,9 @@ void Parser::Reset() {
     flags = 0;
     bytes = 0;
     exprtime = 0;
+    cas = 0;
+    delta = 0;
+    has_delta = false;
 }
 
 } // namespace Protocol
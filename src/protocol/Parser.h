@@ -48,6 +48,13 @@ public:
      */
     std::unique_ptr<Execute::Command> Build(size_t &body_size) const;
 
+    /**
+     * Largest body network layer reserves buffer for as soon as command is built. Body read into buffer of
+     * exact size could be taken over by storage as is, while buffer of larger body grows as data arrives,
+     * so that client doesn't get memory just by declaring huge body
+     */
+    static constexpr std::size_t max_reserved_body = 1024 * 1024;
+
     /**
      * Reset parse so that it could be used to parse out new command
      */
@@ -61,8 +68,22 @@ private:
      * - s: state for PUT and GET commands
      * - sp: for PUT commands only
      * - sg: for GET commands only
+     * - si: for INCR and DECR commands, CACHE_MEMLIMIT and CACHE_SHARDS take amount in place of delta
      */
-    enum State : uint16_t { sCR, sLF, sName, spKey, spFlags, spExprTimeStart, spExprTime, spBytes, sgKey };
+    enum State : uint16_t {
+        sCR,
+        sLF,
+        sName,
+        spKey,
+        spFlags,
+        spExprTimeStart,
+        spExprTime,
+        spBytes,
+        spCas,
+        sgKey,
+        siKey,
+        siDelta
+    };
 
     // Current parser state
     State state;
@@ -88,6 +109,17 @@ private:
     // it's followed by an empty data block).
     uint32_t bytes;
 
+    // <cas unique> is a unique 64-bit value of an existing entry, retrieved with "gets" command. Only "cas"
+    // command has it
+    uint64_t cas;
+
+    // <value> is the amount by which the client wants to increase/decrease the item. It is a decimal
+    // representation of a 64-bit unsigned integer. Only "incr" and "decr" commands have it, resize commands
+    // keep their amount here too
+    uint64_t delta;
+    // delta has at least one digit
+    bool has_delta;
+
     bool negative;
     std::string curKey;
     bool parse_complete;
@@ -0,0 +1,261 @@
+#ifndef AFINA_STORAGE_COMBINED_LRU_H
+#define AFINA_STORAGE_COMBINED_LRU_H
+
+#include <exception>
+#include <string>
+#include <utility>
+
+#include <afina/concurrency/FlatCombine.h>
+
+#include "SimpleLRU.h"
+#include "Sweeper.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # SimpleLRU flat combined version
+ * Operations are serialized as with a global lock, so eviction order is exactly the one of SimpleLRU, but
+ * instead of taking the lock in turn threads publish calls and a single combiner applies the waiting ones
+ * in a batch, see Concurrency::FlatCombine. Batch operations are applied as one call.
+ *
+ * Reads go through the combiner as well, since they move node in the eviction order. Once started,
+ * expired nodes are reclaimed in background by short slices applied like any other call
+ */
+class CombinedLRU : public SimpleLRU {
+public:
+    CombinedLRU(size_t max_size = 1024, IndexType index_type = IndexType::Map,
+                EvictionPolicy policy = EvictionPolicy::LRU, Admission admission = Admission::All,
+                Accounting accounting = Accounting::Payload)
+        : SimpleLRU(max_size, index_type, policy, admission, accounting), _combiner(&CombinedLRU::_apply) {}
+    ~CombinedLRU() {}
+
+    // Implements Afina::Storage interface
+    void Start() override {
+        _sweeper.Start([this]() { return Expire(_expire_budget) > 0; }, std::chrono::seconds(1));
+    }
+
+    // Implements Afina::Storage interface
+    void Stop() override { _sweeper.Stop(); }
+
+    // see SimpleLRU.h
+    std::size_t Expire(std::size_t budget) {
+        std::size_t expired = 0;
+        _call([&]() { expired = SimpleLRU::Expire(budget); });
+        return expired;
+    }
+
+    // see SimpleLRU.h
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::Put(key, value, ttl); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool Put(const std::string &key, std::string &&value, int32_t ttl = 0) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::Put(key, std::move(value), ttl); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::PutIfAbsent(key, value, ttl); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl = 0) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::PutIfAbsent(key, std::move(value), ttl); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::Set(key, value, ttl); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool Set(const std::string &key, std::string &&value, int32_t ttl = 0) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::Set(key, std::move(value), ttl); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool Append(const std::string &key, const std::string &data) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::Append(key, data); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool Prepend(const std::string &key, const std::string &data) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::Prepend(key, data); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override {
+        CounterResult result = CounterResult::NotFound;
+        _call([&]() { result = SimpleLRU::Incr(key, delta, value); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override {
+        CounterResult result = CounterResult::NotFound;
+        _call([&]() { result = SimpleLRU::Decr(key, delta, value); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool Delete(const std::string &key) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::Delete(key); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool Get(const std::string &key, std::string &value) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::Get(key, value); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool GetPinned(const std::string &key, PinnedValue &value) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::GetPinned(key, value); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override {
+        bool result = false;
+        _call([&]() { result = SimpleLRU::GetCas(key, value, cas); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override {
+        CasResult result = CasResult::NotFound;
+        _call([&]() { result = SimpleLRU::CompareAndSet(key, value, cas, ttl); });
+        return result;
+    }
+
+    // see SimpleLRU.h
+    CasResult CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl = 0) override {
+        CasResult result = CasResult::NotFound;
+        _call([&]() { result = SimpleLRU::CompareAndSet(key, std::move(value), cas, ttl); });
+        return result;
+    }
+
+    // Implements Afina::Storage interface, batch is applied as one call
+    void MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                  std::vector<uint64_t> *cas = nullptr) override {
+        values.clear();
+        values.resize(keys.size());
+        if (cas != nullptr) {
+            cas->assign(keys.size(), 0);
+        }
+        _call([&]() {
+            for (std::size_t i = 0; i < keys.size(); i++) {
+                if (cas != nullptr) {
+                    SimpleLRU::GetCas(keys[i], values[i], (*cas)[i]);
+                } else {
+                    SimpleLRU::GetPinned(keys[i], values[i]);
+                }
+            }
+        });
+    }
+
+    // Implements Afina::Storage interface, batch is applied as one call
+    std::size_t MultiPut(const std::vector<std::pair<std::string, std::string>> &items,
+                         int32_t ttl = 0) override {
+        std::size_t stored = 0;
+        _call([&]() {
+            for (auto &item : items) {
+                stored += SimpleLRU::Put(item.first, item.second, ttl);
+            }
+        });
+        return stored;
+    }
+
+    // Implements Afina::Storage interface, batch is applied as one call
+    std::size_t MultiDelete(const std::vector<std::string> &keys) override {
+        std::size_t deleted = 0;
+        _call([&]() {
+            for (auto &key : keys) {
+                deleted += SimpleLRU::Delete(key);
+            }
+        });
+        return deleted;
+    }
+
+    /**
+     * Each eviction slice is a separate call, so that other calls are served while storage shrinks
+     */
+    bool Resize(std::size_t memory_limit) override {
+        _call([&]() { SimpleLRU::SetMaxSize(memory_limit); });
+        for (bool done = false; !done;) {
+            _call([&]() { done = SimpleLRU::Shrink(_expire_budget); });
+        }
+        return true;
+    }
+
+    // see SimpleLRU.h
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override {
+        _call([&]() { SimpleLRU::GetStats(stats); });
+    }
+
+    // Implements Afina::Storage interface
+    void Freeze(const std::function<void()> &action) override { _combiner.Exclusive(action); }
+
+private:
+    // Call published to the combiner: action is type erased without allocation, exception it throws is
+    // passed back to the calling thread
+    struct Call {
+        void (*run)(void *);
+        void *action;
+        std::exception_ptr error;
+    };
+
+    // Runs action of the call in the thread of combiner
+    static void _apply(Call &call) {
+        try {
+            call.run(call.action);
+        } catch (...) {
+            call.error = std::current_exception();
+        }
+    }
+
+    template <typename F> static void _run(void *action) { (*static_cast<F *>(action))(); }
+
+    // Applies action through the combiner and returns once it is done
+    template <typename F> void _call(F action) {
+        Call call{&CombinedLRU::_run<F>, &action, nullptr};
+        _combiner.Apply(call);
+        if (call.error) {
+            std::rethrow_exception(call.error);
+        }
+    }
+
+    // Work budget of one background expiration slice
+    static constexpr std::size_t _expire_budget = 256;
+
+    Concurrency::FlatCombine<Call> _combiner;
+    Sweeper _sweeper;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_COMBINED_LRU_H
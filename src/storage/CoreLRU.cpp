@@ -0,0 +1,428 @@
+#include "CoreLRU.h"
+
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace Afina {
+namespace Backend {
+
+CoreLRU::CoreLRU(std::size_t shard_count, std::size_t memory_limit, IndexType index_type, EvictionPolicy policy,
+                 Admission admission, Accounting accounting)
+    : _rows(Concurrency::CoreLocal<Row>::cores(), shard_count), _running(true)
+{
+    if (shard_count == 0) {
+        throw std::runtime_error("Invalid shard count");
+    }
+
+    std::size_t shard_size = memory_limit / shard_count;
+    _shards.reserve(shard_count);
+    for (std::size_t i = 0; i < shard_count; i++) {
+        _shards.emplace_back(new Shard(shard_size, index_type, policy, admission, accounting));
+        _shards.back()->storage.CasSequence(i, shard_count);
+    }
+    for (std::size_t i = 0; i < shard_count; i++) {
+        _shards[i]->owner = std::thread(&CoreLRU::_serve, this, i);
+    }
+}
+
+CoreLRU::~CoreLRU()
+{
+    _running.store(false);
+    for (auto &shard : _shards) {
+        {
+            std::lock_guard<std::mutex> guard(shard->mutex);
+            shard->wakeup.notify_one();
+        }
+        shard->owner.join();
+    }
+}
+
+// See CoreLRU.h
+CoreLRU::Row::Row(std::size_t shard_count)
+{
+    rings.reserve(shard_count);
+    for (std::size_t i = 0; i < shard_count; i++) {
+        rings.emplace_back(new Concurrency::SpscRing<Call>(_ring_size));
+    }
+}
+
+// See CoreLRU.h
+void CoreLRU::_serve(std::size_t index)
+{
+    // Pinning is best effort: shard works the same way wherever it runs, just not as fast
+    Concurrency::CoreLocal<Row>::pin(index);
+    Shard &shard = *_shards[index];
+
+    unsigned idle = 0;
+    while (_running.load(std::memory_order_relaxed)) {
+        bool served = false;
+        for (std::size_t r = 0; r < _rows.size(); r++) {
+            Concurrency::SpscRing<Call> &ring = *_rows[r].rings[index];
+            for (Call *call = ring.pop(); call != nullptr; call = ring.pop()) {
+                call->run(call->context, shard.storage);
+                // sender frees the message as soon as it sees the flag
+                call->done.store(true, std::memory_order_release);
+                served = true;
+            }
+        }
+
+        if (served || shard.storage.Expire(_expire_budget) > 0) {
+            idle = 0;
+            continue;
+        }
+        if (++idle < _idle_polls) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Owner checks rings after it sets the flag, sender checks the flag after it pushes, so at least
+        // one of them sees the other. Timeout keeps idle expiration going
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.sleeping.store(true, std::memory_order_seq_cst);
+        if (_idle(index) && _running.load()) {
+            shard.wakeup.wait_for(lock, std::chrono::seconds(1));
+        }
+        shard.sleeping.store(false, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
+
+// See CoreLRU.h
+bool CoreLRU::_idle(std::size_t index)
+{
+    for (std::size_t r = 0; r < _rows.size(); r++) {
+        if (!_rows[r].rings[index]->empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// See CoreLRU.h
+void CoreLRU::_send(std::size_t index, Call &call)
+{
+    Row &row = _rows.local();
+    {
+        std::lock_guard<Concurrency::SpinLock> guard(row.lock);
+        while (!row.rings[index]->push(&call)) {
+            std::this_thread::yield();
+        }
+    }
+
+    Shard &shard = *_shards[index];
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (shard.sleeping.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        shard.wakeup.notify_one();
+    }
+}
+
+// See CoreLRU.h
+void CoreLRU::_wait(Call &call)
+{
+    // Reply takes about as long as a queue round trip, so spin a bit before giving the core away
+    for (unsigned spins = 0; !call.done.load(std::memory_order_acquire); spins++) {
+        if (spins >= 64) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::Put(const std::string &key, const std::string &value, int32_t ttl)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Put(key, value, ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::Put(const std::string &key, std::string &&value, int32_t ttl)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Put(key, std::move(value), ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.PutIfAbsent(key, value, ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.PutIfAbsent(key, std::move(value), ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::Set(const std::string &key, const std::string &value, int32_t ttl)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Set(key, value, ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::Set(const std::string &key, std::string &&value, int32_t ttl)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Set(key, std::move(value), ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::Append(const std::string &key, const std::string &data)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Append(key, data); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::Prepend(const std::string &key, const std::string &data)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Prepend(key, data); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+CoreLRU::CounterResult CoreLRU::Incr(const std::string &key, uint64_t delta, uint64_t &value)
+{
+    CounterResult result = CounterResult::NotFound;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Incr(key, delta, value); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+CoreLRU::CounterResult CoreLRU::Decr(const std::string &key, uint64_t delta, uint64_t &value)
+{
+    CounterResult result = CounterResult::NotFound;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Decr(key, delta, value); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::Delete(const std::string &key)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Delete(key); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::Get(const std::string &key, std::string &value)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.Get(key, value); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::GetPinned(const std::string &key, PinnedValue &value)
+{
+    // Lookup goes to the owning core as any other call, but pinned value is immutable, so sender reads its
+    // bytes afterwards without the owner
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.GetPinned(key, value); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool CoreLRU::GetCas(const std::string &key, PinnedValue &value, uint64_t &cas)
+{
+    bool result = false;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.GetCas(key, value, cas); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+CoreLRU::CasResult CoreLRU::CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                                          int32_t ttl)
+{
+    CasResult result = CasResult::NotFound;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.CompareAndSet(key, value, cas, ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+CoreLRU::CasResult CoreLRU::CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl)
+{
+    CasResult result = CasResult::NotFound;
+    _call(_index(key), [&](SimpleLRU &storage) { result = storage.CompareAndSet(key, std::move(value), cas, ttl); });
+    return result;
+}
+
+// See CoreLRU.h
+template <typename KeyOf, typename Apply> void CoreLRU::_batch(std::size_t count, KeyOf key_of, Apply apply)
+{
+    if (count == 0) {
+        return;
+    }
+
+    // Counting sort of batch positions by shard keeps order of keys within the shard
+    std::vector<std::size_t> shard_of(count);
+    std::vector<std::size_t> starts(_shards.size() + 1, 0);
+    for (std::size_t i = 0; i < count; i++) {
+        shard_of[i] = _index(key_of(i));
+        starts[shard_of[i] + 1]++;
+    }
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+
+    std::vector<std::size_t> order(count);
+    std::vector<std::size_t> next(starts.begin(), starts.end() - 1);
+    for (std::size_t i = 0; i < count; i++) {
+        order[next[shard_of[i]]++] = i;
+    }
+
+    // All messages go out before the first wait, so shards serve their parts at the same time
+    struct Part {
+        const std::size_t *begin;
+        const std::size_t *end;
+        Apply *apply;
+    };
+    std::vector<Part> parts(_shards.size());
+    std::unique_ptr<Call[]> calls(new Call[_shards.size()]);
+    for (std::size_t s = 0; s < _shards.size(); s++) {
+        if (starts[s] == starts[s + 1]) {
+            continue;
+        }
+        parts[s] = Part{order.data() + starts[s], order.data() + starts[s + 1], &apply};
+        calls[s].run = [](void *context, SimpleLRU &storage) {
+            Part &part = *static_cast<Part *>(context);
+            for (const std::size_t *i = part.begin; i != part.end; i++) {
+                (*part.apply)(storage, *i);
+            }
+        };
+        calls[s].context = &parts[s];
+        _send(s, calls[s]);
+    }
+    for (std::size_t s = 0; s < _shards.size(); s++) {
+        if (starts[s] != starts[s + 1]) {
+            _wait(calls[s]);
+        }
+    }
+}
+
+// See CoreLRU.h
+void CoreLRU::MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                       std::vector<uint64_t> *cas)
+{
+    values.clear();
+    values.resize(keys.size());
+    if (cas != nullptr) {
+        cas->assign(keys.size(), 0);
+    }
+    // owners write disjoint elements only
+    _batch(keys.size(), [&keys](std::size_t i) -> const std::string & { return keys[i]; },
+           [&keys, &values, cas](SimpleLRU &storage, std::size_t i) {
+               if (cas != nullptr) {
+                   storage.GetCas(keys[i], values[i], (*cas)[i]);
+               } else {
+                   storage.GetPinned(keys[i], values[i]);
+               }
+           });
+}
+
+// See CoreLRU.h
+std::size_t CoreLRU::MultiPut(const std::vector<std::pair<std::string, std::string>> &items, int32_t ttl)
+{
+    std::vector<char> stored(items.size(), 0);
+    _batch(items.size(), [&items](std::size_t i) -> const std::string & { return items[i].first; },
+           [&items, &stored, ttl](SimpleLRU &storage, std::size_t i) {
+               stored[i] = storage.Put(items[i].first, items[i].second, ttl);
+           });
+    return std::accumulate(stored.begin(), stored.end(), std::size_t(0));
+}
+
+// See CoreLRU.h
+std::size_t CoreLRU::MultiDelete(const std::vector<std::string> &keys)
+{
+    std::vector<char> deleted(keys.size(), 0);
+    _batch(keys.size(), [&keys](std::size_t i) -> const std::string & { return keys[i]; },
+           [&keys, &deleted](SimpleLRU &storage, std::size_t i) { deleted[i] = storage.Delete(keys[i]); });
+    return std::accumulate(deleted.begin(), deleted.end(), std::size_t(0));
+}
+
+// See CoreLRU.h
+void CoreLRU::GetStats(std::vector<std::pair<std::string, std::string>> &stats)
+{
+    std::vector<std::pair<std::string, std::string>> shards;
+    std::vector<std::pair<std::string, std::string>> totals;
+    for (std::size_t i = 0; i < _shards.size(); i++) {
+        std::vector<std::pair<std::string, std::string>> shard_stats;
+        _call(i, [&shard_stats](SimpleLRU &storage) { storage.GetStats(shard_stats); });
+
+        for (std::size_t j = 0; j < shard_stats.size(); j++) {
+            if (i == 0) {
+                totals.emplace_back(shard_stats[j].first, "0");
+            }
+            std::size_t total = std::stoull(totals[j].second) + std::stoull(shard_stats[j].second);
+            totals[j].second = std::to_string(total);
+            shards.emplace_back(std::to_string(i) + ":" + shard_stats[j].first, shard_stats[j].second);
+        }
+    }
+
+    stats.insert(stats.end(), totals.begin(), totals.end());
+    stats.insert(stats.end(), shards.begin(), shards.end());
+}
+
+// See CoreLRU.h
+bool CoreLRU::Scan(const Visitor &visitor)
+{
+    for (auto &shard : _shards) {
+        shard->storage.Scan(visitor);
+    }
+    return true;
+}
+
+// See CoreLRU.h
+void CoreLRU::Freeze(const std::function<void()> &action)
+{
+    std::lock_guard<std::mutex> freeze(_freeze_lock);
+
+    // Each owner reports it is parked and waits for release, so no shard changes while action runs
+    std::atomic<std::size_t> parked(0);
+    std::atomic<bool> released(false);
+    auto park = [&parked, &released](SimpleLRU &) {
+        parked++;
+        while (!released.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    };
+
+    std::unique_ptr<Call[]> calls(new Call[_shards.size()]);
+    for (std::size_t i = 0; i < _shards.size(); i++) {
+        calls[i].run = &_run<decltype(park)>;
+        calls[i].context = &park;
+        _send(i, calls[i]);
+    }
+    while (parked.load() < _shards.size()) {
+        std::this_thread::yield();
+    }
+
+    auto release = [&]() {
+        released.store(true, std::memory_order_release);
+        for (std::size_t i = 0; i < _shards.size(); i++) {
+            _wait(calls[i]);
+        }
+    };
+    try {
+        action();
+    } catch (...) {
+        release();
+        throw;
+    }
+    release();
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,218 @@
+#ifndef AFINA_STORAGE_CORE_LRU_H
+#define AFINA_STORAGE_CORE_LRU_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <afina/Storage.h>
+#include <afina/concurrency/CoreLocal.h>
+#include <afina/concurrency/SpinLock.h>
+
+#include "SimpleLRU.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Shard per core LRU
+ * Keys are spread over SimpleLRU shards by hash as in StripedLRU, but shards have no locks: each one is
+ * owned by a thread pinned to its own core, and nobody else ever touches it. Other threads pass operations
+ * to the owner as messages and wait for the reply.
+ *
+ * There is a single producer single consumer ring per pair of (core of the sender, shard), so senders of
+ * different cores never share memory. Senders of the same core are serialized by a spin lock of their
+ * rings, which is uncontended unless thread got preempted right inside of a push. Batched calls send one
+ * message per shard and shards serve them in parallel.
+ *
+ * Owner polls its rings for a while once they get empty, then sleeps until sender wakes it up. Expired
+ * items are reclaimed by owners in idle time.
+ *
+ * Experimental: sender blocks until the reply comes, so each call costs two handoffs between threads and
+ * storage is slower than a locked one unless every shard owner has a free core
+ */
+class CoreLRU : public Afina::Storage {
+public:
+    /**
+     * Creates cache of shard_count shards sharing memory_limit bytes equally, owners of shards are started
+     * right away
+     *
+     * @param shard_count number of shards, one core each
+     * @param memory_limit total number of bytes for keys and values of all shards
+     * @param index_type kind of key index for each shard
+     * @param policy eviction policy of each shard
+     * @param admission admission policy of each shard
+     * @param accounting memory accounting of each shard
+     */
+    CoreLRU(std::size_t shard_count, std::size_t memory_limit, IndexType index_type = IndexType::Map,
+            EvictionPolicy policy = EvictionPolicy::LRU, Admission admission = Admission::All,
+            Accounting accounting = Accounting::Payload);
+
+    ~CoreLRU();
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface, value is moved into the shard
+    bool Put(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface, value is moved into the shard
+    bool PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface, value is moved into the shard
+    bool Set(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetPinned(const std::string &key, PinnedValue &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface, value is moved into the shard
+    CasResult CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl = 0) override;
+
+    /**
+     * Groups keys by shard and sends one message to each shard of the batch, shards serve them in parallel
+     */
+    void MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                  std::vector<uint64_t> *cas = nullptr) override;
+
+    // Groups keys by shard, see MultiGet
+    std::size_t MultiPut(const std::vector<std::pair<std::string, std::string>> &items,
+                         int32_t ttl = 0) override;
+
+    // Groups keys by shard, see MultiGet
+    std::size_t MultiDelete(const std::vector<std::string> &keys) override;
+
+    /**
+     * Reports totals of all shards followed by statistics of each shard prefixed by its number, as
+     * StripedLRU does
+     */
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override;
+
+    /**
+     * Scans shards one after another directly, owners are not involved: caller guarantees nothing runs
+     */
+    bool Scan(const Visitor &visitor) override;
+
+    /**
+     * Parks all owners, calls action and lets them go
+     */
+    void Freeze(const std::function<void()> &action) override;
+
+private:
+    CoreLRU(const CoreLRU &);            // = delete;
+    CoreLRU &operator=(const CoreLRU &); // = delete;
+
+    /**
+     * # Message to shard owner
+     * Lives on the stack of the sender, which waits for done before leaving
+     */
+    struct Call {
+        void (*run)(void *context, SimpleLRU &storage);
+        void *context;
+        std::atomic<bool> done;
+
+        Call() : run(nullptr), context(nullptr), done(false) {}
+    };
+
+    // Rings of the senders running on the same core, one per shard
+    struct Row {
+        Concurrency::SpinLock lock;
+        std::vector<std::unique_ptr<Concurrency::SpscRing<Call>>> rings;
+
+        explicit Row(std::size_t shard_count);
+    };
+
+    struct Shard {
+        SimpleLRU storage;
+        std::thread owner;
+
+        // Owner sleeps on wakeup when set
+        std::atomic<bool> sleeping;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+
+        Shard(std::size_t max_size, IndexType index_type, EvictionPolicy policy, Admission admission,
+              Accounting accounting)
+            : storage(max_size, index_type, policy, admission, accounting), sleeping(false) {}
+    };
+
+    // Capacity of each ring, sender waits for free slot once it is full
+    static constexpr std::size_t _ring_size = 64;
+    // Number of empty polls before owner goes to sleep
+    static constexpr unsigned _idle_polls = 4096;
+    // Work budget of one expiration slice made in idle time
+    static constexpr std::size_t _expire_budget = 256;
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    Concurrency::CoreLocal<Row> _rows;
+    std::atomic<bool> _running;
+    // Freezes park owners one by one, two of them at once would wait for each other forever
+    std::mutex _freeze_lock;
+    std::hash<std::string> hash;
+
+    std::size_t _index(const std::string &key) const { return hash(key) % _shards.size(); }
+
+    void _serve(std::size_t index);
+    bool _idle(std::size_t index);
+    void _send(std::size_t index, Call &call);
+    static void _wait(Call &call);
+
+    // Call#run of a message carrying F
+    template <typename F> static void _run(void *context, SimpleLRU &storage) {
+        (*static_cast<F *>(context))(storage);
+    }
+
+    // Runs f(storage) in the owner of the given shard and returns once it is done
+    template <typename F> void _call(std::size_t index, F f) {
+        Call call;
+        call.run = &_run<F>;
+        call.context = &f;
+        _send(index, call);
+        _wait(call);
+    }
+
+    // Calls apply(storage, i) in the owner of shard for each i < count, all shards of the batch at once.
+    // key_of(i) is the key of i-th element of the batch
+    template <typename KeyOf, typename Apply> void _batch(std::size_t count, KeyOf key_of, Apply apply);
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_CORE_LRU_H
@@ -0,0 +1,100 @@
+#ifndef AFINA_STORAGE_FREQUENCY_SKETCH_H
+#define AFINA_STORAGE_FREQUENCY_SKETCH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Count-min sketch of key access frequency
+ * Popularity estimation for TinyLFU admission. Counters are 4 bits wide and packed by 16 into 64 bit words,
+ * each key is counted by 4 counters picked by independent hashes of the key and frequency is the smallest
+ * of them. Once number of increments reaches sample size all counters are halved, so that estimation
+ * follows recent history and old popular keys fade out.
+ *
+ * Sketch works with key hashes only, hash must be well mixed
+ */
+class FrequencySketch {
+public:
+    /**
+     * Creates sketch for about given number of distinct keys
+     */
+    explicit FrequencySketch(std::size_t keys) : _additions(0) {
+        // 8 counters per key keep collisions rare, sample of 10 accesses per key ages counters before
+        // they saturate
+        std::size_t counters = 64;
+        while (counters < 8 * keys) {
+            counters <<= 1;
+        }
+        _table.assign(counters / 16, 0);
+        _mask = counters - 1;
+        _sample = 10 * std::max<std::size_t>(keys, 1);
+    }
+
+    /**
+     * Records one more access to the key
+     */
+    void increment(std::size_t hash) {
+        bool added = false;
+        for (unsigned i = 0; i < _depth; i++) {
+            std::size_t pos = _index(hash, i);
+            uint64_t &word = _table[pos >> 4];
+            unsigned shift = (pos & 15) << 2;
+            if (((word >> shift) & 15) != 15) {
+                word += uint64_t(1) << shift;
+                added = true;
+            }
+        }
+
+        if (added && ++_additions >= _sample) {
+            _age();
+        }
+    }
+
+    /**
+     * Returns estimated number of accesses to the key, up to 15
+     */
+    unsigned frequency(std::size_t hash) const {
+        unsigned result = 15;
+        for (unsigned i = 0; i < _depth; i++) {
+            std::size_t pos = _index(hash, i);
+            unsigned count = (_table[pos >> 4] >> ((pos & 15) << 2)) & 15;
+            if (count < result) {
+                result = count;
+            }
+        }
+        return result;
+    }
+
+private:
+    static constexpr unsigned _depth = 4;
+
+    // Counter of the given row, rows use different seeds over the same table
+    std::size_t _index(std::size_t hash, unsigned row) const {
+        static const uint64_t seeds[_depth] = {0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull,
+                                               0xD6E8FEB86659FD93ull};
+        uint64_t x = (uint64_t(hash) + seeds[row]) * seeds[(row + 1) % _depth];
+        return (x ^ (x >> 32)) & _mask;
+    }
+
+    // Halves all counters at once: shift each word and drop bits moved in from the neighbour counter
+    void _age() {
+        for (auto &word : _table) {
+            word = (word >> 1) & 0x7777777777777777ull;
+        }
+        _additions /= 2;
+    }
+
+    std::vector<uint64_t> _table;
+    std::size_t _mask;
+    std::size_t _sample;
+    std::size_t _additions;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_FREQUENCY_SKETCH_H
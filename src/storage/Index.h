@@ -0,0 +1,458 @@
+#ifndef AFINA_STORAGE_INDEX_H
+#define AFINA_STORAGE_INDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Kind of the key index used by storage engines
+ * - Map: std::map, O(log n) string compares per lookup
+ * - Hash: open addressing hash table, O(1) expected
+ * - Swiss: open addressing hash table probed by groups of one byte fingerprints, misses are resolved
+ *   without touching nodes
+ */
+enum class IndexType { Map, Hash, Swiss };
+
+/**
+ * Returns heap footprint of allocation of the given size. Glibc malloc puts 8 byte header in front of
+ * each chunk, rounds chunks up to 16 bytes and never makes them smaller than 32 bytes
+ */
+inline std::size_t heap_size(std::size_t bytes) {
+    std::size_t chunk = (bytes + sizeof(std::size_t) + 15) & ~std::size_t(15);
+    return chunk < 32 ? 32 : chunk;
+}
+
+/**
+ * # Non owning reference to key bytes
+ */
+struct KeyRef {
+    const char *data;
+    std::size_t size;
+
+    KeyRef(const char *data, std::size_t size) : data(data), size(size) {}
+    KeyRef(const std::string &key) : data(key.data()), size(key.size()) {}
+
+    bool operator==(const KeyRef &other) const {
+        return size == other.size && std::memcmp(data, other.data, size) == 0;
+    }
+
+    bool operator<(const KeyRef &other) const {
+        int cmp = std::memcmp(data, other.data, std::min(size, other.size));
+        return cmp < 0 || (cmp == 0 && size < other.size);
+    }
+};
+
+/**
+ * # Key index
+ * Maps keys onto storage nodes, but doesn't own them. Node must provide:
+ * - key(): KeyRef to the stored key
+ * - hash: value returned by Index#hash for the key at the moment of insertion
+ *
+ * Hash is computed once per request by the caller and then passed into all index operations
+ */
+template <typename Node> class Index {
+public:
+    Index() {}
+    virtual ~Index() {}
+
+    /**
+     * Returns hash of the key to be stored in Node#hash and passed into find
+     */
+    virtual std::size_t hash(const std::string &key) const = 0;
+
+    /**
+     * Returns node associated with the given key or nullptr if there is no such one
+     */
+    virtual Node *find(const std::string &key, std::size_t hash) const = 0;
+
+    /**
+     * Adds given node into index. If there is already node with the same key then method returns
+     * false and index remains unchanged
+     */
+    virtual bool insert(Node *node) = 0;
+
+    /**
+     * Removes given node from the index, node must be in the index
+     */
+    virtual void erase(const Node *node) = 0;
+
+    /**
+     * Removes all nodes from the index
+     */
+    virtual void clear() = 0;
+
+    /**
+     * Returns number of nodes in the index
+     */
+    virtual std::size_t size() const = 0;
+
+    /**
+     * Returns number of heap bytes index takes now
+     */
+    virtual std::size_t memory() const = 0;
+
+    /**
+     * Returns number of heap bytes index takes per node on average
+     */
+    virtual std::size_t entry_size() const = 0;
+};
+
+/**
+ * # std::map based index
+ */
+template <typename Node> class MapIndex : public Index<Node> {
+public:
+    std::size_t hash(const std::string &key) const override { return 0; }
+
+    Node *find(const std::string &key, std::size_t hash) const override {
+        auto it = _map.find(KeyRef(key));
+        return it == _map.end() ? nullptr : it->second;
+    }
+
+    bool insert(Node *node) override { return _map.emplace(node->key(), node).second; }
+
+    void erase(const Node *node) override { _map.erase(node->key()); }
+
+    void clear() override { _map.clear(); }
+
+    std::size_t size() const override { return _map.size(); }
+
+    std::size_t memory() const override { return _map.size() * entry_size(); }
+
+    // Tree node is colour and three links followed by the value
+    std::size_t entry_size() const override {
+        return heap_size(4 * sizeof(void *) + sizeof(typename std::map<KeyRef, Node *>::value_type));
+    }
+
+private:
+    std::map<KeyRef, Node *> _map;
+};
+
+/**
+ * # Open addressing hash index
+ * Linear probing over a power of two sized table. Each slot keeps full hash of the key next to the node
+ * pointer, so that probe touches node only if hashes are equal. Deletion uses backward shift, so there are
+ * no tombstones and probe sequences never degrade after churn.
+ */
+template <typename Node> class HashIndex : public Index<Node> {
+public:
+    HashIndex() : _size(0), _shift(64 - _min_bits), _slots(std::size_t(1) << _min_bits) {}
+
+    std::size_t hash(const std::string &key) const override {
+        // Zero marks empty slot
+        std::size_t h = _hasher(key);
+        return h == 0 ? 1 : h;
+    }
+
+    Node *find(const std::string &key, std::size_t hash) const override {
+        return _find(KeyRef(key), hash);
+    }
+
+    bool insert(Node *node) override {
+        if (_find(node->key(), node->hash) != nullptr) {
+            return false;
+        }
+
+        // Keep load factor under 3/4
+        if ((_size + 1) * 4 > _slots.size() * 3) {
+            _grow();
+        }
+        _place(node->hash, node);
+        _size++;
+        return true;
+    }
+
+    void erase(const Node *node) override {
+        std::size_t mask = _slots.size() - 1;
+        std::size_t pos = _home(node->hash);
+        while (_slots[pos].node != node) {
+            pos = (pos + 1) & mask;
+        }
+
+        // Shift back following entries of the cluster which are allowed to take freed slot
+        for (std::size_t next = (pos + 1) & mask; _slots[next].hash != 0; next = (next + 1) & mask) {
+            std::size_t home = _home(_slots[next].hash);
+            if (((next - home) & mask) >= ((next - pos) & mask)) {
+                _slots[pos] = _slots[next];
+                pos = next;
+            }
+        }
+        _slots[pos] = slot();
+        _size--;
+    }
+
+    void clear() override {
+        _slots.assign(std::size_t(1) << _min_bits, slot());
+        _shift = 64 - _min_bits;
+        _size = 0;
+    }
+
+    std::size_t size() const override { return _size; }
+
+    std::size_t memory() const override { return heap_size(_slots.capacity() * sizeof(slot)); }
+
+    // Load factor stays between 3/8 and 3/4, that is two slots per node on average
+    std::size_t entry_size() const override { return 2 * sizeof(slot); }
+
+private:
+    struct slot {
+        std::size_t hash = 0;
+        Node *node = nullptr;
+    };
+
+    static constexpr unsigned _min_bits = 4;
+
+    // Fibonacci hashing: spreads hashes which differ in low bits only, for example keys routed into the same
+    // stripe by hash % stripes
+    std::size_t _home(std::size_t hash) const { return (uint64_t(hash) * 11400714819323198485ull) >> _shift; }
+
+    Node *_find(const KeyRef &key, std::size_t hash) const {
+        std::size_t mask = _slots.size() - 1;
+        for (std::size_t pos = _home(hash);; pos = (pos + 1) & mask) {
+            const slot &s = _slots[pos];
+            if (s.hash == 0) {
+                return nullptr;
+            }
+            if (s.hash == hash && s.node->key() == key) {
+                return s.node;
+            }
+        }
+    }
+
+    void _place(std::size_t hash, Node *node) {
+        std::size_t mask = _slots.size() - 1;
+        std::size_t pos = _home(hash);
+        while (_slots[pos].hash != 0) {
+            pos = (pos + 1) & mask;
+        }
+        _slots[pos].hash = hash;
+        _slots[pos].node = node;
+    }
+
+    void _grow() {
+        std::vector<slot> old(_slots.size() * 2);
+        old.swap(_slots);
+        _shift--;
+        for (auto &s : old) {
+            if (s.hash != 0) {
+                _place(s.hash, s.node);
+            }
+        }
+    }
+
+    std::hash<std::string> _hasher;
+    std::size_t _size;
+    unsigned _shift;
+    std::vector<slot> _slots;
+};
+
+/**
+ * # Swiss table style hash index
+ * Slots are split into groups of 16, each slot has a control byte in a dense array: either empty, deleted
+ * or 7 bits of the key hash. Probe takes a group at once and compares all its control bytes against the
+ * fingerprint by a single SSE2 instruction, so node is touched only on fingerprint match, that is about
+ * once in 128 slots for other keys. Lookup of missing key stops at the first group having an empty slot,
+ * usually the home one, after reading 16 bytes of control array and nothing else.
+ *
+ * Groups are probed by triangular numbers, which visit every group of a power of two sized table. Erased
+ * slot becomes deleted only if its group is full, as only full groups could be passed by a probe.
+ * Table is rebuilt once live and deleted slots take 7/8 of it, doubling if live ones alone take 7/16
+ */
+template <typename Node> class SwissIndex : public Index<Node> {
+public:
+    SwissIndex() { _reset(_min_bits); }
+
+    std::size_t hash(const std::string &key) const override { return _hasher(key); }
+
+    Node *find(const std::string &key, std::size_t hash) const override {
+        return _find(KeyRef(key), hash);
+    }
+
+    bool insert(Node *node) override {
+        if (_find(node->key(), node->hash) != nullptr) {
+            return false;
+        }
+
+        if ((_size + _deleted + 1) * 8 > _slots.size() * 7) {
+            _rehash();
+        }
+        _place(node);
+        _size++;
+        return true;
+    }
+
+    void erase(const Node *node) override {
+        int8_t fingerprint = _fingerprint(node->hash);
+        std::size_t mask = _groups() - 1;
+        std::size_t group = _home(node->hash);
+        for (std::size_t step = 1;; group = (group + step++) & mask) {
+            const int8_t *ctrl = &_ctrl[group * _group_size];
+            for (unsigned m = _match(ctrl, fingerprint); m != 0; m &= m - 1) {
+                std::size_t pos = group * _group_size + __builtin_ctz(m);
+                if (_slots[pos] == node) {
+                    if (_match(ctrl, _empty) != 0) {
+                        _ctrl[pos] = _empty;
+                    } else {
+                        _ctrl[pos] = _deleted_mark;
+                        _deleted++;
+                    }
+                    _slots[pos] = nullptr;
+                    _size--;
+                    return;
+                }
+            }
+        }
+    }
+
+    void clear() override { _reset(_min_bits); }
+
+    std::size_t size() const override { return _size; }
+
+    std::size_t memory() const override {
+        return heap_size(_ctrl.capacity()) + heap_size(_slots.capacity() * sizeof(Node *));
+    }
+
+    // Load factor stays between 7/16 and 7/8, that is a slot and a half per node on average
+    std::size_t entry_size() const override { return (sizeof(Node *) + 1) * 3 / 2; }
+
+private:
+    static constexpr std::size_t _group_size = 16;
+    static constexpr unsigned _min_bits = 1;
+
+    // Control bytes of free slots, fingerprints of live ones are non-negative
+    static constexpr int8_t _empty = -128;
+    static constexpr int8_t _deleted_mark = -2;
+
+    std::size_t _groups() const { return _slots.size() / _group_size; }
+
+    // Home group is taken from the high bits of multiplied hash, fingerprint from the high bits of hash
+    // itself: keys routed into the same stripe by hash % stripes differ there
+    std::size_t _home(std::size_t hash) const { return (uint64_t(hash) * 11400714819323198485ull) >> _shift; }
+    static int8_t _fingerprint(std::size_t hash) { return int8_t(uint64_t(hash) >> 57); }
+
+    // Returns bit mask of the group slots which control byte is equal to the given one
+    static unsigned _match(const int8_t *ctrl, int8_t value) {
+#ifdef __SSE2__
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+        unsigned mask = 0;
+        for (std::size_t i = 0; i < _group_size; i++) {
+            mask |= unsigned(ctrl[i] == value) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Returns bit mask of the group slots which are either empty or deleted
+    static unsigned _match_free(const int8_t *ctrl) {
+#ifdef __SSE2__
+        return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl)));
+#else
+        unsigned mask = 0;
+        for (std::size_t i = 0; i < _group_size; i++) {
+            mask |= unsigned(ctrl[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+    Node *_find(const KeyRef &key, std::size_t hash) const {
+        int8_t fingerprint = _fingerprint(hash);
+        std::size_t mask = _groups() - 1;
+        std::size_t group = _home(hash);
+        for (std::size_t step = 1;; group = (group + step++) & mask) {
+            const int8_t *ctrl = &_ctrl[group * _group_size];
+            for (unsigned m = _match(ctrl, fingerprint); m != 0; m &= m - 1) {
+                Node *node = _slots[group * _group_size + __builtin_ctz(m)];
+                if (node->hash == hash && node->key() == key) {
+                    return node;
+                }
+            }
+            if (_match(ctrl, _empty) != 0) {
+                return nullptr;
+            }
+        }
+    }
+
+    void _place(Node *node) {
+        std::size_t mask = _groups() - 1;
+        std::size_t group = _home(node->hash);
+        for (std::size_t step = 1;; group = (group + step++) & mask) {
+            unsigned free = _match_free(&_ctrl[group * _group_size]);
+            if (free != 0) {
+                std::size_t pos = group * _group_size + __builtin_ctz(free);
+                if (_ctrl[pos] == _deleted_mark) {
+                    _deleted--;
+                }
+                _ctrl[pos] = _fingerprint(node->hash);
+                _slots[pos] = node;
+                return;
+            }
+        }
+    }
+
+    void _reset(unsigned bits) {
+        _ctrl.assign(_group_size << bits, int8_t(_empty));
+        _slots.assign(_group_size << bits, nullptr);
+        _shift = 64 - bits;
+        _size = 0;
+        _deleted = 0;
+    }
+
+    void _rehash() {
+        // Same size rebuild is enough to drop deleted slots unless live ones take most of the table
+        unsigned bits = 64 - _shift;
+        if ((_size + 1) * 16 > _slots.size() * 7) {
+            bits++;
+        }
+
+        std::vector<Node *> old;
+        old.swap(_slots);
+        std::size_t size = _size;
+        _reset(bits);
+        for (Node *node : old) {
+            if (node != nullptr) {
+                _place(node);
+            }
+        }
+        _size = size;
+    }
+
+    std::hash<std::string> _hasher;
+    std::size_t _size;
+    std::size_t _deleted;
+    unsigned _shift;
+    std::vector<int8_t> _ctrl;
+    std::vector<Node *> _slots;
+};
+
+/**
+ * Creates index of the given type
+ */
+template <typename Node> std::unique_ptr<Index<Node>> make_index(IndexType type) {
+    if (type == IndexType::Hash) {
+        return std::unique_ptr<Index<Node>>(new HashIndex<Node>());
+    } else if (type == IndexType::Swiss) {
+        return std::unique_ptr<Index<Node>>(new SwissIndex<Node>());
+    }
+    return std::unique_ptr<Index<Node>>(new MapIndex<Node>());
+}
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_INDEX_H
@@ -0,0 +1,499 @@
+#include "LockFreeLRU.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace Afina {
+namespace Backend {
+
+// See LockFreeLRU.h
+LockFreeLRU::Item *LockFreeLRU::Item::Create(const KeyRef &key, std::size_t hash, std::size_t value_size,
+                                             uint32_t expire) {
+    void *memory = ::operator new(sizeof(Item) + key.size + value_size);
+    Item *item = new (memory) Item();
+    item->next.store(nullptr, std::memory_order_relaxed);
+    item->refs.store(1, std::memory_order_relaxed);
+    // New item survives one pass of the hand, so that it isn't evicted by a concurrent writer right away
+    item->referenced.store(true, std::memory_order_relaxed);
+    item->hash = hash;
+    item->key_size = key.size;
+    item->value_size = value_size;
+    item->expire = expire;
+    item->cas = 0;
+    std::memcpy(reinterpret_cast<char *>(item + 1), key.data, key.size);
+    return item;
+}
+
+// See LockFreeLRU.h
+void LockFreeLRU::Item::Unref(Item *item) {
+    if (item->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        item->~Item();
+        ::operator delete(item);
+    }
+}
+
+LockFreeLRU::LockFreeLRU(size_t max_size, size_t item_size)
+    : _max_size(max_size), _stripes(new Stripe[_stripe_count]), _size(0), _items(0), _evictions(0), _hand(0),
+      _epoch(std::chrono::steady_clock::now()) {
+    std::size_t buckets = _stripe_count;
+    while (buckets < max_size / std::max<size_t>(item_size, 1)) {
+        buckets *= 2;
+    }
+    _bucket_mask = buckets - 1;
+    _buckets.reset(new std::atomic<Item *>[buckets]);
+    for (std::size_t i = 0; i < buckets; i++) {
+        _buckets[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+LockFreeLRU::~LockFreeLRU() {
+    for (std::size_t i = 0; i <= _bucket_mask; i++) {
+        for (Item *item = _buckets[i].load(std::memory_order_relaxed); item != nullptr;) {
+            Item *next = item->next.load(std::memory_order_relaxed);
+            Item::Unref(item);
+            item = next;
+        }
+    }
+    for (std::size_t i = 0; i < _stripe_count; i++) {
+        _stripes[i].limbo.clear(&Item::Unref);
+    }
+}
+
+// See LockFreeLRU.h
+uint32_t LockFreeLRU::_expire_at(int32_t ttl) const { return ttl > 0 ? Now() + ttl : 0; }
+
+// See LockFreeLRU.h
+uint64_t LockFreeLRU::_version(std::size_t bucket) {
+    // Stripes issue versions from disjoint sequences, so there is no shared counter to bounce
+    return ++_stripe(bucket).cas * _stripe_count + bucket % _stripe_count;
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::Item *LockFreeLRU::_lookup(const std::string &key, std::size_t hash, uint32_t now) const {
+    KeyRef ref(key);
+    for (Item *item = _buckets[_bucket(hash)].load(std::memory_order_acquire); item != nullptr;
+         item = item->next.load(std::memory_order_acquire)) {
+        if (item->hash == hash && item->key() == ref) {
+            return item->expired(now) ? nullptr : item;
+        }
+    }
+    return nullptr;
+}
+
+// See LockFreeLRU.h
+std::atomic<LockFreeLRU::Item *> *LockFreeLRU::_find(std::atomic<Item *> *link, const std::string &key,
+                                                     std::size_t hash) {
+    KeyRef ref(key);
+    for (Item *item; (item = link->load(std::memory_order_relaxed)) != nullptr; link = &item->next) {
+        if (item->hash == hash && item->key() == ref) {
+            return link;
+        }
+    }
+    return nullptr;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::_reserve(std::size_t size) {
+    if (size > _max_size) {
+        return false;
+    }
+
+    // Two passes of the hand clear all reference bits and evict everything, give up if that wasn't enough
+    // because of concurrent writers
+    std::size_t passes = 2 * (_bucket_mask + 1);
+    for (std::size_t total = _size.fetch_add(size) + size; total > _max_size; total = _size.load()) {
+        if (passes-- == 0) {
+            _release(size);
+            return false;
+        }
+        _evict_bucket(_hand.fetch_add(1, std::memory_order_relaxed) & _bucket_mask);
+    }
+    return true;
+}
+
+// See LockFreeLRU.h
+void LockFreeLRU::_release(std::size_t size) { _size.fetch_sub(size); }
+
+// See LockFreeLRU.h
+void LockFreeLRU::_retire(Stripe &stripe, Item *item) {
+    stripe.limbo.retire(item, _reclaimer.current());
+    if (stripe.limbo.size() >= _reclaim_batch) {
+        stripe.limbo.reclaim(_reclaimer.advance(), &Item::Unref);
+    }
+}
+
+// See LockFreeLRU.h
+void LockFreeLRU::_unlink(Stripe &stripe, std::atomic<Item *> *link) {
+    Item *item = link->load(std::memory_order_relaxed);
+    link->store(item->next.load(std::memory_order_relaxed), std::memory_order_release);
+    _release(item->key_size + item->value_size);
+    _items.fetch_sub(1, std::memory_order_relaxed);
+    _retire(stripe, item);
+}
+
+// See LockFreeLRU.h
+void LockFreeLRU::_replace(Stripe &stripe, std::atomic<Item *> *link, Item *fresh) {
+    Item *item = link->load(std::memory_order_relaxed);
+    fresh->next.store(item->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    link->store(fresh, std::memory_order_release);
+    _release(item->key_size + item->value_size);
+    _retire(stripe, item);
+}
+
+// See LockFreeLRU.h
+std::size_t LockFreeLRU::_evict_bucket(std::size_t bucket) {
+    Stripe &stripe = _stripe(bucket);
+    std::lock_guard<Concurrency::SpinLock> lock(stripe.lock);
+
+    std::size_t evicted = 0;
+    uint32_t now = Now();
+    std::atomic<Item *> *link = &_buckets[bucket];
+    for (Item *item; (item = link->load(std::memory_order_relaxed)) != nullptr;) {
+        if (item->expired(now) || !item->referenced.exchange(false, std::memory_order_relaxed)) {
+            evicted += !item->expired(now);
+            _unlink(stripe, link);
+        } else {
+            link = &item->next;
+        }
+    }
+    _evictions.fetch_add(evicted, std::memory_order_relaxed);
+    return evicted;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::_store(const std::string &key, const std::string &value, int32_t ttl, Mode mode) {
+    std::size_t charge = key.size() + value.size();
+    if (charge > _max_size || value.size() > UINT32_MAX) {
+        return false;
+    }
+
+    // Memory is reserved and item is built before the lock is taken, negative ttl removes the key instead
+    std::size_t hash = _hasher(key);
+    Item *fresh = nullptr;
+    if (ttl >= 0) {
+        if (!_reserve(charge)) {
+            return false;
+        }
+        fresh = Item::Create(key, hash, value.size(), _expire_at(ttl));
+        std::memcpy(fresh->value_data(), value.data(), value.size());
+    }
+
+    bool stored = true;
+    std::size_t bucket = _bucket(hash);
+    Stripe &stripe = _stripe(bucket);
+    {
+        std::lock_guard<Concurrency::SpinLock> lock(stripe.lock);
+        std::atomic<Item *> *link = _find(&_buckets[bucket], key, hash);
+        if (link != nullptr && link->load(std::memory_order_relaxed)->expired(Now())) {
+            _unlink(stripe, link);
+            link = nullptr;
+        }
+
+        if (link != nullptr ? mode == Mode::PutIfAbsent : mode == Mode::Set) {
+            stored = false;
+        } else if (fresh == nullptr) {
+            if (link != nullptr) {
+                _unlink(stripe, link);
+            }
+        } else {
+            fresh->cas = _version(bucket);
+            if (link != nullptr) {
+                _replace(stripe, link, fresh);
+            } else {
+                fresh->next.store(_buckets[bucket].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                _buckets[bucket].store(fresh, std::memory_order_release);
+                _items.fetch_add(1, std::memory_order_relaxed);
+            }
+            fresh = nullptr;
+        }
+    }
+
+    if (fresh != nullptr) {
+        Item::Unref(fresh);
+        _release(charge);
+    }
+    return stored;
+}
+
+// See LockFreeLRU.h
+template <typename Make> LockFreeLRU::UpdateResult LockFreeLRU::_update(const std::string &key, Make make) {
+    std::size_t hash = _hasher(key);
+    std::size_t bucket = _bucket(hash);
+    Stripe &stripe = _stripe(bucket);
+    for (;;) {
+        // Current item is read without lock and stays pinned, so that its address isn't reused until it is
+        // compared with the one in the chain
+        Item *item;
+        {
+            Concurrency::Epoch::Guard guard(_reclaimer);
+            item = _lookup(key, hash, Now());
+            if (item == nullptr) {
+                return UpdateResult::NotFound;
+            }
+            item->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Item *fresh = make(item);
+        if (fresh == nullptr) {
+            Item::Unref(item);
+            return UpdateResult::Declined;
+        }
+
+        std::size_t charge = fresh->key_size + fresh->value_size;
+        if (charge > _max_size || !_reserve(charge)) {
+            Item::Unref(fresh);
+            Item::Unref(item);
+            return UpdateResult::NotStored;
+        }
+
+        bool stored = false;
+        {
+            std::lock_guard<Concurrency::SpinLock> lock(stripe.lock);
+            std::atomic<Item *> *link = _find(&_buckets[bucket], key, hash);
+            if (link != nullptr && link->load(std::memory_order_relaxed) == item) {
+                fresh->cas = _version(bucket);
+                _replace(stripe, link, fresh);
+                stored = true;
+            }
+        }
+        Item::Unref(item);
+        if (stored) {
+            return UpdateResult::Stored;
+        }
+
+        // Item was changed concurrently, start over with the new one
+        Item::Unref(fresh);
+        _release(charge);
+    }
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Put(const std::string &key, const std::string &value, int32_t ttl) {
+    return _store(key, value, ttl, Mode::Put);
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl) {
+    return _store(key, value, ttl, Mode::PutIfAbsent);
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Set(const std::string &key, const std::string &value, int32_t ttl) {
+    return _store(key, value, ttl, Mode::Set);
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::_concat(const std::string &key, const std::string &data, bool prepend) {
+    return _update(key, [&](const Item *item) -> Item * {
+               std::size_t old_size = item->value_size;
+               if (old_size + data.size() > UINT32_MAX) {
+                   return nullptr;
+               }
+               Item *fresh = Item::Create(item->key(), item->hash, old_size + data.size(), item->expire);
+               char *value = fresh->value_data();
+               std::memcpy(value + (prepend ? data.size() : 0), item->value_data(), old_size);
+               std::memcpy(value + (prepend ? 0 : old_size), data.data(), data.size());
+               return fresh;
+           }) == UpdateResult::Stored;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Append(const std::string &key, const std::string &data) { return _concat(key, data, false); }
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Prepend(const std::string &key, const std::string &data) { return _concat(key, data, true); }
+
+// See LockFreeLRU.h
+LockFreeLRU::CounterResult LockFreeLRU::_count(const std::string &key, uint64_t delta, bool decrement,
+                                               uint64_t &value) {
+    UpdateResult result = _update(key, [&](const Item *item) -> Item * {
+        if (!Count(item->value_data(), item->value_size, delta, decrement, value)) {
+            return nullptr;
+        }
+        std::string counter = std::to_string(value);
+        Item *fresh = Item::Create(item->key(), item->hash, counter.size(), item->expire);
+        std::memcpy(fresh->value_data(), counter.data(), counter.size());
+        return fresh;
+    });
+
+    switch (result) {
+    case UpdateResult::Stored:
+        return CounterResult::Stored;
+    case UpdateResult::Declined:
+        return CounterResult::NotNumber;
+    case UpdateResult::NotFound:
+        return CounterResult::NotFound;
+    default:
+        return CounterResult::NotStored;
+    }
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::CounterResult LockFreeLRU::Incr(const std::string &key, uint64_t delta, uint64_t &value) {
+    return _count(key, delta, false, value);
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::CounterResult LockFreeLRU::Decr(const std::string &key, uint64_t delta, uint64_t &value) {
+    return _count(key, delta, true, value);
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Delete(const std::string &key) {
+    std::size_t hash = _hasher(key);
+    std::size_t bucket = _bucket(hash);
+    Stripe &stripe = _stripe(bucket);
+    std::lock_guard<Concurrency::SpinLock> lock(stripe.lock);
+
+    std::atomic<Item *> *link = _find(&_buckets[bucket], key, hash);
+    if (link == nullptr) {
+        return false;
+    }
+
+    bool expired = link->load(std::memory_order_relaxed)->expired(Now());
+    _unlink(stripe, link);
+    return !expired;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Get(const std::string &key, std::string &value) {
+    Concurrency::Epoch::Guard guard(_reclaimer);
+    Item *item = _lookup(key, _hasher(key), Now());
+    if (item == nullptr) {
+        return false;
+    }
+
+    if (!item->referenced.load(std::memory_order_relaxed)) {
+        item->referenced.store(true, std::memory_order_relaxed);
+    }
+    value.assign(item->value_data(), item->value_size);
+    return true;
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::GetPinned(const std::string &key, PinnedValue &value) {
+    uint64_t cas;
+    return GetCas(key, value, cas);
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) {
+    Concurrency::Epoch::Guard guard(_reclaimer);
+    Item *item = _lookup(key, _hasher(key), Now());
+    if (item == nullptr) {
+        return false;
+    }
+
+    // Reference bit is written only if it is clear, so that hot items don't bounce cache line of readers
+    if (!item->referenced.load(std::memory_order_relaxed)) {
+        item->referenced.store(true, std::memory_order_relaxed);
+    }
+    item->refs.fetch_add(1, std::memory_order_relaxed);
+    value = PinnedValue(item->value_data(), item->value_size, item, &Item::Release);
+    cas = item->cas;
+    return true;
+}
+
+// See LockFreeLRU.h
+LockFreeLRU::CasResult LockFreeLRU::CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                                                  int32_t ttl) {
+    if (key.size() + value.size() > _max_size || value.size() > UINT32_MAX) {
+        return CasResult::NotStored;
+    }
+
+    if (ttl < 0) {
+        std::size_t hash = _hasher(key);
+        std::size_t bucket = _bucket(hash);
+        Stripe &stripe = _stripe(bucket);
+        std::lock_guard<Concurrency::SpinLock> lock(stripe.lock);
+
+        std::atomic<Item *> *link = _find(&_buckets[bucket], key, hash);
+        if (link == nullptr || link->load(std::memory_order_relaxed)->expired(Now())) {
+            return CasResult::NotFound;
+        }
+        if (link->load(std::memory_order_relaxed)->cas != cas) {
+            return CasResult::Exists;
+        }
+        _unlink(stripe, link);
+        return CasResult::Stored;
+    }
+
+    UpdateResult result = _update(key, [&](const Item *item) -> Item * {
+        if (item->cas != cas) {
+            return nullptr;
+        }
+        Item *fresh = Item::Create(item->key(), item->hash, value.size(), _expire_at(ttl));
+        std::memcpy(fresh->value_data(), value.data(), value.size());
+        return fresh;
+    });
+
+    switch (result) {
+    case UpdateResult::Stored:
+        return CasResult::Stored;
+    case UpdateResult::Declined:
+        return CasResult::Exists;
+    case UpdateResult::NotFound:
+        return CasResult::NotFound;
+    default:
+        return CasResult::NotStored;
+    }
+}
+
+// See LockFreeLRU.h
+void LockFreeLRU::GetStats(std::vector<std::pair<std::string, std::string>> &stats) {
+    std::size_t items = _items.load(std::memory_order_relaxed);
+    std::size_t retired = 0;
+    for (std::size_t i = 0; i < _stripe_count; i++) {
+        std::lock_guard<Concurrency::SpinLock> lock(_stripes[i].lock);
+        retired += _stripes[i].limbo.size();
+    }
+
+    stats.emplace_back("limit_maxbytes", std::to_string(_max_size));
+    stats.emplace_back("bytes", std::to_string(_size.load()));
+    stats.emplace_back("heap_bytes", std::to_string(_size.load() + items * heap_size(sizeof(Item)) +
+                                                    (_bucket_mask + 1) * sizeof(Item *) +
+                                                    _stripe_count * sizeof(Stripe)));
+    stats.emplace_back("curr_items", std::to_string(items));
+    stats.emplace_back("evictions", std::to_string(_evictions.load(std::memory_order_relaxed)));
+    stats.emplace_back("retired_items", std::to_string(retired));
+}
+
+// See LockFreeLRU.h
+bool LockFreeLRU::Scan(const Visitor &visitor) {
+    uint32_t now = Now();
+    for (std::size_t i = 0; i <= _bucket_mask; i++) {
+        for (Item *item = _buckets[i].load(std::memory_order_acquire); item != nullptr;
+             item = item->next.load(std::memory_order_acquire)) {
+            if (item->expired(now)) {
+                continue;
+            }
+            int32_t ttl = item->expire != 0 ? item->expire - now : 0;
+            visitor(item->key_data(), item->key_size, item->value_data(), item->value_size, ttl);
+        }
+    }
+    return true;
+}
+
+// See LockFreeLRU.h
+void LockFreeLRU::Freeze(const std::function<void()> &action) {
+    for (std::size_t i = 0; i < _stripe_count; i++) {
+        _stripes[i].lock.lock();
+    }
+
+    try {
+        action();
+    } catch (...) {
+        for (std::size_t i = _stripe_count; i > 0; i--) {
+            _stripes[i - 1].lock.unlock();
+        }
+        throw;
+    }
+    for (std::size_t i = _stripe_count; i > 0; i--) {
+        _stripes[i - 1].lock.unlock();
+    }
+}
+
+} // namespace Backend
+} // namespace Afina
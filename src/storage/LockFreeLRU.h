@@ -0,0 +1,198 @@
+#ifndef AFINA_STORAGE_LOCK_FREE_LRU_H
+#define AFINA_STORAGE_LOCK_FREE_LRU_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <afina/Storage.h>
+#include <afina/concurrency/Epoch.h>
+#include <afina/concurrency/SpinLock.h>
+
+#include "Index.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Lock free reads implementation
+ * Thread safe hash table with chained buckets, reads take no locks at all.
+ *
+ * Items are immutable once published: every store builds a new item and swaps it into the bucket chain by
+ * a single pointer store, so reader sees either old or new value. Readers walk chains inside of
+ * Concurrency::Epoch guard and pin item by reference count, replaced and removed items are reclaimed once
+ * no reader could reach them. Writers of the same bucket stripe are serialized by spin lock, which is held
+ * for a chain walk and a pointer store only.
+ *
+ * Eviction is CLOCK over buckets: read sets reference bit of the item, writer running out of memory moves
+ * shared hand over buckets one by one, clears set bits and evicts items having them clear. Writers evict
+ * before taking their own lock, so locks never nest and concurrent writers evict different buckets.
+ *
+ * Number of buckets is fixed by memory limit, expired items are never returned and get dropped by writers
+ * and eviction on the way
+ */
+class LockFreeLRU : public Afina::Storage {
+public:
+    /**
+     * @param max_size number of bytes of keys and values storage could keep
+     * @param item_size expected size of key and value, number of buckets is max_size / item_size
+     */
+    LockFreeLRU(size_t max_size = 1024, size_t item_size = 64);
+    ~LockFreeLRU();
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    /**
+     * Replaces item by a copy with grown value under the stripe lock
+     */
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Same as Append
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Same as Append
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Same as Append
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetPinned(const std::string &key, PinnedValue &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override;
+
+    /**
+     * Reports totals as SimpleLRU does, followed by:
+     * - evictions: number of items evicted to free memory
+     * - retired_items: number of items unlinked but not reclaimed yet
+     */
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override;
+
+    /**
+     * Scans buckets one after another, there is no eviction order to restore
+     */
+    bool Scan(const Visitor &visitor) override;
+
+    /**
+     * Takes all stripe locks, readers keep running
+     */
+    void Freeze(const std::function<void()> &action) override;
+
+protected:
+    /**
+     * Returns engine time: number of seconds since engine creation
+     */
+    virtual uint32_t Now() const {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - _epoch).count();
+    }
+
+private:
+    LockFreeLRU(const LockFreeLRU &);            // = delete;
+    LockFreeLRU &operator=(const LockFreeLRU &); // = delete;
+
+    /**
+     * # Immutable item
+     * Header followed by key and value bytes. Chain owns one reference and each PinnedValue one more
+     */
+    struct Item {
+        std::atomic<Item *> next;
+        std::atomic<uint32_t> refs;
+        // CLOCK reference bit
+        std::atomic<bool> referenced;
+        std::size_t hash;
+        uint32_t key_size;
+        uint32_t value_size;
+        // engine time in seconds item expires at, 0 if never
+        uint32_t expire;
+        // version of the value, see Storage#GetCas
+        uint64_t cas;
+
+        const char *key_data() const { return reinterpret_cast<const char *>(this + 1); }
+        KeyRef key() const { return KeyRef(key_data(), key_size); }
+        const char *value_data() const { return key_data() + key_size; }
+        char *value_data() { return reinterpret_cast<char *>(this + 1) + key_size; }
+
+        bool expired(uint32_t now) const { return expire != 0 && expire <= now; }
+
+        static Item *Create(const KeyRef &key, std::size_t hash, std::size_t value_size, uint32_t expire);
+        static void Unref(Item *item);
+        static void Release(void *item) { Unref(static_cast<Item *>(item)); }
+    };
+
+    // Writers of the buckets sharing stripe, padded to take a cache line
+    struct Stripe {
+        Concurrency::SpinLock lock;
+        // The last version issued by the stripe, see _version
+        uint64_t cas = 0;
+        Concurrency::Limbo<Item> limbo;
+        char padding[64];
+    };
+
+    static constexpr std::size_t _stripe_count = 256;
+    // Number of retired items which triggers reclamation attempt
+    static constexpr std::size_t _reclaim_batch = 64;
+
+    std::size_t _max_size;
+    std::size_t _bucket_mask;
+    std::unique_ptr<std::atomic<Item *>[]> _buckets;
+    std::unique_ptr<Stripe[]> _stripes;
+
+    Concurrency::Epoch _reclaimer;
+    std::hash<std::string> _hasher;
+
+    // Bytes of keys and values charged, including reservations of writers in progress
+    std::atomic<std::size_t> _size;
+    std::atomic<std::size_t> _items;
+    std::atomic<std::size_t> _evictions;
+    // CLOCK hand, bucket to check next modulo number of buckets
+    std::atomic<std::size_t> _hand;
+    std::chrono::steady_clock::time_point _epoch;
+
+    uint32_t _expire_at(int32_t ttl) const;
+    std::size_t _bucket(std::size_t hash) const { return hash & _bucket_mask; }
+    Stripe &_stripe(std::size_t bucket) const { return _stripes[bucket % _stripe_count]; }
+    uint64_t _version(std::size_t bucket);
+
+    Item *_lookup(const std::string &key, std::size_t hash, uint32_t now) const;
+    std::atomic<Item *> *_find(std::atomic<Item *> *link, const std::string &key, std::size_t hash);
+    bool _reserve(std::size_t size);
+    void _release(std::size_t size);
+    void _retire(Stripe &stripe, Item *item);
+    void _unlink(Stripe &stripe, std::atomic<Item *> *link);
+    void _replace(Stripe &stripe, std::atomic<Item *> *link, Item *fresh);
+    std::size_t _evict_bucket(std::size_t bucket);
+
+    enum class Mode { Put, PutIfAbsent, Set };
+    bool _store(const std::string &key, const std::string &value, int32_t ttl, Mode mode);
+
+    // Replaces current item of the key by the one make builds out of it, make returns nullptr to decline
+    enum class UpdateResult { Stored, Declined, NotFound, NotStored };
+    template <typename Make> UpdateResult _update(const std::string &key, Make make);
+    bool _concat(const std::string &key, const std::string &data, bool prepend);
+    CounterResult _count(const std::string &key, uint64_t delta, bool decrement, uint64_t &value);
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_LOCK_FREE_LRU_H
@@ -0,0 +1,212 @@
+#ifndef AFINA_STORAGE_LOGGED_STORAGE_H
+#define AFINA_STORAGE_LOGGED_STORAGE_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <afina/Storage.h>
+
+#include "MutationLog.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Storage with mutation log
+ * Decorates thread safe storage: successful mutations get recorded into the
+ * MutationLog, which is replayed on Start. With Always sync policy mutation returns only once it is on the
+ * disk, otherwise it returns right away.
+ *
+ * Storage change and log record of the same key are done under the same key lock, so log keeps mutations
+ * of each key in the order they were applied. Freeze takes all key locks first, so that log compaction sees
+ * every applied mutation already queued and none applied but not queued yet
+ */
+class LoggedStorage : public Afina::Storage {
+public:
+    LoggedStorage(std::shared_ptr<Afina::Storage> storage, const std::string &path,
+                  SyncPolicy policy = SyncPolicy::Interval,
+                  std::chrono::milliseconds interval = std::chrono::milliseconds(1000),
+                  std::size_t compact_size = 64 * 1024 * 1024)
+        : _storage(std::move(storage)), _policy(policy), _log(path, policy, interval, compact_size), _replayed(0) {}
+
+    ~LoggedStorage() { _log.Stop(); }
+
+    /**
+     * Starts storage, replays the log into it and starts logging
+     */
+    void Start() override {
+        _storage->Start();
+        _replayed = _log.Replay(*_storage);
+        _log.Start(*this);
+    }
+
+    // Implements Afina::Storage interface
+    void Stop() override {
+        _log.Stop();
+        _storage->Stop();
+    }
+
+    /**
+     * Returns number of mutations replayed on Start
+     */
+    std::size_t Replayed() const { return _replayed; }
+
+    /**
+     * Rewrites log as image of the storage in background, see MutationLog#Compact
+     */
+    void Compact() { _log.Compact(); }
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override {
+        return _mutate(key, [&]() { return _storage->Put(key, value, ttl); },
+                       [&]() { return _log.Put(key, value, ttl); });
+    }
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override {
+        return _mutate(key, [&]() { return _storage->PutIfAbsent(key, value, ttl); },
+                       [&]() { return _log.Put(key, value, ttl); });
+    }
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override {
+        return _mutate(key, [&]() { return _storage->Set(key, value, ttl); },
+                       [&]() { return _log.Put(key, value, ttl); });
+    }
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override {
+        return _mutate(key, [&]() { return _storage->Append(key, data); },
+                       [&]() { return _log.Append(key, data); });
+    }
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override {
+        return _mutate(key, [&]() { return _storage->Prepend(key, data); },
+                       [&]() { return _log.Prepend(key, data); });
+    }
+
+    // Implements Afina::Storage interface
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override {
+        CounterResult result = CounterResult::NotStored;
+        _mutate(key,
+                [&]() {
+                    result = _storage->Incr(key, delta, value);
+                    return result == CounterResult::Stored;
+                },
+                [&]() { return _log.Counter(key, value); });
+        return result;
+    }
+
+    // Implements Afina::Storage interface
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override {
+        CounterResult result = CounterResult::NotStored;
+        _mutate(key,
+                [&]() {
+                    result = _storage->Decr(key, delta, value);
+                    return result == CounterResult::Stored;
+                },
+                [&]() { return _log.Counter(key, value); });
+        return result;
+    }
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override {
+        return _mutate(key, [&]() { return _storage->Delete(key); }, [&]() { return _log.Delete(key); });
+    }
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override { return _storage->Get(key, value); }
+
+    // Implements Afina::Storage interface
+    bool GetPinned(const std::string &key, PinnedValue &value) override { return _storage->GetPinned(key, value); }
+
+    // Implements Afina::Storage interface
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override {
+        return _storage->GetCas(key, value, cas);
+    }
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override {
+        CasResult result = CasResult::NotStored;
+        _mutate(key,
+                [&]() {
+                    result = _storage->CompareAndSet(key, value, cas, ttl);
+                    return result == CasResult::Stored;
+                },
+                [&]() { return _log.Put(key, value, ttl); });
+        return result;
+    }
+
+    // Implements Afina::Storage interface
+    void MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                  std::vector<uint64_t> *cas = nullptr) override {
+        _storage->MultiGet(keys, values, cas);
+    }
+
+    /**
+     * Reports storage statistics followed by log ones, see MutationLog#GetStats
+     */
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override {
+        _storage->GetStats(stats);
+        _log.GetStats(stats);
+    }
+
+    // Implements Afina::Storage interface
+    bool Scan(const Visitor &visitor) override { return _storage->Scan(visitor); }
+
+    /**
+     * Waits for mutations in progress to be queued into the log, then freezes the storage
+     */
+    void Freeze(const std::function<void()> &action) override {
+        std::unique_lock<std::mutex> locks[_key_lock_count];
+        for (std::size_t i = 0; i < _key_lock_count; i++) {
+            locks[i] = std::unique_lock<std::mutex>(_key_locks[i]);
+        }
+        _storage->Freeze(action);
+    }
+
+    // Implements Afina::Storage interface, layout changes aren't logged
+    bool Resize(std::size_t memory_limit) override { return _storage->Resize(memory_limit); }
+
+    // Implements Afina::Storage interface
+    bool Reshard(std::size_t shard_count) override { return _storage->Reshard(shard_count); }
+
+private:
+    LoggedStorage(const LoggedStorage &);            // = delete;
+    LoggedStorage &operator=(const LoggedStorage &); // = delete;
+
+    template <typename Apply, typename Record> bool _mutate(const std::string &key, Apply apply, Record record) {
+        uint64_t seq;
+        {
+            std::lock_guard<std::mutex> lock(_key_locks[_hash(key) % _key_lock_count]);
+            if (!apply()) {
+                return false;
+            }
+            seq = record();
+        }
+
+        if (_policy == SyncPolicy::Always) {
+            _log.Wait(seq);
+        }
+        return true;
+    }
+
+    static constexpr std::size_t _key_lock_count = 64;
+
+    std::shared_ptr<Afina::Storage> _storage;
+    const SyncPolicy _policy;
+    MutationLog _log;
+    std::size_t _replayed;
+
+    std::hash<std::string> _hash;
+    std::mutex _key_locks[_key_lock_count];
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_LOGGED_STORAGE_H
@@ -0,0 +1,76 @@
+#ifndef AFINA_STORAGE_MEMORY_BUDGET_H
+#define AFINA_STORAGE_MEMORY_BUDGET_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Shared memory budget
+ * Bytes of the global memory limit not held by any storage at the moment. Storages borrow from it by
+ * chunks whenever they run out of own limit, before anything gets evicted, and whoever shrinks a storage
+ * returns freed bytes back. Lock free, so storages borrow under their own locks only
+ */
+class MemoryBudget {
+public:
+    /**
+     * @param free number of bytes available at start
+     * @param chunk borrowing granularity, at least 1
+     */
+    MemoryBudget(std::size_t free, std::size_t chunk) : _free(free), _chunk(std::max<std::size_t>(chunk, 1)) {}
+
+    /**
+     * Takes whole chunks covering size bytes, or everything left if there is less. Returns number of bytes
+     * taken, 0 if budget is exhausted
+     */
+    std::size_t Borrow(std::size_t size) {
+        std::size_t wanted = (size + _chunk - 1) / _chunk * _chunk;
+        return _take(wanted);
+    }
+
+    /**
+     * Takes at most size bytes exactly, returns number of bytes taken
+     */
+    std::size_t Take(std::size_t size) { return _take(size); }
+
+    /**
+     * Puts bytes back, they could be borrowed by anyone then
+     */
+    void Return(std::size_t size) { _free.fetch_add(size, std::memory_order_acq_rel); }
+
+    /**
+     * Replaces number of bytes available, caller guarantees nobody borrows meanwhile
+     */
+    void Reset(std::size_t free) { _free.store(free, std::memory_order_release); }
+
+    std::size_t Free() const { return _free.load(std::memory_order_acquire); }
+
+    std::size_t Chunk() const { return _chunk; }
+
+private:
+    MemoryBudget(const MemoryBudget &);            // = delete;
+    MemoryBudget &operator=(const MemoryBudget &); // = delete;
+
+    std::size_t _take(std::size_t size) {
+        std::size_t free = _free.load(std::memory_order_acquire);
+        std::size_t taken;
+        do {
+            taken = std::min(size, free);
+            if (taken == 0) {
+                return 0;
+            }
+        } while (!_free.compare_exchange_weak(free, free - taken, std::memory_order_acq_rel));
+        return taken;
+    }
+
+    std::atomic<std::size_t> _free;
+    const std::size_t _chunk;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MEMORY_BUDGET_H
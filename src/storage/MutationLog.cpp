@@ -0,0 +1,465 @@
+#include "MutationLog.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+enum RecordType : uint32_t {
+    PutRecord = 1,
+    DeleteRecord = 2,
+    AppendRecord = 3,
+    PrependRecord = 4,
+    CounterRecord = 5
+};
+
+struct RecordHeader {
+    uint32_t checksum;
+    uint32_t type;
+    uint32_t key_size;
+    uint32_t value_size;
+    int64_t expire;
+};
+
+// FNV-1a over the record after the checksum field
+uint32_t checksum(const char *data, std::size_t size) {
+    uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < size; i++) {
+        hash = (hash ^ uint8_t(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+std::string encode(uint32_t type, const char *key, std::size_t key_size, const char *value, std::size_t value_size,
+                   int64_t expire) {
+    RecordHeader header{0, type, uint32_t(key_size), uint32_t(value_size), expire};
+    std::string record(sizeof(header) + key_size + value_size, '\0');
+    char *out = &record[0];
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), key, key_size);
+    std::memcpy(out + sizeof(header) + key_size, value, value_size);
+
+    header.checksum = checksum(out + sizeof(header.checksum), record.size() - sizeof(header.checksum));
+    std::memcpy(out, &header.checksum, sizeof(header.checksum));
+    return record;
+}
+
+int64_t expire_at(int32_t ttl) { return ttl > 0 ? int64_t(std::time(nullptr)) + ttl : 0; }
+
+bool write_all(int fd, const char *data, std::size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+} // namespace
+
+MutationLog::MutationLog(const std::string &path, SyncPolicy policy, std::chrono::milliseconds interval,
+                         std::size_t compact_size)
+    : _path(path), _policy(policy), _interval(interval), _compact_size(compact_size), _storage(nullptr), _fd(-1),
+      _running(false), _compact_requested(false), _next_seq(1), _durable(0), _size(0), _base_size(0), _child(-1),
+      _compact_mark(0), _bytes(0), _groups(0), _syncs(0), _compactions(0), _errors(0) {}
+
+// See MutationLog.h
+std::size_t MutationLog::Replay(Afina::Storage &storage) {
+    int fd = ::open(_path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        throw std::runtime_error("Failed to open log " + _path + ": " + std::strerror(errno));
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return 0;
+    }
+
+    std::size_t size = st.st_size;
+    void *mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Failed to map log " + _path + ": " + std::strerror(errno));
+    }
+    ::madvise(mapped, size, MADV_SEQUENTIAL);
+
+    const char *data = static_cast<const char *>(mapped);
+    std::size_t pos = 0;
+    std::size_t applied = 0;
+    std::time_t now = std::time(nullptr);
+    while (size - pos >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        std::memcpy(&header, data + pos, sizeof(header));
+        std::size_t record_size = sizeof(header) + std::size_t(header.key_size) + header.value_size;
+        if (size - pos < record_size ||
+            checksum(data + pos + sizeof(header.checksum), record_size - sizeof(header.checksum)) != header.checksum) {
+            break;
+        }
+
+        std::string key(data + pos + sizeof(header), header.key_size);
+        std::string value(data + pos + sizeof(header) + header.key_size, header.value_size);
+        if (header.type == PutRecord) {
+            // expired association is the same as removed one
+            int64_t ttl = header.expire != 0 ? header.expire - now : 0;
+            if (header.expire != 0 && ttl <= 0) {
+                ttl = -1;
+            }
+            ttl = std::min<int64_t>(ttl, INT32_MAX);
+            storage.Put(key, value, int32_t(ttl));
+        } else if (header.type == AppendRecord) {
+            storage.Append(key, value);
+        } else if (header.type == PrependRecord) {
+            storage.Prepend(key, value);
+        } else if (header.type == CounterRecord) {
+            // counter is reset and incremented to the recorded one, so that expiration time stays as it is
+            uint64_t target = 0, counter;
+            std::memcpy(&target, value.data(), std::min(value.size(), sizeof(target)));
+            if (storage.Decr(key, UINT64_MAX, counter) == Afina::Storage::CounterResult::Stored) {
+                storage.Incr(key, target, counter);
+            }
+        } else {
+            storage.Delete(key);
+        }
+        applied++;
+        pos += record_size;
+    }
+
+    ::munmap(mapped, size);
+    if (pos < size && ::ftruncate(fd, pos) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to truncate log " + _path + ": " + std::strerror(errno));
+    }
+    ::close(fd);
+    return applied;
+}
+
+// See MutationLog.h
+void MutationLog::Start(Afina::Storage &storage) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_running) {
+        return;
+    }
+
+    _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        throw std::runtime_error("Failed to open log " + _path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    _size = ::fstat(_fd, &st) == 0 ? st.st_size : 0;
+    _base_size = _size;
+    _bytes = _size;
+
+    _storage = &storage;
+    _running = true;
+    _thread = std::thread(&MutationLog::_loop, this);
+}
+
+// See MutationLog.h
+void MutationLog::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _work.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+// See MutationLog.h
+uint64_t MutationLog::Put(const std::string &key, const std::string &value, int32_t ttl) {
+    if (ttl < 0) {
+        return Delete(key);
+    }
+    return _enqueue(encode(PutRecord, key.data(), key.size(), value.data(), value.size(), expire_at(ttl)));
+}
+
+// See MutationLog.h
+uint64_t MutationLog::Append(const std::string &key, const std::string &data) {
+    return _enqueue(encode(AppendRecord, key.data(), key.size(), data.data(), data.size(), 0));
+}
+
+// See MutationLog.h
+uint64_t MutationLog::Prepend(const std::string &key, const std::string &data) {
+    return _enqueue(encode(PrependRecord, key.data(), key.size(), data.data(), data.size(), 0));
+}
+
+// See MutationLog.h
+uint64_t MutationLog::Counter(const std::string &key, uint64_t value) {
+    return _enqueue(encode(CounterRecord, key.data(), key.size(), reinterpret_cast<const char *>(&value),
+                           sizeof(value), 0));
+}
+
+// See MutationLog.h
+uint64_t MutationLog::Delete(const std::string &key) {
+    return _enqueue(encode(DeleteRecord, key.data(), key.size(), nullptr, 0, 0));
+}
+
+// See MutationLog.h
+void MutationLog::Wait(uint64_t seq) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this, seq] { return _durable >= seq || !_running; });
+}
+
+// See MutationLog.h
+void MutationLog::Compact() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _compact_requested = true;
+    }
+    _work.notify_one();
+}
+
+// See MutationLog.h
+void MutationLog::GetStats(std::vector<std::pair<std::string, std::string>> &stats) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    stats.emplace_back("log_bytes", std::to_string(_bytes));
+    stats.emplace_back("log_groups", std::to_string(_groups));
+    stats.emplace_back("log_syncs", std::to_string(_syncs));
+    stats.emplace_back("log_compactions", std::to_string(_compactions));
+    stats.emplace_back("log_errors", std::to_string(_errors));
+}
+
+// See MutationLog.h
+uint64_t MutationLog::_enqueue(std::string record) {
+    uint64_t seq;
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        seq = _next_seq++;
+        first = _queue.empty();
+        _queue.push_back(Entry{seq, std::move(record)});
+    }
+    // Log thread is woken once per group, the rest of the group just joins it
+    if (first) {
+        _work.notify_one();
+    }
+    return seq;
+}
+
+// See MutationLog.h
+void MutationLog::_loop() {
+    using clock = std::chrono::steady_clock;
+    clock::time_point last_sync = clock::now();
+    std::vector<Entry> group;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    uint64_t written = _durable;
+    while (true) {
+        auto ready = [this] { return !_queue.empty() || !_running || _compact_requested; };
+        if (_child > 0) {
+            // poll compaction child from time to time
+            _work.wait_for(lock, std::chrono::milliseconds(10), ready);
+        } else if (_policy == SyncPolicy::Interval && written > _durable) {
+            _work.wait_until(lock, last_sync + _interval, ready);
+        } else {
+            _work.wait(lock, ready);
+        }
+
+        group.clear();
+        group.swap(_queue);
+        bool running = _running;
+        bool compact = _compact_requested;
+        _compact_requested = false;
+        lock.unlock();
+
+        bool ok = true;
+        if (!group.empty()) {
+            ok = _write(_fd, group);
+            written = group.back().seq;
+            if (_child > 0) {
+                _compact_tail.insert(_compact_tail.end(), group.begin(), group.end());
+            }
+        }
+
+        uint64_t durable = 0;
+        if (_policy == SyncPolicy::None) {
+            durable = written;
+        } else if (written > _durable &&
+                   (_policy == SyncPolicy::Always || !running || clock::now() >= last_sync + _interval)) {
+            ok = ::fdatasync(_fd) == 0 && ok;
+            last_sync = clock::now();
+            durable = written;
+        }
+
+        if (_child > 0) {
+            _finish_compaction(!running);
+        }
+        if (running && _child <= 0 && (compact || (_size >= _compact_size && _size >= 2 * _base_size))) {
+            _start_compaction();
+        }
+
+        lock.lock();
+        _bytes = _size;
+        _groups += group.empty() ? 0 : 1;
+        _syncs += durable > _durable && _policy != SyncPolicy::None ? 1 : 0;
+        _errors += ok ? 0 : 1;
+        if (durable > _durable) {
+            _durable = durable;
+            _done.notify_all();
+        }
+        if (!running && _queue.empty()) {
+            break;
+        }
+    }
+    _done.notify_all();
+}
+
+// See MutationLog.h
+bool MutationLog::_write(int fd, const std::vector<Entry> &group) {
+    // writev takes at most IOV_MAX pieces at once, and could write less than asked
+    std::vector<struct iovec> iov;
+    iov.reserve(std::min<std::size_t>(group.size(), IOV_MAX));
+    for (std::size_t i = 0; i < group.size();) {
+        iov.clear();
+        std::size_t total = 0;
+        for (; i < group.size() && iov.size() < IOV_MAX; i++) {
+            iov.push_back({const_cast<char *>(group[i].record.data()), group[i].record.size()});
+            total += group[i].record.size();
+        }
+
+        std::size_t done = 0;
+        struct iovec *pos = iov.data();
+        int count = iov.size();
+        while (done < total) {
+            ssize_t n = ::writev(fd, pos, count);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            done += n;
+            if (fd == _fd) {
+                _size += n;
+            }
+            while (count > 0 && std::size_t(n) >= pos->iov_len) {
+                n -= pos->iov_len;
+                pos++;
+                count--;
+            }
+            if (count > 0) {
+                pos->iov_base = static_cast<char *>(pos->iov_base) + n;
+                pos->iov_len -= n;
+            }
+        }
+    }
+    return true;
+}
+
+// See MutationLog.h
+bool MutationLog::_write_image(Afina::Storage &storage, const std::string &path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    std::time_t now = std::time(nullptr);
+    bool ok = true;
+    bool scanned = storage.Scan([&](const char *key, std::size_t key_size, const char *value, std::size_t value_size,
+                                    int32_t ttl) {
+        std::string record = encode(PutRecord, key, key_size, value, value_size, ttl > 0 ? int64_t(now) + ttl : 0);
+        ok = ok && write_all(fd, record.data(), record.size());
+    });
+
+    ok = scanned && ok && ::fdatasync(fd) == 0;
+    return ::close(fd) == 0 && ok;
+}
+
+// See MutationLog.h
+void MutationLog::_start_compaction() {
+    std::string path = _path + ".compact";
+    pid_t pid = -1;
+    _storage->Freeze([&]() {
+        // Freeze waits for mutations already applied to be queued, see Start, so the image has exactly those
+        // queued before the mark. Ones queued from now on are remembered and appended to it once it is written
+        std::lock_guard<std::mutex> lock(_mutex);
+        _compact_mark = _next_seq;
+        pid = ::fork();
+        if (pid == 0) {
+            ::_exit(_write_image(*_storage, path) ? 0 : 1);
+        }
+    });
+
+    if (pid < 0) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _errors++;
+        return;
+    }
+    _child = pid;
+
+    // Queue isn't taken yet, so all the tail is still ahead
+    _compact_tail.clear();
+}
+
+// See MutationLog.h
+void MutationLog::_finish_compaction(bool wait) {
+    int status = 0;
+    pid_t pid;
+    do {
+        pid = ::waitpid(_child, &status, wait ? 0 : WNOHANG);
+    } while (pid < 0 && errno == EINTR);
+    if (pid == 0) {
+        return;
+    }
+    _child = -1;
+
+    std::string path = _path + ".compact";
+    std::vector<Entry> tail;
+    tail.swap(_compact_tail);
+    auto first = std::find_if(tail.begin(), tail.end(), [this](const Entry &e) { return e.seq >= _compact_mark; });
+    tail.erase(tail.begin(), first);
+
+    bool ok = pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    int fd = ok ? ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC) : -1;
+    ok = fd >= 0 && _write(fd, tail) && ::fdatasync(fd) == 0 && ::rename(path.c_str(), _path.c_str()) == 0;
+    if (!ok) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        ::unlink(path.c_str());
+        std::lock_guard<std::mutex> lock(_mutex);
+        _errors++;
+        return;
+    }
+
+    ::close(_fd);
+    _fd = fd;
+    struct stat st;
+    _size = ::fstat(_fd, &st) == 0 ? st.st_size : 0;
+    _base_size = _size;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _compactions++;
+}
+
+} // namespace Backend
+} // namespace Afina
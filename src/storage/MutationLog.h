@@ -0,0 +1,182 @@
+#ifndef AFINA_STORAGE_MUTATION_LOG_H
+#define AFINA_STORAGE_MUTATION_LOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # When mutation log is flushed to the disk
+ * - None: never, operating system does it at its own pace
+ * - Interval: at most once per interval, mutations of the last interval could be lost on crash
+ * - Always: writer waits until its mutation is on the disk, each group of mutations gets a single sync
+ */
+enum class SyncPolicy { None, Interval, Always };
+
+/**
+ * # Append-only log of storage mutations
+ * Workers encode mutations into the queue, dedicated thread takes everything queued so far as a group and
+ * writes it by a single writev followed by a single fdatasync, if policy asks for it. Workers are never
+ * blocked by the disk unless they wait for durability on their own.
+ *
+ * Record is a header followed by key and value bytes, value of append and prepend records is the data added,
+ * value of counter records is the counter resulting from increment or decrement:
+ *
+ *   [ checksum: u32 | type: u32 | key size: u32 | value size: u32 | expiration unix time or 0: i64 | ... ]
+ *
+ * Checksum covers the rest of the record, so torn write at the tail is detected and cut off on replay.
+ *
+ * Once log grows twice as large as after the last compaction, it gets rewritten in background: child
+ * process forked under Storage#Freeze writes the storage image as a new log, meanwhile log thread keeps
+ * appending to the old one and remembers groups written since fork. Those are appended to the new log
+ * once image is complete, then new log replaces the old one
+ */
+class MutationLog {
+public:
+    /**
+     * @param path log file
+     * @param policy when log is synced to the disk
+     * @param interval sync period of Interval policy
+     * @param compact_size log is never compacted while it is smaller than that
+     */
+    MutationLog(const std::string &path, SyncPolicy policy = SyncPolicy::Interval,
+                std::chrono::milliseconds interval = std::chrono::milliseconds(1000),
+                std::size_t compact_size = 64 * 1024 * 1024);
+    ~MutationLog() { Stop(); }
+
+    /**
+     * Applies mutations from the log to the storage, drops broken tail of the log if there is any.
+     * Must be called before Start. Returns number of mutations applied
+     */
+    std::size_t Replay(Afina::Storage &storage);
+
+    /**
+     * Opens log for appending and starts log thread. Storage is used to make image on compaction, its Freeze
+     * must also wait for every mutation already applied to be queued into the log, otherwise the mutation gets
+     * into both the image and its tail, see LoggedStorage. Throws std::runtime_error if log can't be opened
+     */
+    void Start(Afina::Storage &storage);
+
+    /**
+     * Writes and syncs everything queued so far, stops log thread
+     */
+    void Stop();
+
+    /**
+     * Queues association of key and value, see Storage#Put. Returns sequence number of the mutation
+     */
+    uint64_t Put(const std::string &key, const std::string &value, int32_t ttl);
+
+    /**
+     * Queues addition of data to the end of the value, see Storage#Append. Returns sequence number of
+     * the mutation
+     */
+    uint64_t Append(const std::string &key, const std::string &data);
+
+    /**
+     * Queues addition of data to the beginning of the value, see Storage#Prepend. Returns sequence number
+     * of the mutation
+     */
+    uint64_t Prepend(const std::string &key, const std::string &data);
+
+    /**
+     * Queues counter updated by Storage#Incr or Storage#Decr. Counter itself is recorded rather than delta, so
+     * replaying record over a value which already has it changes nothing. Returns sequence number of the mutation
+     */
+    uint64_t Counter(const std::string &key, uint64_t value);
+
+    /**
+     * Queues removal of the key. Returns sequence number of the mutation
+     */
+    uint64_t Delete(const std::string &key);
+
+    /**
+     * Blocks until mutation with the given sequence number is on the disk according to the policy: synced
+     * for Always and Interval, written for None
+     */
+    void Wait(uint64_t seq);
+
+    /**
+     * Starts compaction on the next log thread iteration regardless of log size
+     */
+    void Compact();
+
+    /**
+     * Appends log statistics, see Storage#GetStats:
+     * - log_bytes: log file size
+     * - log_groups: number of groups written
+     * - log_syncs: number of syncs done
+     * - log_compactions: number of completed compactions
+     * - log_errors: number of failed writes, syncs and compactions
+     */
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats);
+
+private:
+    MutationLog(const MutationLog &);            // = delete;
+    MutationLog &operator=(const MutationLog &); // = delete;
+
+    struct Entry {
+        uint64_t seq;
+        std::string record;
+    };
+
+    uint64_t _enqueue(std::string record);
+    void _loop();
+    bool _write(int fd, const std::vector<Entry> &group);
+    void _start_compaction();
+    void _finish_compaction(bool wait);
+
+    // Body of the forked compaction child
+    static bool _write_image(Afina::Storage &storage, const std::string &path);
+
+    const std::string _path;
+    const SyncPolicy _policy;
+    const std::chrono::milliseconds _interval;
+    const std::size_t _compact_size;
+
+    Afina::Storage *_storage;
+    int _fd;
+    std::thread _thread;
+
+    // Guards everything below, log thread waits on _work and writers wait on _done
+    std::mutex _mutex;
+    std::condition_variable _work;
+    std::condition_variable _done;
+    bool _running;
+    bool _compact_requested;
+    std::vector<Entry> _queue;
+    uint64_t _next_seq;
+    // last sequence number on the disk according to the policy
+    uint64_t _durable;
+
+    // Owned by log thread: file size now and after the last compaction, compaction in progress
+    std::size_t _size;
+    std::size_t _base_size;
+    pid_t _child;
+    uint64_t _compact_mark;
+    std::vector<Entry> _compact_tail;
+
+    // Statistics, updated by log thread under _mutex
+    std::size_t _bytes;
+    std::size_t _groups;
+    std::size_t _syncs;
+    std::size_t _compactions;
+    std::size_t _errors;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MUTATION_LOG_H
@@ -0,0 +1,296 @@
+#include "NearCache.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace Afina {
+namespace Backend {
+
+NearCache::NearCache(std::shared_ptr<Afina::Storage> storage, std::size_t capacity, std::chrono::milliseconds max_age,
+                     std::size_t max_value)
+    : _storage(std::move(storage)), _capacity(std::max<std::size_t>(capacity, 1)), _max_age(max_age),
+      _max_value(max_value), _versions(new std::atomic<uint64_t>[_version_slots]),
+      _locals([this]() { return new Local(_capacity); })
+{
+    for (std::size_t i = 0; i < _version_slots; i++) {
+        _versions[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+// See NearCache.h
+bool NearCache::_lookup(const std::string &key, Entry *&entry, uint64_t &version)
+{
+    std::size_t hash = _hash(key);
+    // version is read before storage is, so that a write landing in between makes the copy stale
+    version = _versions[hash % _version_slots].load(std::memory_order_acquire);
+
+    Local &local = _locals.local();
+    entry = &local.entries[hash % _capacity];
+    if (entry->valid && entry->version == version && entry->key == key && Clock::now() < entry->deadline) {
+        if (entry->hits < _max_hits) {
+            entry->hits++;
+        }
+        local.hits.store(local.hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return true;
+    }
+    local.misses.store(local.misses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return false;
+}
+
+// See NearCache.h
+void NearCache::_fill(Entry &entry, const std::string &key, const PinnedValue &value, uint64_t cas,
+                      uint64_t version)
+{
+    if (value.size() > _max_value) {
+        return;
+    }
+    if (entry.valid && entry.key != key && entry.hits > 0) {
+        entry.hits--;
+        return;
+    }
+
+    entry.key = key;
+    entry.value.assign(value.data(), value.size());
+    entry.cas = cas;
+    entry.version = version;
+    entry.deadline = Clock::now() + _max_age;
+    entry.hits = 0;
+    entry.valid = true;
+}
+
+// See NearCache.h
+void NearCache::_invalidate(const std::string &key)
+{
+    _versions[_hash(key) % _version_slots].fetch_add(1, std::memory_order_release);
+}
+
+// Implements Afina::Storage interface
+bool NearCache::Put(const std::string &key, const std::string &value, int32_t ttl)
+{
+    bool result = _storage->Put(key, value, ttl);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::Put(const std::string &key, std::string &&value, int32_t ttl)
+{
+    bool result = _storage->Put(key, std::move(value), ttl);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl)
+{
+    bool result = _storage->PutIfAbsent(key, value, ttl);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl)
+{
+    bool result = _storage->PutIfAbsent(key, std::move(value), ttl);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::Set(const std::string &key, const std::string &value, int32_t ttl)
+{
+    bool result = _storage->Set(key, value, ttl);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::Set(const std::string &key, std::string &&value, int32_t ttl)
+{
+    bool result = _storage->Set(key, std::move(value), ttl);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::Append(const std::string &key, const std::string &data)
+{
+    bool result = _storage->Append(key, data);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::Prepend(const std::string &key, const std::string &data)
+{
+    bool result = _storage->Prepend(key, data);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+NearCache::CounterResult NearCache::Incr(const std::string &key, uint64_t delta, uint64_t &value)
+{
+    CounterResult result = _storage->Incr(key, delta, value);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+NearCache::CounterResult NearCache::Decr(const std::string &key, uint64_t delta, uint64_t &value)
+{
+    CounterResult result = _storage->Decr(key, delta, value);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::Delete(const std::string &key)
+{
+    bool result = _storage->Delete(key);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::Get(const std::string &key, std::string &value)
+{
+    PinnedValue pinned;
+    if (!GetPinned(key, pinned)) {
+        return false;
+    }
+    value.assign(pinned.data(), pinned.size());
+    return true;
+}
+
+// Implements Afina::Storage interface
+bool NearCache::GetPinned(const std::string &key, PinnedValue &value)
+{
+    uint64_t cas = 0;
+    return GetCas(key, value, cas);
+}
+
+// Implements Afina::Storage interface
+bool NearCache::GetCas(const std::string &key, PinnedValue &value, uint64_t &cas)
+{
+    Entry *entry = nullptr;
+    uint64_t version = 0;
+    if (_lookup(key, entry, version)) {
+        value = PinnedValue(entry->value);
+        cas = entry->cas;
+        return true;
+    }
+
+    if (!_storage->GetCas(key, value, cas)) {
+        return false;
+    }
+    _fill(*entry, key, value, cas, version);
+    return true;
+}
+
+// Implements Afina::Storage interface
+NearCache::CasResult NearCache::CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                                              int32_t ttl)
+{
+    CasResult result = _storage->CompareAndSet(key, value, cas, ttl);
+    _invalidate(key);
+    return result;
+}
+
+// Implements Afina::Storage interface
+NearCache::CasResult NearCache::CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl)
+{
+    CasResult result = _storage->CompareAndSet(key, std::move(value), cas, ttl);
+    _invalidate(key);
+    return result;
+}
+
+// See NearCache.h
+void NearCache::MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                         std::vector<uint64_t> *cas)
+{
+    values.clear();
+    values.resize(keys.size());
+    if (cas != nullptr) {
+        cas->assign(keys.size(), 0);
+    }
+
+    std::vector<std::size_t> missed;
+    std::vector<Entry *> entries;
+    std::vector<uint64_t> versions;
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        Entry *entry = nullptr;
+        uint64_t version = 0;
+        if (_lookup(keys[i], entry, version)) {
+            values[i] = PinnedValue(entry->value);
+            if (cas != nullptr) {
+                (*cas)[i] = entry->cas;
+            }
+        } else {
+            missed.push_back(i);
+            entries.push_back(entry);
+            versions.push_back(version);
+        }
+    }
+    if (missed.empty()) {
+        return;
+    }
+
+    // Keys missed go to the storage as one batch
+    std::vector<std::string> missed_keys;
+    missed_keys.reserve(missed.size());
+    for (std::size_t i : missed) {
+        missed_keys.push_back(keys[i]);
+    }
+    std::vector<PinnedValue> found;
+    std::vector<uint64_t> found_cas;
+    _storage->MultiGet(missed_keys, found, &found_cas);
+    for (std::size_t j = 0; j < missed.size(); j++) {
+        if (!found[j]) {
+            continue;
+        }
+        _fill(*entries[j], missed_keys[j], found[j], found_cas[j], versions[j]);
+        values[missed[j]] = std::move(found[j]);
+        if (cas != nullptr) {
+            (*cas)[missed[j]] = found_cas[j];
+        }
+    }
+}
+
+// Implements Afina::Storage interface
+std::size_t NearCache::MultiPut(const std::vector<std::pair<std::string, std::string>> &items, int32_t ttl)
+{
+    std::size_t stored = _storage->MultiPut(items, ttl);
+    for (auto &item : items) {
+        _invalidate(item.first);
+    }
+    return stored;
+}
+
+// Implements Afina::Storage interface
+std::size_t NearCache::MultiDelete(const std::vector<std::string> &keys)
+{
+    std::size_t deleted = _storage->MultiDelete(keys);
+    for (auto &key : keys) {
+        _invalidate(key);
+    }
+    return deleted;
+}
+
+// See NearCache.h
+void NearCache::GetStats(std::vector<std::pair<std::string, std::string>> &stats)
+{
+    _storage->GetStats(stats);
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    _locals.for_each([&hits, &misses](Local &local) {
+        hits += local.hits.load(std::memory_order_relaxed);
+        misses += local.misses.load(std::memory_order_relaxed);
+    });
+    stats.emplace_back("near_hits", std::to_string(hits));
+    stats.emplace_back("near_misses", std::to_string(misses));
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,185 @@
+#ifndef AFINA_STORAGE_NEAR_CACHE_H
+#define AFINA_STORAGE_NEAR_CACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+#include <afina/concurrency/ThreadLocal.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Per thread near cache
+ * Decorates thread safe storage with a small read cache of each thread, so that the hottest keys are
+ * served without touching storage locks at all.
+ *
+ * Each key hashes into a slot of shared version table, every write through the decorator bumps version of
+ * its slot once storage is changed. Cached copy remembers version it was read at and is used only while
+ * version is the same, so a get never returns value older than a write completed before it started.
+ * Expiration and eviction inside of the storage don't bump versions, so copy is also dropped after max_age.
+ *
+ * Cache of a thread is direct mapped: key competes for its entry with others, and entry holding a key hit
+ * often is replaced only after as many misses of others, so that rare keys don't push hot ones out
+ */
+class NearCache : public Afina::Storage {
+public:
+    /**
+     * @param storage thread safe storage to decorate
+     * @param capacity number of entries in cache of each thread
+     * @param max_age time cached copy is used for at most
+     * @param max_value values larger than that aren't cached
+     */
+    NearCache(std::shared_ptr<Afina::Storage> storage, std::size_t capacity,
+              std::chrono::milliseconds max_age = std::chrono::milliseconds(100), std::size_t max_value = 4096);
+
+    // Implements Afina::Storage interface
+    void Start() override { _storage->Start(); }
+
+    // Implements Afina::Storage interface
+    void Stop() override { _storage->Stop(); }
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetPinned(const std::string &key, PinnedValue &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl = 0) override;
+
+    /**
+     * Serves keys cached by calling thread, the rest is passed to the storage as one batch
+     */
+    void MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                  std::vector<uint64_t> *cas = nullptr) override;
+
+    // Implements Afina::Storage interface
+    std::size_t MultiPut(const std::vector<std::pair<std::string, std::string>> &items,
+                         int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    std::size_t MultiDelete(const std::vector<std::string> &keys) override;
+
+    /**
+     * Reports storage statistics followed by gets served by caches of running threads (near_hits) and
+     * passed to the storage by them (near_misses)
+     */
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override;
+
+    // Implements Afina::Storage interface
+    bool Scan(const Visitor &visitor) override { return _storage->Scan(visitor); }
+
+    // Implements Afina::Storage interface
+    void Freeze(const std::function<void()> &action) override { _storage->Freeze(action); }
+
+    // Implements Afina::Storage interface
+    bool Resize(std::size_t memory_limit) override { return _storage->Resize(memory_limit); }
+
+    // Implements Afina::Storage interface
+    bool Reshard(std::size_t shard_count) override { return _storage->Reshard(shard_count); }
+
+private:
+    NearCache(const NearCache &);            // = delete;
+    NearCache &operator=(const NearCache &); // = delete;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string key;
+        std::string value;
+        uint64_t cas;
+        // version of the key slot value was read at
+        uint64_t version;
+        Clock::time_point deadline;
+        // hits since entry was filled, misses of other keys count it down
+        unsigned hits;
+        bool valid;
+
+        Entry() : cas(0), version(0), hits(0), valid(false) {}
+    };
+
+    // Cache of one thread, counters are read by GetStats from other threads
+    struct Local {
+        std::vector<Entry> entries;
+        std::atomic<uint64_t> hits;
+        std::atomic<uint64_t> misses;
+
+        explicit Local(std::size_t capacity) : entries(capacity), hits(0), misses(0) {}
+    };
+
+    // Number of slots of version table, several keys could share one
+    static constexpr std::size_t _version_slots = 4096;
+    // Hit counter of entry doesn't grow above, so that key turned cold gets replaced in time
+    static constexpr unsigned _max_hits = 16;
+
+    std::shared_ptr<Afina::Storage> _storage;
+    const std::size_t _capacity;
+    const Clock::duration _max_age;
+    const std::size_t _max_value;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> _versions;
+    Concurrency::ThreadLocal<Local> _locals;
+    std::hash<std::string> _hash;
+
+    // Looks key up in the cache of calling thread. Returns true on hit, otherwise entry is the one key
+    // competes for and version is the one value got from storage must be filled with
+    bool _lookup(const std::string &key, Entry *&entry, uint64_t &version);
+
+    // Puts value read from storage into entry unless it keeps hotter key
+    void _fill(Entry &entry, const std::string &key, const PinnedValue &value, uint64_t cas, uint64_t version);
+
+    // Marks copies of the key cached by all threads stale, called once storage is changed
+    void _invalidate(const std::string &key);
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_NEAR_CACHE_H
@@ -0,0 +1,249 @@
+#ifndef AFINA_STORAGE_NODE_H
+#define AFINA_STORAGE_NODE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+
+#include <afina/PinnedValue.h>
+
+#include "Index.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Intrusive list link
+ * Lists are circular with a sentinel link, so neither insert nor unlink has special cases for head or tail
+ */
+struct Link {
+    Link *prev;
+    Link *next;
+
+    Link() : prev(this), next(this) {}
+
+    bool empty() const { return next == this; }
+
+    // Inserts this link right after the given one
+    void link_after(Link *pos) {
+        prev = pos;
+        next = pos->next;
+        pos->next->prev = this;
+        pos->next = this;
+    }
+
+    // Removes this link from the list it belongs to
+    void unlink() {
+        prev->next = next;
+        next->prev = prev;
+        prev = next = this;
+    }
+};
+
+/**
+ * # Expiration timer link
+ * Second list hook of the node, so that it could be in eviction list and in a timer wheel slot at the same
+ * time. Names differ from Link ones to keep member lookup unambiguous
+ */
+struct TimerLink {
+    TimerLink *timer_prev;
+    TimerLink *timer_next;
+
+    TimerLink() : timer_prev(this), timer_next(this) {}
+
+    bool timer_empty() const { return timer_next == this; }
+
+    // Inserts this link right after the given one
+    void timer_link_after(TimerLink *pos) {
+        timer_prev = pos;
+        timer_next = pos->timer_next;
+        pos->timer_next->timer_prev = this;
+        pos->timer_next = this;
+    }
+
+    // Removes this link from the list it belongs to, does nothing if link isn't in any list
+    void timer_unlink() {
+        timer_prev->timer_next = timer_next;
+        timer_next->timer_prev = timer_prev;
+        timer_prev = timer_next = this;
+    }
+};
+
+/**
+ * # Storage node
+ * Header, key and value bytes share a single allocation:
+ *
+ *   [ Node header | key bytes | value bytes | unused value capacity ]
+ *
+ * Value could be updated in place as long as new value fits into capacity and node isn't pinned, otherwise
+ * node must be reallocated.
+ *
+ * Large value passed as rvalue is adopted instead of copied: node keeps the string itself, aligned right
+ * after the key, and value bytes stay in the string buffer:
+ *
+ *   [ Node header | key bytes | std::string ] -> [ value bytes ]
+ *
+ * Node is reference counted: owning list keeps one reference and each PinnedValue made by Pin keeps one
+ * more, so pinned node outlives its removal from the storage. Use Unref instead of Destroy to drop node
+ */
+struct Node : public Link, public TimerLink {
+    // hash of the key, see Index#hash
+    std::size_t hash;
+    uint32_t key_size;
+    uint32_t value_size;
+    // number of bytes reserved for value
+    uint32_t capacity;
+    // number of owners: storage list and value views
+    std::atomic<uint32_t> refs;
+    // engine time in seconds node expires at, 0 if never
+    uint32_t expire;
+    // engine time in seconds node was inserted or last moved up by its storage at, see SimpleLRU#TailAge
+    uint32_t touched;
+    // version of the value, see Storage#GetCas
+    uint64_t cas;
+    // CLOCK reference bit, could be set by concurrent readers
+    std::atomic<bool> referenced;
+    // engine specific list the node belongs to, i.e segment of segmented LRU
+    uint8_t segment;
+    // value bytes are kept by adopted string, see Create
+    bool external;
+
+    // Largest key or value node could keep
+    static constexpr std::size_t max_size = UINT32_MAX;
+
+    // Smallest value adopted by Create, copying smaller one is cheaper than an extra heap block
+    static constexpr std::size_t external_min = 1024;
+
+    const char *key_data() const { return reinterpret_cast<const char *>(this + 1); }
+    KeyRef key() const { return KeyRef(key_data(), key_size); }
+
+    const char *value_data() const { return external ? _external()->data() : key_data() + key_size; }
+    char *value_data() { return external ? &(*_external())[0] : reinterpret_cast<char *>(this + 1) + key_size; }
+
+    std::string value() const { return std::string(value_data(), value_size); }
+
+    /**
+     * Returns heap footprint of node with the given number of bytes reserved for value, see heap_size.
+     * Adopted value is kept by a block of its own: string buffer of the given capacity and terminating zero
+     */
+    static std::size_t footprint(std::size_t key_size, std::size_t capacity, bool external) {
+        if (external) {
+            return heap_size(_external_offset(key_size) + sizeof(std::string)) + heap_size(capacity + 1);
+        }
+        return heap_size(sizeof(Node) + key_size + capacity);
+    }
+
+    // Number of bytes value could take without reallocation: node capacity or capacity of adopted string
+    std::size_t reserved() const { return external ? _external()->capacity() : capacity; }
+
+    // Returns heap footprint of this node, including buffer of adopted value
+    std::size_t footprint() const { return footprint(key_size, reserved(), external); }
+
+    // Returns true if node is dead at the given engine time
+    bool expired(uint32_t now) const { return expire != 0 && expire <= now; }
+
+    // Returns true if there are value views referencing this node, so it must not be changed in place. Only
+    // owner of the node could add views, so result is stable as long as owner lock is held
+    bool pinned() const { return refs.load(std::memory_order_acquire) > 1; }
+
+    // Returns immutable view of the current value
+    PinnedValue Pin() {
+        refs.fetch_add(1, std::memory_order_relaxed);
+        return PinnedValue(value_data(), value_size, this, &Node::Release);
+    }
+
+    // Drops a reference, node gets destroyed once the last one is gone
+    static void Unref(Node *node) {
+        if (node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            Destroy(node);
+        }
+    }
+
+    // Replaces value, new one must fit into capacity
+    void assign(const std::string &value) {
+        std::memcpy(value_data(), value.data(), value.size());
+        value_size = value.size();
+    }
+
+    /**
+     * Allocates new node with a copy of key and value. Capacity is extended up to value size if needed
+     */
+    static Node *Create(const KeyRef &key, const std::string &value, std::size_t hash, std::size_t capacity = 0) {
+        if (capacity < value.size()) {
+            capacity = value.size();
+        }
+
+        void *memory = ::operator new(sizeof(Node) + key.size + capacity);
+        Node *node = new (memory) Node(hash, key.size, capacity);
+        std::memcpy(reinterpret_cast<char *>(node + 1), key.data, key.size);
+        node->assign(value);
+        return node;
+    }
+
+    /**
+     * Returns true if Create adopts the value passed as rvalue: value is large and its buffer doesn't waste
+     * much memory
+     */
+    static bool adoptable(const std::string &value) {
+        return value.size() >= external_min && value.capacity() - value.size() <= value.size() / 4;
+    }
+
+    /**
+     * Same as above, but adoptable value is taken over without copying its bytes and left empty. Node
+     * capacity is exactly value size then, so in place updates stay within the string
+     */
+    static Node *Create(const KeyRef &key, std::string &&value, std::size_t hash) {
+        if (!adoptable(value)) {
+            return Create(key, value, hash);
+        }
+
+        void *memory = ::operator new(_external_offset(key.size) + sizeof(std::string));
+        Node *node = new (memory) Node(hash, key.size, value.size());
+        std::memcpy(reinterpret_cast<char *>(node + 1), key.data, key.size);
+        node->external = true;
+        node->value_size = value.size();
+        new (node->_external()) std::string(std::move(value));
+        return node;
+    }
+
+    /**
+     * Releases memory of node created by Create regardless of references
+     */
+    static void Destroy(Node *node) {
+        if (node->external) {
+            using std::string;
+            node->_external()->~string();
+        }
+        node->~Node();
+        ::operator delete(node);
+    }
+
+private:
+    Node(std::size_t hash, std::size_t key_size, std::size_t capacity)
+        : hash(hash), key_size(key_size), value_size(0), capacity(capacity), refs(1), expire(0), touched(0), cas(0),
+          referenced(false), segment(0), external(false) {}
+
+    // Offset of adopted string from the node start, see Create
+    static std::size_t _external_offset(std::size_t key_size) {
+        return (sizeof(Node) + key_size + alignof(std::string) - 1) / alignof(std::string) * alignof(std::string);
+    }
+
+    std::string *_external() {
+        return reinterpret_cast<std::string *>(reinterpret_cast<char *>(this) + _external_offset(key_size));
+    }
+    const std::string *_external() const {
+        return reinterpret_cast<const std::string *>(reinterpret_cast<const char *>(this) +
+                                                     _external_offset(key_size));
+    }
+
+    // See PinnedValue::Release
+    static void Release(void *node) { Unref(static_cast<Node *>(node)); }
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_NODE_H
@@ -0,0 +1,84 @@
+#ifndef AFINA_STORAGE_SHARD_LOCK_H
+#define AFINA_STORAGE_SHARD_LOCK_H
+
+#include <mutex>
+
+#include <afina/concurrency/SharedMutex.h>
+#include <afina/concurrency/SpinLock.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Kind of lock guarding storage shard
+ * - Mutex: std::mutex
+ * - RW: reader-writer lock, reads run in parallel if engine reads are write-free (see EvictionPolicy)
+ * - Spin: spin lock, for short operations on small values
+ */
+enum class LockType { Mutex, RW, Spin };
+
+/**
+ * # Lock of the single storage shard
+ * Kind of lock is selected at runtime. For Mutex and Spin shared ownership is the same as exclusive one
+ */
+class ShardLock {
+public:
+    explicit ShardLock(LockType type = LockType::Mutex) : _type(type) {}
+
+    void lock() {
+        switch (_type) {
+        case LockType::Mutex:
+            _mutex.lock();
+            break;
+        case LockType::RW:
+            _shared.lock();
+            break;
+        case LockType::Spin:
+            _spin.lock();
+            break;
+        }
+    }
+
+    void unlock() {
+        switch (_type) {
+        case LockType::Mutex:
+            _mutex.unlock();
+            break;
+        case LockType::RW:
+            _shared.unlock();
+            break;
+        case LockType::Spin:
+            _spin.unlock();
+            break;
+        }
+    }
+
+    void lock_shared() {
+        if (_type == LockType::RW) {
+            _shared.lock_shared();
+        } else {
+            lock();
+        }
+    }
+
+    void unlock_shared() {
+        if (_type == LockType::RW) {
+            _shared.unlock_shared();
+        } else {
+            unlock();
+        }
+    }
+
+private:
+    const LockType _type;
+
+    // Only one of them is used, depending on _type
+    std::mutex _mutex;
+    Concurrency::SharedMutex _shared;
+    Concurrency::SpinLock _spin;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SHARD_LOCK_H
@@ -0,0 +1,603 @@
+#include "ShmLRU.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const char magic[8] = {'A', 'F', 'S', 'H', 'M', 'L', 'R', 'U'};
+
+// Bump on any change of Header or Item layout, older segments get wiped then
+const uint32_t layout_version = 2;
+
+const unsigned max_classes = 64;
+
+std::size_t align_up(std::size_t value, std::size_t align) { return (value + align - 1) / align * align; }
+
+} // namespace
+
+/**
+ * Segment starts with the header, followed by bucket array of the key index and pages
+ */
+struct ShmLRU::Header {
+    char magic[8];
+    uint32_t version;
+    // non zero while operation is in progress
+    volatile uint32_t busy;
+
+    uint64_t size;
+    uint64_t page_size;
+    uint64_t classes;
+
+    // Key index: heads of item chains, number of buckets is a power of two
+    offset_t buckets;
+    uint64_t bucket_mask;
+
+    // Pages: first one, total number and number of pages taken by classes
+    offset_t heap;
+    uint64_t pages;
+    uint64_t pages_used;
+
+    uint64_t items;
+    uint64_t bytes;
+    // the last version issued, see Storage#GetCas
+    uint64_t cas;
+
+    struct Class {
+        uint64_t chunk_size;
+        // singly linked list over the first word of free chunks
+        offset_t free;
+        // LRU list: head is the most recently used item, tail is the eviction candidate
+        offset_t head;
+        offset_t tail;
+        uint64_t pages;
+        uint64_t used;
+        uint64_t evictions;
+    } cls[max_classes];
+};
+
+/**
+ * Item in the chunk: header followed by key and value bytes
+ */
+struct ShmLRU::Item {
+    // LRU list neighbours and next item of the same bucket, 0 if there is none
+    offset_t prev;
+    offset_t next;
+    offset_t hnext;
+    uint64_t hash;
+    uint32_t key_size;
+    uint32_t value_size;
+    // unix time item expires at, 0 if never
+    uint32_t expire;
+    uint32_t cls;
+    // version of the value
+    uint64_t cas;
+
+    const char *key_data() const { return reinterpret_cast<const char *>(this + 1); }
+    char *value_data() { return reinterpret_cast<char *>(this + 1) + key_size; }
+};
+
+/**
+ * Marks segment busy while the operation runs, so that segment left in the middle of it isn't attached
+ */
+class ShmLRU::Busy {
+public:
+    explicit Busy(Header *header) : _header(header) {
+        _header->busy = 1;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+    ~Busy() {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        _header->busy = 0;
+    }
+
+private:
+    Header *_header;
+};
+
+ShmLRU::ShmLRU(const std::string &path, std::size_t size, std::size_t page_size)
+    : _path(path), _fd(-1), _size(size), _base(nullptr), _header(nullptr), _attached(false) {
+    if (size < sizeof(Header)) {
+        throw std::runtime_error("Shared memory segment is too small");
+    }
+
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (_fd < 0) {
+        throw std::runtime_error("Failed to open segment " + path + ": " + std::strerror(errno));
+    }
+    if (::flock(_fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(_fd);
+        throw std::runtime_error("Segment " + path + " is owned by another process");
+    }
+
+    struct stat st;
+    bool resized = ::fstat(_fd, &st) != 0 || std::size_t(st.st_size) != size;
+    if (resized && ::ftruncate(_fd, size) != 0) {
+        ::close(_fd);
+        throw std::runtime_error("Failed to resize segment " + path + ": " + std::strerror(errno));
+    }
+
+    void *mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (mapped == MAP_FAILED) {
+        ::close(_fd);
+        throw std::runtime_error("Failed to map segment " + path + ": " + std::strerror(errno));
+    }
+    _base = static_cast<char *>(mapped);
+    _header = _at<Header>(0);
+
+    page_size = std::max<std::size_t>(std::min(page_size, size / 16), 1024);
+    _attached = !resized && std::memcmp(_header->magic, magic, sizeof(magic)) == 0 &&
+                _header->version == layout_version && _header->size == size && _header->page_size == page_size &&
+                _header->busy == 0;
+    if (!_attached) {
+        _format(page_size);
+    }
+}
+
+ShmLRU::~ShmLRU() {
+    ::munmap(_base, _size);
+    ::close(_fd);
+}
+
+// See ShmLRU.h
+void ShmLRU::Remove(const std::string &path) { ::unlink(path.c_str()); }
+
+// See ShmLRU.h
+void ShmLRU::_format(std::size_t page_size) {
+    Busy busy(_header);
+    std::memset(_header->magic, 0, sizeof(_header->magic));
+
+    _header->version = layout_version;
+    _header->size = _size;
+    _header->page_size = page_size;
+    _header->items = 0;
+    _header->bytes = 0;
+    _header->cas = 0;
+
+    // Chunk sizes grow by 1.25 as in Allocator::Slab, the last class takes the whole page
+    unsigned classes = 0;
+    for (std::size_t chunk = 64; classes < max_classes - 1 && chunk < page_size;
+         chunk = std::max(align_up(chunk * 5 / 4, 8), chunk + 8)) {
+        _header->cls[classes++] = Header::Class{chunk, 0, 0, 0, 0, 0, 0};
+    }
+    _header->cls[classes++] = Header::Class{page_size, 0, 0, 0, 0, 0, 0};
+    _header->classes = classes;
+
+    // About a bucket per 256 bytes of segment
+    std::size_t buckets = 16;
+    while (buckets * 2 * 256 <= _size) {
+        buckets *= 2;
+    }
+    _header->buckets = align_up(sizeof(Header), 64);
+    _header->bucket_mask = buckets - 1;
+    std::memset(_at<char>(_header->buckets), 0, buckets * sizeof(offset_t));
+
+    _header->heap = align_up(_header->buckets + buckets * sizeof(offset_t), 64);
+    _header->pages = _header->heap < _size ? (_size - _header->heap) / page_size : 0;
+    _header->pages_used = 0;
+
+    // Segment is valid from now on
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    std::memcpy(_header->magic, magic, sizeof(magic));
+}
+
+// See ShmLRU.h
+uint64_t ShmLRU::_hash(const char *data, std::size_t size) {
+    // FNV-1a: unlike std::hash it is the same for every build, so index stays valid after upgrade
+    uint64_t hash = 14695981039346656037ull;
+    for (std::size_t i = 0; i < size; i++) {
+        hash = (hash ^ uint8_t(data[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// See ShmLRU.h
+uint32_t ShmLRU::_expire_at(int32_t ttl) const { return ttl > 0 ? std::time(nullptr) + ttl : 0; }
+
+// See ShmLRU.h
+int ShmLRU::_class_of(std::size_t size) const {
+    for (unsigned cls = 0; cls < _header->classes; cls++) {
+        if (_header->cls[cls].chunk_size >= size) {
+            return cls;
+        }
+    }
+    return -1;
+}
+
+// See ShmLRU.h
+ShmLRU::offset_t &ShmLRU::_bucket(uint64_t hash) const {
+    return _at<offset_t>(_header->buckets)[hash & _header->bucket_mask];
+}
+
+// See ShmLRU.h
+ShmLRU::Item *ShmLRU::_find(const std::string &key, uint64_t hash) {
+    for (offset_t off = _bucket(hash); off != 0;) {
+        Item *item = _at<Item>(off);
+        if (item->hash == hash && item->key_size == key.size() &&
+            std::memcmp(item->key_data(), key.data(), key.size()) == 0) {
+            if (item->expire != 0 && item->expire <= std::time(nullptr)) {
+                _delete_item(item);
+                return nullptr;
+            }
+            return item;
+        }
+        off = item->hnext;
+    }
+    return nullptr;
+}
+
+// See ShmLRU.h
+void ShmLRU::_lru_unlink(Item *item) {
+    Header::Class &c = _header->cls[item->cls];
+    if (item->prev != 0) {
+        _at<Item>(item->prev)->next = item->next;
+    } else {
+        c.head = item->next;
+    }
+    if (item->next != 0) {
+        _at<Item>(item->next)->prev = item->prev;
+    } else {
+        c.tail = item->prev;
+    }
+    item->prev = item->next = 0;
+}
+
+// See ShmLRU.h
+void ShmLRU::_lru_push(Item *item) {
+    Header::Class &c = _header->cls[item->cls];
+    offset_t off = _offset(item);
+    item->prev = 0;
+    item->next = c.head;
+    if (c.head != 0) {
+        _at<Item>(c.head)->prev = off;
+    } else {
+        c.tail = off;
+    }
+    c.head = off;
+}
+
+// See ShmLRU.h
+void ShmLRU::_delete_item(Item *item) {
+    offset_t off = _offset(item);
+    offset_t *link = &_bucket(item->hash);
+    while (*link != off) {
+        link = &_at<Item>(*link)->hnext;
+    }
+    *link = item->hnext;
+
+    _lru_unlink(item);
+    _header->items--;
+    _header->bytes -= sizeof(Item) + item->key_size + item->value_size;
+
+    Header::Class &c = _header->cls[item->cls];
+    c.used--;
+    *reinterpret_cast<offset_t *>(item) = c.free;
+    c.free = off;
+}
+
+// See ShmLRU.h
+void *ShmLRU::_alloc(unsigned cls) {
+    Header::Class &c = _header->cls[cls];
+    if (c.free == 0) {
+        if (_header->pages_used < _header->pages) {
+            // Carve the whole page at once, chunks go to the list in address order
+            offset_t page = _header->heap + _header->pages_used * _header->page_size;
+            for (std::size_t i = _header->page_size / c.chunk_size; i > 0; i--) {
+                offset_t chunk = page + (i - 1) * c.chunk_size;
+                *_at<offset_t>(chunk) = c.free;
+                c.free = chunk;
+            }
+            _header->pages_used++;
+            c.pages++;
+        } else if (c.tail != 0) {
+            _delete_item(_at<Item>(c.tail));
+            c.evictions++;
+        } else {
+            return nullptr;
+        }
+    }
+
+    offset_t chunk = c.free;
+    c.free = *_at<offset_t>(chunk);
+    c.used++;
+    return _at<void>(chunk);
+}
+
+// See ShmLRU.h
+bool ShmLRU::_put_item(const std::string &key, const std::string &value, uint64_t hash, uint32_t expire) {
+    int cls = _class_of(sizeof(Item) + key.size() + value.size());
+    void *chunk = _alloc(cls);
+    if (chunk == nullptr) {
+        return false;
+    }
+
+    Item *item = static_cast<Item *>(chunk);
+    item->hash = hash;
+    item->key_size = key.size();
+    item->value_size = value.size();
+    item->expire = expire;
+    item->cls = cls;
+    item->cas = ++_header->cas;
+    std::memcpy(item + 1, key.data(), key.size());
+    std::memcpy(item->value_data(), value.data(), value.size());
+
+    _lru_push(item);
+    offset_t &bucket = _bucket(hash);
+    item->hnext = bucket;
+    bucket = _offset(item);
+    _header->items++;
+    _header->bytes += sizeof(Item) + key.size() + value.size();
+    return true;
+}
+
+// See ShmLRU.h
+bool ShmLRU::Put(const std::string &key, const std::string &value, int32_t ttl) {
+    int cls = _class_of(sizeof(Item) + key.size() + value.size());
+    if (cls < 0) {
+        return false;
+    }
+
+    Busy busy(_header);
+    uint64_t hash = _hash(key.data(), key.size());
+    Item *found = _find(key, hash);
+    if (found != nullptr && (ttl < 0 || found->cls != unsigned(cls))) {
+        _delete_item(found);
+        found = nullptr;
+    }
+    if (ttl < 0) {
+        return true;
+    }
+
+    if (found == nullptr) {
+        return _put_item(key, value, hash, _expire_at(ttl));
+    }
+
+    // Value of the same class fits into the chunk
+    _header->bytes += value.size() - found->value_size;
+    std::memcpy(found->value_data(), value.data(), value.size());
+    found->value_size = value.size();
+    found->expire = _expire_at(ttl);
+    found->cas = ++_header->cas;
+    _lru_unlink(found);
+    _lru_push(found);
+    return true;
+}
+
+// See ShmLRU.h
+bool ShmLRU::PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl) {
+    if (_class_of(sizeof(Item) + key.size() + value.size()) < 0) {
+        return false;
+    }
+
+    Busy busy(_header);
+    uint64_t hash = _hash(key.data(), key.size());
+    if (_find(key, hash) != nullptr) {
+        return false;
+    }
+    return ttl < 0 || _put_item(key, value, hash, _expire_at(ttl));
+}
+
+// See ShmLRU.h
+bool ShmLRU::Set(const std::string &key, const std::string &value, int32_t ttl) {
+    if (_class_of(sizeof(Item) + key.size() + value.size()) < 0) {
+        return false;
+    }
+
+    {
+        Busy busy(_header);
+        if (_find(key, _hash(key.data(), key.size())) == nullptr) {
+            return false;
+        }
+    }
+    return Put(key, value, ttl);
+}
+
+// See ShmLRU.h
+bool ShmLRU::_concat(const std::string &key, const std::string &data, bool prepend) {
+    Busy busy(_header);
+    uint64_t hash = _hash(key.data(), key.size());
+    Item *item = _find(key, hash);
+    if (item == nullptr) {
+        return false;
+    }
+
+    std::size_t old_size = item->value_size;
+    std::size_t new_size = old_size + data.size();
+    int cls = _class_of(sizeof(Item) + key.size() + new_size);
+    if (cls < 0) {
+        return false;
+    }
+
+    if (unsigned(cls) == item->cls) {
+        // Chunk has room for the grown value
+        char *value = item->value_data();
+        if (prepend) {
+            std::memmove(value + data.size(), value, old_size);
+            std::memcpy(value, data.data(), data.size());
+        } else {
+            std::memcpy(value + old_size, data.data(), data.size());
+        }
+        item->value_size = new_size;
+        item->cas = ++_header->cas;
+        _header->bytes += data.size();
+        _lru_unlink(item);
+        _lru_push(item);
+        return true;
+    }
+
+    // Value is copied out, so that the old chunk is released before the new one is taken
+    std::string value;
+    value.reserve(new_size);
+    if (prepend) {
+        value.append(data).append(item->value_data(), old_size);
+    } else {
+        value.append(item->value_data(), old_size).append(data);
+    }
+    uint32_t expire = item->expire;
+    _delete_item(item);
+    return _put_item(key, value, hash, expire);
+}
+
+// See ShmLRU.h
+bool ShmLRU::Append(const std::string &key, const std::string &data) { return _concat(key, data, false); }
+
+// See ShmLRU.h
+bool ShmLRU::Prepend(const std::string &key, const std::string &data) { return _concat(key, data, true); }
+
+// See ShmLRU.h
+ShmLRU::CounterResult ShmLRU::_count(const std::string &key, uint64_t delta, bool decrement, uint64_t &value) {
+    Busy busy(_header);
+    uint64_t hash = _hash(key.data(), key.size());
+    Item *item = _find(key, hash);
+    if (item == nullptr) {
+        return CounterResult::NotFound;
+    }
+    if (!Count(item->value_data(), item->value_size, delta, decrement, value)) {
+        return CounterResult::NotNumber;
+    }
+
+    std::string counter = std::to_string(value);
+    int cls = _class_of(sizeof(Item) + key.size() + counter.size());
+    if (cls < 0) {
+        return CounterResult::NotStored;
+    }
+
+    if (unsigned(cls) == item->cls) {
+        _header->bytes += counter.size() - item->value_size;
+        std::memcpy(item->value_data(), counter.data(), counter.size());
+        item->value_size = counter.size();
+        item->cas = ++_header->cas;
+        _lru_unlink(item);
+        _lru_push(item);
+        return CounterResult::Stored;
+    }
+
+    uint32_t expire = item->expire;
+    _delete_item(item);
+    return _put_item(key, counter, hash, expire) ? CounterResult::Stored : CounterResult::NotStored;
+}
+
+// See ShmLRU.h
+ShmLRU::CounterResult ShmLRU::Incr(const std::string &key, uint64_t delta, uint64_t &value) {
+    return _count(key, delta, false, value);
+}
+
+// See ShmLRU.h
+ShmLRU::CounterResult ShmLRU::Decr(const std::string &key, uint64_t delta, uint64_t &value) {
+    return _count(key, delta, true, value);
+}
+
+// See ShmLRU.h
+bool ShmLRU::Delete(const std::string &key) {
+    Busy busy(_header);
+    Item *item = _find(key, _hash(key.data(), key.size()));
+    if (item == nullptr) {
+        return false;
+    }
+
+    _delete_item(item);
+    return true;
+}
+
+// See ShmLRU.h
+bool ShmLRU::Get(const std::string &key, std::string &value) {
+    Busy busy(_header);
+    Item *item = _find(key, _hash(key.data(), key.size()));
+    if (item == nullptr) {
+        return false;
+    }
+
+    _lru_unlink(item);
+    _lru_push(item);
+    value.assign(item->value_data(), item->value_size);
+    return true;
+}
+
+// See ShmLRU.h
+bool ShmLRU::GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) {
+    Busy busy(_header);
+    Item *item = _find(key, _hash(key.data(), key.size()));
+    if (item == nullptr) {
+        return false;
+    }
+
+    _lru_unlink(item);
+    _lru_push(item);
+    value = PinnedValue(std::string(item->value_data(), item->value_size));
+    cas = item->cas;
+    return true;
+}
+
+// See ShmLRU.h
+ShmLRU::CasResult ShmLRU::CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                                        int32_t ttl) {
+    if (_class_of(sizeof(Item) + key.size() + value.size()) < 0) {
+        return CasResult::NotStored;
+    }
+
+    {
+        Busy busy(_header);
+        Item *item = _find(key, _hash(key.data(), key.size()));
+        if (item == nullptr) {
+            return CasResult::NotFound;
+        }
+        if (item->cas != cas) {
+            return CasResult::Exists;
+        }
+    }
+    return Put(key, value, ttl) ? CasResult::Stored : CasResult::NotStored;
+}
+
+// See ShmLRU.h
+void ShmLRU::GetStats(std::vector<std::pair<std::string, std::string>> &stats) {
+    stats.emplace_back("limit_maxbytes", std::to_string(_size));
+    stats.emplace_back("bytes", std::to_string(_header->bytes));
+    stats.emplace_back("heap_bytes", std::to_string(_size));
+    stats.emplace_back("curr_items", std::to_string(_header->items));
+
+    for (unsigned cls = 0; cls < _header->classes; cls++) {
+        const Header::Class &c = _header->cls[cls];
+        if (c.pages == 0) {
+            continue;
+        }
+
+        std::string prefix = std::to_string(cls) + ":";
+        stats.emplace_back(prefix + "chunk_size", std::to_string(c.chunk_size));
+        stats.emplace_back(prefix + "total_pages", std::to_string(c.pages));
+        stats.emplace_back(prefix + "used_chunks", std::to_string(c.used));
+        stats.emplace_back(prefix + "evictions", std::to_string(c.evictions));
+    }
+}
+
+// See ShmLRU.h
+bool ShmLRU::Scan(const Visitor &visitor) {
+    uint32_t now = std::time(nullptr);
+    for (unsigned cls = 0; cls < _header->classes; cls++) {
+        for (offset_t off = _header->cls[cls].tail; off != 0;) {
+            Item *item = _at<Item>(off);
+            off = item->prev;
+            if (item->expire != 0 && item->expire <= now) {
+                continue;
+            }
+            int32_t ttl = item->expire != 0 ? item->expire - now : 0;
+            visitor(item->key_data(), item->key_size, item->value_data(), item->value_size, ttl);
+        }
+    }
+    return true;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,144 @@
+#ifndef AFINA_STORAGE_SHM_LRU_H
+#define AFINA_STORAGE_SHM_LRU_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Shared memory based implementation
+ * That is NOT thread safe implementation!!
+ *
+ * Items, key index and allocator state live in a file mapped into memory, usually in /dev/shm, and refer
+ * to each other by offsets from the start of the file instead of pointers. Segment outlives the process,
+ * so the next process opening the same file attaches to the items left by the previous one: restart keeps
+ * the whole cache warm and takes no time regardless of its size.
+ *
+ * Memory is organized as in SlabLRU: segment is split into pages, page belongs to a size class and is
+ * carved into chunks of the class size, each class has its own LRU. Pages are taken by classes on demand
+ * and never move between classes: once all pages are taken, class evicts its own items.
+ *
+ * Segment is attached only if it was made by the same layout version with the same size and page size,
+ * and the previous owner didn't die in the middle of an operation: each operation marks segment busy
+ * while it runs. Otherwise segment is wiped. Only one process could own segment at a time, it is guarded
+ * by flock.
+ *
+ * Expiration time is kept as unix time, so it is valid across processes. Expired items are dropped lazily
+ * on access
+ */
+class ShmLRU : public Afina::Storage {
+public:
+    /**
+     * Opens or creates segment, see above. Throws std::runtime_error if segment can't be mapped or is owned
+     * by another process
+     *
+     * @param path segment file, i.e /dev/shm/afina
+     * @param size segment size in bytes
+     * @param page_size number of bytes in a page, that is the largest item. Gets reduced for small
+     *        segments, so that there are at least 16 pages
+     */
+    ShmLRU(const std::string &path, std::size_t size, std::size_t page_size = 1024 * 1024);
+    ~ShmLRU();
+
+    /**
+     * Returns true if items of the previous owner were found in the segment
+     */
+    bool Attached() const { return _attached; }
+
+    /**
+     * Removes segment file, memory is released once last process unmaps it
+     */
+    static void Remove(const std::string &path);
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    /**
+     * Grows value in place while it fits into the chunk, otherwise item moves to the chunk of the larger
+     * class
+     */
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Same as Append
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    /**
+     * Rewrites counter in place while it stays in the same class, see Append
+     */
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Same as Incr
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override;
+
+    /**
+     * Reports statistics the same way as SlabLRU#GetStats does
+     */
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override;
+
+    // Implements Afina::Storage interface
+    bool Scan(const Visitor &visitor) override;
+
+private:
+    ShmLRU(const ShmLRU &);            // = delete;
+    ShmLRU &operator=(const ShmLRU &); // = delete;
+
+    struct Header;
+    struct Item;
+    class Busy;
+
+    // Offset 0 is the header, so it never refers to an item or a chunk
+    using offset_t = uint64_t;
+
+    template <typename T> T *_at(offset_t offset) const { return reinterpret_cast<T *>(_base + offset); }
+    offset_t _offset(const void *p) const { return static_cast<const char *>(p) - _base; }
+
+    void _format(std::size_t page_size);
+    static uint64_t _hash(const char *data, std::size_t size);
+    uint32_t _expire_at(int32_t ttl) const;
+    int _class_of(std::size_t size) const;
+    offset_t &_bucket(uint64_t hash) const;
+    Item *_find(const std::string &key, uint64_t hash);
+    void _lru_unlink(Item *item);
+    void _lru_push(Item *item);
+    void _delete_item(Item *item);
+    void *_alloc(unsigned cls);
+    bool _put_item(const std::string &key, const std::string &value, uint64_t hash, uint32_t expire);
+    bool _concat(const std::string &key, const std::string &data, bool prepend);
+    CounterResult _count(const std::string &key, uint64_t delta, bool decrement, uint64_t &value);
+
+    std::string _path;
+    int _fd;
+    std::size_t _size;
+    char *_base;
+    Header *_header;
+    bool _attached;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SHM_LRU_H
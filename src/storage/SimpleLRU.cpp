@@ -1,180 +1,851 @@
 #include "SimpleLRU.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
 namespace Afina {
 namespace Backend {
 
-  // See MapBasedGlobalLockImpl.h
+  // See SimpleLRU.h
   bool SimpleLRU::_overflow(size_t new_size) const
   {
-      return new_size > _max_size;
+      return new_size > _max_size + (_budget != nullptr ? _budget->Free() : 0);
   }
 
-  // See MapBasedGlobalLockImpl.h
-  void SimpleLRU::_insert_node(std::unique_ptr<lru_node> &node)
+  // See SimpleLRU.h
+  std::size_t SimpleLRU::_charge(std::size_t key_size, std::size_t value_size, std::size_t capacity,
+                                 bool external) const
   {
-      if (_lru_head->next == nullptr) {
-          _lru_head->next = std::move(node);
-          _lru_head->next->prev = _lru_head.get();
-          _lru_tail = _lru_head->next.get();
-      } else {
-          _lru_head->next->prev = node.get();
-          node->next = std::move(_lru_head->next);
-          node->prev = _lru_head.get();
-          _lru_head->next = std::move(node);
+      if (_accounting == Accounting::Payload) {
+          return key_size + value_size;
+      }
+      return lru_node::footprint(key_size, capacity, external) + _lru_index->entry_size();
+  }
+
+  // See SimpleLRU.h
+  std::size_t SimpleLRU::_charge(const lru_node *node) const
+  {
+      if (_accounting == Accounting::Payload) {
+          return node->key_size + node->value_size;
+      }
+      return node->footprint() + _lru_index->entry_size();
+  }
+
+  // See SimpleLRU.h
+  template <typename Value> std::size_t SimpleLRU::_fresh_charge(std::size_t key_size, const std::string &value) const
+  {
+      // Adopted string keeps its own capacity, copied value gets exactly its size
+      if (!std::is_lvalue_reference<Value>::value && lru_node::adoptable(value)) {
+          return _charge(key_size, value.size(), value.capacity(), true);
+      }
+      return _charge(key_size, value.size(), value.size());
+  }
+
+  // See SimpleLRU.h
+  std::size_t SimpleLRU::_hash(const std::string &key) const
+  {
+      std::size_t hash = _lru_index->hash(key);
+      // map index doesn't need hash, but sketch does
+      if (hash == 0 && _sketch) {
+          hash = std::hash<std::string>()(key);
+      }
+      return hash;
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::_record(std::size_t hash)
+  {
+      if (_sketch) {
+          _sketch->increment(hash);
       }
   }
 
-  // See MapBasedGlobalLockImpl.h
+  // See SimpleLRU.h
+  uint32_t SimpleLRU::_expire_at(int32_t ttl) const
+  {
+      return ttl > 0 ? Now() + ttl : 0;
+  }
+
+  // See SimpleLRU.h
+  SimpleLRU::lru_node *SimpleLRU::_find(const std::string &key, std::size_t hash, bool reclaim)
+  {
+      lru_node *node = _lru_index->find(key, hash);
+      if (node != nullptr && node->expire != 0 && node->expired(Now())) {
+          // shared reads must not change anything, node gets reclaimed later then
+          if (reclaim) {
+              _delete_node(node);
+          }
+          return nullptr;
+      }
+      return node;
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::_insert_node(lru_node *node)
+  {
+      // Clock puts new node right behind the hand, so that it will be checked after full turn
+      node->link_after(_policy == EvictionPolicy::Clock ? _hand : &_lru);
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::_touch(lru_node *node) const
+  {
+      // nobody asks for age of storage which doesn't share a budget, so time isn't read on each hit then
+      if (_budget != nullptr) {
+          node->touched = Now();
+      }
+  }
+
+  // See SimpleLRU.h
   void SimpleLRU::_get_up(lru_node *cur)
   {
+      if (_policy != EvictionPolicy::Clock || cur->segment == Window) {
+          _touch(cur);
+      }
+
+      if (cur->segment == Window) {
+          if (cur != _window.next) {
+              cur->unlink();
+              cur->link_after(&_window);
+          }
+          return;
+      }
+
+      if (_policy == EvictionPolicy::Clock) {
+          // no need to dirty cache line if bit is already set
+          if (!cur->referenced.load(std::memory_order_relaxed)) {
+              cur->referenced.store(true, std::memory_order_relaxed);
+          }
+          return;
+      }
+
+      if (_policy == EvictionPolicy::Segmented) {
+          if (cur->segment == Probation) {
+              cur->segment = Protected;
+              _protected_size += _charge(cur);
+          }
+          if (cur != _protected.next) {
+              cur->unlink();
+              cur->link_after(&_protected);
+          }
+          _demote();
+          return;
+      }
+
       // if current node is already in head
-      if (cur == _lru_head->next.get()) {
+      if (cur == _lru.next) {
           return;
       }
 
-      // updated tail node
-      if (cur == _lru_tail) {
-          _lru_tail = cur->prev;
+      cur->unlink();
+      cur->link_after(&_lru);
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::_demote()
+  {
+      // Protected overflow goes back to probation head, it gets one more chance to be hit there. The most
+      // recent protected node always stays
+      while (_protected_size > _protected_max && _protected.prev != _protected.next) {
+          lru_node *node = static_cast<lru_node *>(_protected.prev);
+          node->unlink();
+          node->link_after(&_lru);
+          node->segment = Probation;
+          _protected_size -= _charge(node);
       }
+  }
 
-      // head - cur <- node
-      _lru_head->next->prev = cur;
-      if (cur->next != nullptr) {
-          cur->next->prev = cur->prev;
+  // See SimpleLRU.h
+  void SimpleLRU::_unlink_node(lru_node *node)
+  {
+      if (_hand == node) {
+          _hand = node->prev;
+      }
+      node->unlink();
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::_delete_node(lru_node *node)
+  {
+      _lru_index->erase(node);
+      std::size_t charge = _charge(node);
+      _cur_size -= charge;
+      if (node->segment == Protected) {
+          _protected_size -= charge;
+      } else if (node->segment == Window) {
+          _window_size -= charge;
       }
+      _heap_size -= node->footprint();
+      _unlink_node(node);
+      _wheel.cancel(node);
+      lru_node::Unref(node);
+  }
 
-      // head -> cur <- node
-      lru_node *second = _lru_head->next.release();
-      _lru_head->next.reset(cur);
+  // See SimpleLRU.h
+  SimpleLRU::lru_node *SimpleLRU::_victim()
+  {
+      if (_policy == EvictionPolicy::LRU) {
+          return static_cast<lru_node *>(_lru.prev);
+      }
 
-      // update next of prev_of_current
-      cur->prev->next.release();
-      lru_node *center_next = cur->next.release();
-      cur->prev->next.reset(center_next);
+      if (_policy == EvictionPolicy::Segmented) {
+          return static_cast<lru_node *>(_lru.empty() ? _protected.prev : _lru.prev);
+      }
 
-      // insert current after head
-      cur->prev = _lru_head.get();
-      cur->next.release();
-      cur->next.reset(second);
+      // Clock: give second chance to each referenced node on the way
+      while (true) {
+          if (_hand == &_lru) {
+              _hand = _lru.prev;
+          }
+          lru_node *node = static_cast<lru_node *>(_hand);
+          if (!node->referenced.load(std::memory_order_relaxed)) {
+              return node;
+          }
+          node->referenced.store(false, std::memory_order_relaxed);
+          _hand = _hand->prev;
+      }
   }
 
+  // See SimpleLRU.h
+  SimpleLRU::lru_node *SimpleLRU::_victim(const lru_node *keep)
+  {
+      if (_lru.empty() && _protected.empty()) {
+          return nullptr;
+      }
 
-  bool SimpleLRU::_put_node(const std::string &key, const std::string &value)
+      lru_node *victim = _victim();
+      if (victim == keep) {
+          // kept node is either the last one or Clock victim after its bit got cleared
+          if (victim->next == victim->prev) {
+              return nullptr;
+          }
+          _hand = _hand->prev;
+          victim = _victim();
+      }
+      return victim;
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::_admit(size_t new_size, const lru_node *keep)
   {
-      size_t node_size = key.size() + value.size();
+      std::size_t main_max = _max_size - _window_max;
+      while (_window_size + new_size > _window_max && !_window.empty()) {
+          lru_node *candidate = static_cast<lru_node *>(_window.prev);
+          if (candidate == keep) {
+              break;
+          }
+
+          // move candidate into main part, then make room there. Candidate stays only while it is more
+          // frequent than victims, ties go to victims as they have proven to be useful already
+          candidate->unlink();
+          candidate->segment = Probation;
+          _window_size -= _charge(candidate);
+          _insert_node(candidate);
+
+          unsigned frequency = _sketch->frequency(candidate->hash);
+          while (_cur_size - _window_size > main_max) {
+              lru_node *victim = _victim(keep);
+              if (victim == nullptr || victim == candidate) {
+                  break;
+              }
+
+              if (frequency > _sketch->frequency(victim->hash)) {
+                  _delete_node(victim);
+              } else {
+                  _delete_node(candidate);
+                  break;
+              }
+          }
+      }
+  }
 
-      // if we need more space for new node, delete old nodes while too few space
-      while (_overflow(_cur_size + node_size)) {
-          _lru_index.erase(std::cref(_lru_tail->key));
-          _cur_size  = _cur_size - _lru_tail->key.size() - _lru_tail->value.size();
-          _lru_tail = _lru_tail->prev;
-          _lru_tail->next.reset(nullptr);
+  // See SimpleLRU.h
+  void SimpleLRU::_evict(size_t new_size, const lru_node *keep)
+  {
+      // shared budget is used up before anything gets evicted
+      if (_budget != nullptr && _cur_size + new_size > _max_size) {
+          std::size_t borrowed = _budget->Borrow(_cur_size + new_size - _max_size);
+          if (borrowed > 0) {
+              _target_size += borrowed;
+              _set_limit(_max_size + borrowed);
+          }
       }
 
-      auto node = std::unique_ptr<lru_node>( new lru_node(key, value) );
+      if (_sketch) {
+          _admit(new_size, keep);
+      }
+
+      // delete old nodes while too few space
+      while (_cur_size + new_size > _max_size) {
+          lru_node *victim = _victim(keep);
+          if (victim == nullptr) {
+              // main part is empty, the rest is taken by window
+              victim = static_cast<lru_node *>(_window.prev);
+              if (_window.empty() || victim == keep) {
+                  break;
+              }
+          }
+          _delete_node(victim);
+      }
+  }
+
+  // See SimpleLRU.h
+  template <typename Value>
+  bool SimpleLRU::_put_node(const std::string &key, Value &&value, std::size_t hash, uint32_t expire)
+  {
+      size_t node_size = _fresh_charge<Value>(key.size(), value);
+
+      // if we need more space for new node, delete old nodes while too few space
+      _evict(node_size, nullptr);
 
-      auto pair = _lru_index.emplace(std::make_pair(std::cref(node->key), std::ref(*node)));
-      bool res = pair.second;
-      if (!res) {
+      lru_node *node = lru_node::Create(key, std::forward<Value>(value), hash);
+      if (!_lru_index->insert(node)) {
+          lru_node::Destroy(node);
           return false;
       }
 
-      _cur_size += key.size() + value.size();
+      _cur_size += node_size;
+      _heap_size += node->footprint();
+      _touch(node);
+      node->expire = expire;
+      node->cas = _cas += _cas_step;
+      _wheel.schedule(node);
+
+      // insert node in the top of the list, with admission filter it gets into window first
+      if (_sketch) {
+          node->segment = Window;
+          node->link_after(&_window);
+          _window_size += node_size;
+      } else {
+          _insert_node(node);
+      }
+      return true;
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::_discharge(lru_node *node)
+  {
+      std::size_t charge = _charge(node);
+      _cur_size -= charge;
+      if (node->segment == Protected) {
+          _protected_size -= charge;
+      } else if (node->segment == Window) {
+          _window_size -= charge;
+      }
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::_recharge(lru_node *node)
+  {
+      std::size_t charge = _charge(node);
+      _cur_size += charge;
+      if (node->segment == Protected) {
+          _protected_size += charge;
+          _demote();
+      } else if (node->segment == Window) {
+          _window_size += charge;
+      }
+  }
+
+  // See SimpleLRU.h
+  SimpleLRU::lru_node *SimpleLRU::_replace_node(lru_node *node, lru_node *fresh)
+  {
+      fresh->referenced.store(node->referenced.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      fresh->segment = node->segment;
+      fresh->touched = node->touched;
+      _lru_index->erase(node);
+      fresh->link_after(node);
+      _unlink_node(node);
+      _heap_size = _heap_size - node->footprint() + fresh->footprint();
+      lru_node::Unref(node);
+
+      _lru_index->insert(fresh);
+      return fresh;
+  }
+
+  // See SimpleLRU.h
+  template <typename Value> bool SimpleLRU::_set_node(lru_node *node, Value &&value, uint32_t expire)
+  {
+      _get_up(node);
+
+      // Reuse node while value fits and doesn't waste more than half of it. Pinned node must stay as is
+      // for readers, so it gets replaced by a fresh one. Value fresh node could adopt is never copied
+      bool adopt = !std::is_lvalue_reference<Value>::value && lru_node::adoptable(value);
+      bool reuse = !adopt && value.size() <= node->capacity && value.size() >= node->capacity / 2 &&
+                   !node->pinned();
+
+      std::size_t charge = _fresh_charge<Value>(node->key_size, value);
+      if (reuse) {
+          charge = _charge(node->key_size, value.size(), node->reserved(), node->external);
+      }
+      _discharge(node);
+      _evict(charge, node);
+      _wheel.cancel(node);
+
+      if (reuse) {
+          node->assign(value);
+      } else {
+          node = _replace_node(node, lru_node::Create(node->key(), std::forward<Value>(value), node->hash));
+      }
 
-      // insert node in the top of the list
-      _insert_node(node);
+      _recharge(node);
+      node->expire = expire;
+      node->cas = _cas += _cas_step;
+      _wheel.schedule(node);
       return true;
   }
 
-  bool SimpleLRU::_set_node(const std::string &key, const std::string &value, index::iterator &it_find)
+  bool SimpleLRU::_concat_node(lru_node *node, const std::string &data, bool prepend)
+  {
+      _get_up(node);
+
+      // Value grows in place while it fits into capacity, otherwise node is reallocated with slack for the
+      // next appends, unless slack doesn't fit into the storage
+      std::size_t old_size = node->value_size;
+      std::size_t new_size = old_size + data.size();
+      bool reuse = new_size <= node->capacity && !node->pinned();
+      std::size_t capacity = node->capacity;
+      if (!reuse) {
+          capacity = std::min<std::size_t>(new_size + new_size / 2, std::size_t(lru_node::max_size));
+          if (_overflow(_charge(node->key_size, new_size, capacity))) {
+              capacity = new_size;
+          }
+      }
+
+      _discharge(node);
+      _evict(reuse ? _charge(node->key_size, new_size, node->reserved(), node->external)
+                   : _charge(node->key_size, new_size, capacity),
+             node);
+
+      if (reuse) {
+          char *value = node->value_data();
+          if (prepend) {
+              std::memmove(value + data.size(), value, old_size);
+              std::memcpy(value, data.data(), data.size());
+          } else {
+              std::memcpy(value + old_size, data.data(), data.size());
+          }
+          node->value_size = new_size;
+      } else {
+          lru_node *fresh = lru_node::Create(node->key(), std::string(), node->hash, capacity);
+          char *value = fresh->value_data();
+          std::memcpy(value + (prepend ? data.size() : 0), node->value_data(), old_size);
+          std::memcpy(value + (prepend ? 0 : old_size), data.data(), data.size());
+          fresh->value_size = new_size;
+          fresh->expire = node->expire;
+
+          _wheel.cancel(node);
+          node = _replace_node(node, fresh);
+          _wheel.schedule(node);
+      }
+
+      _recharge(node);
+      node->cas = _cas += _cas_step;
+      return true;
+  }
+
+  // See SimpleLRU.h
+  std::size_t SimpleLRU::Expire(std::size_t budget)
+  {
+      return _wheel.advance(Now(), budget, [this](lru_node *node) { _delete_node(node); });
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::_set_limit(std::size_t max_size)
+  {
+      _max_size = max_size;
+      if (_sketch) {
+          _window_max = max_size / 100;
+      }
+      _protected_max = (max_size - _window_max) / 5 * 4;
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::SetMaxSize(std::size_t max_size)
+  {
+      _target_size = max_size;
+      if (max_size >= _max_size || _cur_size <= max_size) {
+          _set_limit(max_size);
+      }
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::Shrink(std::size_t budget)
   {
-      auto node_ref = it_find->second;
-      size_t node_value_size = node_ref.get().value.size();
+      for (; budget > 0 && _cur_size > _target_size; budget--) {
+          lru_node *victim = _victim(nullptr);
+          if (victim == nullptr) {
+              if (_window.empty()) {
+                  break;
+              }
+              victim = static_cast<lru_node *>(_window.prev);
+          }
+          _delete_node(victim);
+      }
+
+      // writes in between evict down to the limit reached so far rather than to the target at once
+      _set_limit(std::max(_target_size, _cur_size));
+      return _max_size == _target_size;
+  }
 
-      _get_up( &node_ref.get() );
-      _cur_size = _cur_size - node_value_size + value.size();
-      while (_overflow(_cur_size)) {
-          _lru_index.erase(std::cref(_lru_tail->key));
-          _cur_size  = _cur_size - _lru_tail->key.size() - _lru_tail->value.size();
-          _lru_tail = _lru_tail->prev;
-          _lru_tail->next.reset(nullptr);
+  // See SimpleLRU.h
+  uint32_t SimpleLRU::TailAge() const
+  {
+      const Link *tail = nullptr;
+      if (!_lru.empty()) {
+          tail = _policy == EvictionPolicy::Clock && _hand != &_lru ? _hand : _lru.prev;
+      } else if (!_protected.empty()) {
+          tail = _protected.prev;
+      } else if (!_window.empty()) {
+          tail = _window.prev;
+      } else {
+          return 0;
       }
 
-      node_ref.get().value = value;
+      uint32_t touched = static_cast<const lru_node *>(tail)->touched;
+      uint32_t now = Now();
+      return now > touched ? now - touched : 0;
+  }
 
+  // See SimpleLRU.h
+  bool SimpleLRU::Resize(std::size_t memory_limit)
+  {
+      SetMaxSize(memory_limit);
+      return Shrink(std::numeric_limits<std::size_t>::max());
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::Take(const std::string &key, const Visitor &visitor)
+  {
+      std::size_t hash = _hash(key);
+      lru_node *node = _find(key, hash, true);
+      if (node == nullptr) {
+          return false;
+      }
+
+      uint32_t now = Now();
+      int32_t ttl = node->expire != 0 ? node->expire - now : 0;
+      visitor(node->key_data(), node->key_size, node->value_data(), node->value_size, ttl);
+      _delete_node(node);
       return true;
   }
 
+  // See SimpleLRU.h
+  std::size_t SimpleLRU::TakeOldest(std::size_t count, const Visitor &visitor)
+  {
+      uint32_t now = Now();
+      std::size_t taken = 0;
+      for (Link *list : {&_lru, &_protected, &_window}) {
+          while (taken < count && !list->empty()) {
+              lru_node *node = static_cast<lru_node *>(list->prev);
+              if (!node->expired(now)) {
+                  int32_t ttl = node->expire != 0 ? node->expire - now : 0;
+                  visitor(node->key_data(), node->key_size, node->value_data(), node->value_size, ttl);
+              }
+              _delete_node(node);
+              taken++;
+          }
+      }
+      return taken;
+  }
 
-  bool SimpleLRU::Put(const std::string &key, const std::string &value) {
+  // See SimpleLRU.h
+  template <typename Value> bool SimpleLRU::_put(const std::string &key, Value &&value, int32_t ttl)
+  {
 
-      if (_overflow(key.size() + value.size())) {
+      if (_overflow(_fresh_charge<Value>(key.size(), value)) || value.size() > lru_node::max_size) {
           return false;
       }
-      auto it_find = _lru_index.find(std::cref(key));
-      if (it_find == _lru_index.end()) {
-          return _put_node(key, value);
+      Expire(_write_expire_budget);
+
+      std::size_t hash = _hash(key);
+      _record(hash);
+      lru_node *found = _find(key, hash, true);
+      if (ttl < 0) {
+          // memcached stores such item as expired right away, that is the same as removing it
+          if (found != nullptr) {
+              _delete_node(found);
+          }
+          return true;
+      }
+
+      if (found == nullptr) {
+          return _put_node(key, std::forward<Value>(value), hash, _expire_at(ttl));
       } else {
-          return _set_node(key, value, it_find);
+          return _set_node(found, std::forward<Value>(value), _expire_at(ttl));
       }
   }
 
 
-  // See MapBasedGlobalLockImpl.h
-  bool SimpleLRU::PutIfAbsent(const std::string &key, const std::string &value) {
-      auto it_find = _lru_index.find(std::cref(key));
-      if (it_find == _lru_index.end()) {
-          return _put_node(key, value);
+  // See SimpleLRU.h
+  template <typename Value> bool SimpleLRU::_put_if_absent(const std::string &key, Value &&value, int32_t ttl)
+  {
+      if (_overflow(_fresh_charge<Value>(key.size(), value)) || value.size() > lru_node::max_size) {
+          return false;
       }
-      return false;
+      Expire(_write_expire_budget);
+
+      std::size_t hash = _hash(key);
+      _record(hash);
+      if (_find(key, hash, true) != nullptr) {
+          return false;
+      }
+      return ttl < 0 || _put_node(key, std::forward<Value>(value), hash, _expire_at(ttl));
   }
 
-  // See MapBasedGlobalLockImpl.h
-  bool SimpleLRU::Set(const std::string &key, const std::string &value) {
-      auto it_find = _lru_index.find(std::cref(key));
-      if (it_find != _lru_index.end()) {
-          return _set_node(key, value, it_find);
+  // See SimpleLRU.h
+  template <typename Value> bool SimpleLRU::_set(const std::string &key, Value &&value, int32_t ttl)
+  {
+      if (_overflow(_fresh_charge<Value>(key.size(), value)) || value.size() > lru_node::max_size) {
+          return false;
+      }
+      Expire(_write_expire_budget);
+
+      std::size_t hash = _hash(key);
+      _record(hash);
+      lru_node *found = _find(key, hash, true);
+      if (found == nullptr) {
+          return false;
       }
-      return false;
+
+      if (ttl < 0) {
+          _delete_node(found);
+          return true;
+      }
+      return _set_node(found, std::forward<Value>(value), _expire_at(ttl));
   }
 
-  // See MapBasedGlobalLockImpl.h
-  bool SimpleLRU::Delete(const std::string &key)
+  // See SimpleLRU.h
+  bool SimpleLRU::Put(const std::string &key, const std::string &value, int32_t ttl)
   {
-      auto it_find = _lru_index.find(std::cref(key));
-      if (it_find == _lru_index.end()) {
+      return _put(key, value, ttl);
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::Put(const std::string &key, std::string &&value, int32_t ttl)
+  {
+      return _put(key, std::move(value), ttl);
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl)
+  {
+      return _put_if_absent(key, value, ttl);
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl)
+  {
+      return _put_if_absent(key, std::move(value), ttl);
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::Set(const std::string &key, const std::string &value, int32_t ttl)
+  {
+      return _set(key, value, ttl);
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::Set(const std::string &key, std::string &&value, int32_t ttl)
+  {
+      return _set(key, std::move(value), ttl);
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::Append(const std::string &key, const std::string &data)
+  {
+      return _concat(key, data, false);
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::Prepend(const std::string &key, const std::string &data)
+  {
+      return _concat(key, data, true);
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::_concat(const std::string &key, const std::string &data, bool prepend)
+  {
+      Expire(_write_expire_budget);
+
+      std::size_t hash = _hash(key);
+      _record(hash);
+      lru_node *found = _find(key, hash, true);
+      if (found == nullptr) {
           return false;
       }
 
-      lru_node *cur = &it_find->second.get();
-      _cur_size = _cur_size - cur->value.size() - cur->key.size();
+      std::size_t new_size = found->value_size + data.size();
+      if (_overflow(_charge(key.size(), new_size, new_size)) || new_size > lru_node::max_size) {
+          return false;
+      }
+      return _concat_node(found, data, prepend);
+  }
 
-      if (cur->next != nullptr) {
-          cur->next->prev = cur->prev;
-          cur->prev->next = std::move(cur->next);
-      } else {
-          _lru_tail = cur->prev;
-          cur->prev->next = nullptr;
+  // See SimpleLRU.h
+  SimpleLRU::CounterResult SimpleLRU::Incr(const std::string &key, uint64_t delta, uint64_t &value)
+  {
+      return _count(key, delta, false, value);
+  }
+
+  // See SimpleLRU.h
+  SimpleLRU::CounterResult SimpleLRU::Decr(const std::string &key, uint64_t delta, uint64_t &value)
+  {
+      return _count(key, delta, true, value);
+  }
+
+  // See SimpleLRU.h
+  SimpleLRU::CounterResult SimpleLRU::_count(const std::string &key, uint64_t delta, bool decrement, uint64_t &value)
+  {
+      Expire(_write_expire_budget);
+
+      std::size_t hash = _hash(key);
+      _record(hash);
+      lru_node *found = _find(key, hash, true);
+      if (found == nullptr) {
+          return CounterResult::NotFound;
+      }
+      if (!Count(found->value_data(), found->value_size, delta, decrement, value)) {
+          return CounterResult::NotNumber;
       }
 
-      _lru_index.erase(it_find);
+      // Counter takes at most 20 digits, so the same node is reused unless it is pinned
+      std::string counter = std::to_string(value);
+      if (_overflow(_charge(key.size(), counter.size(), counter.size()))) {
+          return CounterResult::NotStored;
+      }
+      _set_node(found, counter, found->expire);
+      return CounterResult::Stored;
+  }
 
+  // See SimpleLRU.h
+  bool SimpleLRU::Delete(const std::string &key)
+  {
+      lru_node *cur = _find(key, _hash(key), true);
+      if (cur == nullptr) {
+          return false;
+      }
+
+      _delete_node(cur);
       return true;
   }
 
-  // See MapBasedGlobalLockImpl.h
+  // See SimpleLRU.h
   bool SimpleLRU::Get(const std::string &key, std::string &value)
   {
-      auto it_find = _lru_index.find(std::cref(key));
-      if (it_find == _lru_index.end()) {
+      std::size_t hash = _hash(key);
+      _record(hash);
+      lru_node *cur = _find(key, hash, !SharedReads());
+      if (cur == nullptr) {
           return false;
       } else {
-          lru_node *cur = &it_find->second.get();
           _get_up(cur);
-          value = cur->value;
+          value.assign(cur->value_data(), cur->value_size);
           return true;
       }
   }
 
+  // See SimpleLRU.h
+  bool SimpleLRU::GetPinned(const std::string &key, PinnedValue &value)
+  {
+      std::size_t hash = _hash(key);
+      _record(hash);
+      lru_node *cur = _find(key, hash, !SharedReads());
+      if (cur == nullptr) {
+          return false;
+      }
+
+      _get_up(cur);
+      value = cur->Pin();
+      return true;
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::GetCas(const std::string &key, PinnedValue &value, uint64_t &cas)
+  {
+      std::size_t hash = _hash(key);
+      _record(hash);
+      lru_node *cur = _find(key, hash, !SharedReads());
+      if (cur == nullptr) {
+          return false;
+      }
+
+      _get_up(cur);
+      value = cur->Pin();
+      cas = cur->cas;
+      return true;
+  }
+
+  // See SimpleLRU.h
+  template <typename Value>
+  SimpleLRU::CasResult SimpleLRU::_compare_and_set(const std::string &key, Value &&value, uint64_t cas, int32_t ttl)
+  {
+      if (_overflow(_fresh_charge<Value>(key.size(), value)) || value.size() > lru_node::max_size) {
+          return CasResult::NotStored;
+      }
+      Expire(_write_expire_budget);
+
+      std::size_t hash = _hash(key);
+      _record(hash);
+      lru_node *found = _find(key, hash, true);
+      if (found == nullptr) {
+          return CasResult::NotFound;
+      }
+      if (found->cas != cas) {
+          return CasResult::Exists;
+      }
+
+      if (ttl < 0) {
+          _delete_node(found);
+      } else {
+          _set_node(found, std::forward<Value>(value), _expire_at(ttl));
+      }
+      return CasResult::Stored;
+  }
+
+  // See SimpleLRU.h
+  SimpleLRU::CasResult SimpleLRU::CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                                                int32_t ttl)
+  {
+      return _compare_and_set(key, value, cas, ttl);
+  }
+
+  // See SimpleLRU.h
+  SimpleLRU::CasResult SimpleLRU::CompareAndSet(const std::string &key, std::string &&value, uint64_t cas,
+                                                int32_t ttl)
+  {
+      return _compare_and_set(key, std::move(value), cas, ttl);
+  }
+
+  // See SimpleLRU.h
+  void SimpleLRU::GetStats(std::vector<std::pair<std::string, std::string>> &stats)
+  {
+      stats.emplace_back("limit_maxbytes", std::to_string(_max_size));
+      stats.emplace_back("bytes", std::to_string(_cur_size));
+      stats.emplace_back("heap_bytes", std::to_string(_heap_size + _lru_index->memory()));
+      stats.emplace_back("curr_items", std::to_string(_lru_index->size()));
+  }
+
+  // See SimpleLRU.h
+  bool SimpleLRU::Scan(const Visitor &visitor)
+  {
+      // Main part goes first as window keeps the most recent nodes, within each list tail is the oldest
+      uint32_t now = Now();
+      for (Link *list : {&_lru, &_protected, &_window}) {
+          for (Link *link = list->prev; link != list; link = link->prev) {
+              lru_node *node = static_cast<lru_node *>(link);
+              if (node->expired(now)) {
+                  continue;
+              }
+              int32_t ttl = node->expire != 0 ? node->expire - now : 0;
+              visitor(node->key_data(), node->key_size, node->value_data(), node->value_size, ttl);
+          }
+      }
+      return true;
+  }
+
 } // namespace Backend
 } // namespace Afina
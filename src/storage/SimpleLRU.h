@@ -1,6 +1,7 @@
 #ifndef AFINA_STORAGE_SIMPLE_LRU_H
 #define AFINA_STORAGE_SIMPLE_LRU_H
 
+#include <chrono>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -8,50 +9,182 @@
 
 #include <afina/Storage.h>
 
+#include "FrequencySketch.h"
+#include "Index.h"
+#include "MemoryBudget.h"
+#include "Node.h"
+#include "TimerWheel.h"
+
 namespace Afina {
 namespace Backend {
 
+/**
+ * # Eviction policy
+ * - LRU: exact LRU, every hit moves node to the head of the list
+ * - Clock: CLOCK approximation of LRU, hit only sets reference bit of the node. Reads don't modify
+ *   storage structure, so they could run in parallel under shared lock
+ * - Segmented: segmented LRU. New nodes get into probation segment and move into protected one on the
+ *   second hit, eviction takes probation first. One-pass scans churn probation only and keep hot set
+ */
+enum class EvictionPolicy { LRU, Clock, Segmented };
+
+/**
+ * # Admission policy
+ * - All: every new node is stored, eviction policy alone decides what to drop
+ * - TinyLFU: new nodes get into small LRU window first (1% of memory). Node pushed out of the window is
+ *   admitted into main part only if it was accessed more often than the victim of eviction policy, access
+ *   frequency is estimated by count-min sketch. One-hit-wonder keys don't push out popular ones
+ */
+enum class Admission { All, TinyLFU };
+
+/**
+ * # Memory accounting
+ * - Payload: node is charged for key and value bytes only, real memory usage could be several times
+ *   higher for small items
+ * - Precise: node is charged for its heap footprint: header, key and value capacity, or adopted string with
+ *   its whole buffer, malloc overhead and its share of the index. Memory limit then bounds real usage up to
+ *   fixed engine structures
+ */
+enum class Accounting { Payload, Precise };
+
 /**
  * # Map based implementation
  * That is NOT thread safe implementaiton!!
+ *
+ * Lookup structure is selected by IndexType: either std::map or open addressing hash table
+ *
+ * Expired nodes are never returned. Reads drop them on the way unless reads are shared, writes reclaim
+ * them in small slices by expiration order and Expire does the same on demand
  */
 
  class SimpleLRU : public Afina::Storage {
  public:
-     SimpleLRU(size_t max_size = 1024) : _max_size(max_size)
-     {
-         _lru_head = std::unique_ptr<lru_node>( new lru_node("", "") );
-         _lru_tail = _lru_head.get();
+     SimpleLRU(size_t max_size = 1024, IndexType index_type = IndexType::Map,
+               EvictionPolicy policy = EvictionPolicy::LRU, Admission admission = Admission::All,
+               Accounting accounting = Accounting::Payload)
+         : _max_size(max_size), _target_size(max_size), _policy(policy), _accounting(accounting), _hand(&_lru),
+           _lru_index(make_index<lru_node>(index_type)),
+           _epoch(std::chrono::steady_clock::now()) {
+         if (admission == Admission::TinyLFU) {
+             // sketch is sized for entries of 64 bytes on average, that is 4 bytes per 64 bytes of storage
+             _sketch.reset(new FrequencySketch(max_size / 64));
+         }
+         _set_limit(max_size);
      }
 
-     SimpleLRU(SimpleLRU &&cache) {
-        if (this != &cache) {
-            _lru_head = std::move(cache._lru_head);
-            _lru_tail = std::move(cache._lru_tail);
-            _max_size = cache._max_size;
-            _cur_size = cache._cur_size;
-            _lru_index = std::move(cache._lru_index);
-        }
-     }
-     // SimpleLRU(const SimpleLRU &) = delete;
+     SimpleLRU(const SimpleLRU &) = delete;
 
      ~SimpleLRU() {
-         _lru_index.clear();
-         while (_lru_tail != _lru_head.get()) {
-             _lru_tail = _lru_tail->prev;
-             _lru_tail->next.reset();
+         for (Link *list : {&_lru, &_protected, &_window}) {
+             while (!list->empty()) {
+                 lru_node *node = static_cast<lru_node *>(list->next);
+                 node->unlink();
+                 _wheel.cancel(node);
+                 lru_node::Unref(node);
+             }
          }
-         _lru_head.reset();
      }
 
+    /**
+     * Returns true if Get and GetPinned don't change storage structure, so that thread safe wrappers
+     * could run them concurrently under shared lock
+     */
+    bool SharedReads() const { return _policy == EvictionPolicy::Clock && !_sketch; }
+
+    /**
+     * Reclaims expired nodes, does at most budget units of work. See TimerWheel#advance
+     *
+     * Returns number of nodes reclaimed
+     */
+    std::size_t Expire(std::size_t budget);
+
+    /**
+     * Changes memory limit. Growth takes effect at once, shrink is gradual: limit comes down to the new one
+     * with each Shrink slice, so that no single call evicts much
+     */
+    void SetMaxSize(std::size_t max_size);
+
+    /**
+     * Evicts at most budget nodes towards the limit set by SetMaxSize, returns true once it is reached
+     */
+    bool Shrink(std::size_t budget);
+
+    /**
+     * Lets storage borrow from the shared budget once its own limit is used up, before evicting anything.
+     * Borrowed bytes become part of the limit, so only whoever shrinks the storage returns them. Budget
+     * must outlive the storage, nullptr detaches it
+     */
+    void SetBudget(MemoryBudget *budget) { _budget = budget; }
+
+    /**
+     * Returns memory limit storage is heading to, see SetMaxSize
+     */
+    std::size_t Limit() const { return _target_size; }
+
+    /**
+     * Returns number of bytes charged for nodes stored
+     */
+    std::size_t Size() const { return _cur_size; }
+
+    /**
+     * Returns number of seconds since node to be evicted next was last used, 0 if storage is empty. Kept
+     * only while budget is set; Clock policy ages nodes by insertion, as its hits don't write nodes
+     */
+    uint32_t TailAge() const;
+
+    /**
+     * Changes memory limit and evicts nodes above it right away, see SetMaxSize
+     */
+    bool Resize(std::size_t memory_limit) override;
+
+    /**
+     * Passes association of the key into visitor as Scan does and deletes it. Returns false if key is absent
+     */
+    bool Take(const std::string &key, const Visitor &visitor);
+
+    /**
+     * Takes at most count associations in Scan order, see Take. Returns number of nodes removed, expired
+     * ones included, so storage is empty once it is less than count
+     */
+    std::size_t TakeOldest(std::size_t count, const Visitor &visitor);
+
     // Implements Afina::Storage interface
-    bool Put(const std::string &key, const std::string &value) override;
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    /**
+     * Large value is adopted by the node instead of copied, see Node#Create
+     */
+    bool Put(const std::string &key, std::string &&value, int32_t ttl = 0) override;
 
     // Implements Afina::Storage interface
-    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Same as Put
+    bool PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl = 0) override;
 
     // Implements Afina::Storage interface
-    bool Set(const std::string &key, const std::string &value) override;
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Same as Put
+    bool Set(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    /**
+     * Grows value in place if node has spare capacity and isn't pinned, otherwise node is reallocated
+     * with capacity half as large again as the new value, so that series of appends takes amortized
+     * constant number of copies per byte
+     */
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Same as Append
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    /**
+     * Updates counter under a single lookup, value is rewritten in place unless node is pinned
+     */
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Same as Incr
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override;
 
     // Implements Afina::Storage interface
     bool Delete(const std::string &key) override;
@@ -59,43 +192,152 @@ namespace Backend {
     // Implements Afina::Storage interface
     bool Get(const std::string &key, std::string &value) override;
 
-private:
-    // LRU cache node
-    using lru_node = struct lru_node {
-        const std::string key;
-        std::string value;
-        lru_node *prev;
-        std::unique_ptr<lru_node> next;
+    // Implements Afina::Storage interface
+    bool GetPinned(const std::string &key, PinnedValue &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override;
 
-        lru_node(const std::string &key, const std::string &value) :
-              key(key), value(value), prev(nullptr), next(nullptr) {}
-    };
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override;
+
+    // Same as Put
+    CasResult CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl = 0) override;
+
+    /**
+     * Makes versions issued by this engine congruent to offset modulo step, so that shards of the same
+     * storage never issue equal versions. Offsets of the shards must differ modulo step, the first version
+     * issued is offset + step
+     */
+    void CasSequence(uint64_t offset, uint64_t step) {
+        _cas = offset;
+        _cas_step = step;
+    }
+
+    /**
+     * Returns the last version issued, see CasSequence
+     */
+    uint64_t LastCas() const { return _cas; }
+
+    /**
+     * Reports configured limit against charged and real memory usage:
+     * - limit_maxbytes: memory limit
+     * - bytes: memory charged against the limit, see Accounting
+     * - heap_bytes: real memory taken by nodes and index
+     * - curr_items: number of stored keys
+     */
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override;
+
+    // Implements Afina::Storage interface
+    bool Scan(const Visitor &visitor) override;
 
-    using index = std::map<std::reference_wrapper<const std::string>,
-                    std::reference_wrapper<lru_node>, std::less<const std::string>>;
+protected:
+    /**
+     * Returns engine time: number of seconds since engine creation
+     */
+    virtual uint32_t Now() const {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - _epoch).count();
+    }
+
+private:
+    // LRU cache node: single allocation with key and value bytes, see Node.h
+    using lru_node = Node;
+
+    using index = Index<lru_node>;
 
     // Maximum number of bytes could be stored in this cache.
     // i.e all (keys+values) must be less the _max_size
     std::size_t _max_size;
 
+    // Limit _max_size is brought down to by Shrink, see SetMaxSize
+    std::size_t _target_size;
+
+    // Shared memory limit is borrowed from, see SetBudget
+    MemoryBudget *_budget = nullptr;
+
     // Current storage size
     std::size_t _cur_size = 0;
 
-    // Main storage of lru_nodes, elements in this list ordered descending by "freshness": in the head
-    // element that wasn't used for longest time.
+    const EvictionPolicy _policy;
+
+    // How nodes are charged against _max_size, and real heap usage by nodes regardless of accounting
+    const Accounting _accounting;
+    std::size_t _heap_size = 0;
+
+    // Sentinel of the main storage of lru_nodes, elements in this list ordered descending by "freshness":
+    // _lru.next is the most recently used one, _lru.prev is the element that wasn't used for longest time.
     //
-    // List owns all nodes
-    std::unique_ptr<lru_node> _lru_head;
-    lru_node *_lru_tail;
+    // For Clock policy the list is a ring instead, _hand points to the next node to be checked for eviction
+    // and moves from tail to head, sentinel means hand wraps to the tail.
+    //
+    // Lists own all nodes
+    Link _lru;
+    Link *_hand;
+
+    // For Segmented policy _lru is a probation segment and nodes hit twice live in the protected one, which
+    // could take up to _protected_max bytes, 80% of the storage. Otherwise protected segment is unused
+    enum Segment : uint8_t { Probation = 0, Protected = 1, Window = 2 };
+    Link _protected;
+    std::size_t _protected_max;
+    std::size_t _protected_size = 0;
+
+    // TinyLFU admission: access frequency of keys and LRU window of new nodes, which could take up to
+    // _window_max bytes. Lists above make main part of the storage then
+    std::unique_ptr<FrequencySketch> _sketch;
+    Link _window;
+    std::size_t _window_max = 0;
+    std::size_t _window_size = 0;
 
     // Index of nodes from list above, allows fast random access to elements by lru_node#key
-    index _lru_index;
+    std::unique_ptr<index> _lru_index;
+
+    // Nodes having expiration time by the time they expire at
+    TimerWheel _wheel;
+    std::chrono::steady_clock::time_point _epoch;
+
+    // The last version issued and distance between versions, see CasSequence
+    uint64_t _cas = 0;
+    uint64_t _cas_step = 1;
+
+    // Work budget of reclaiming expired nodes on each write
+    static constexpr std::size_t _write_expire_budget = 8;
 
     bool _overflow(size_t new_size) const;
-    void _insert_node(std::unique_ptr<lru_node> &node);
+    void _set_limit(std::size_t max_size);
+    std::size_t _charge(std::size_t key_size, std::size_t value_size, std::size_t capacity,
+                        bool external = false) const;
+    std::size_t _charge(const lru_node *node) const;
+    template <typename Value> std::size_t _fresh_charge(std::size_t key_size, const std::string &value) const;
+    std::size_t _hash(const std::string &key) const;
+    void _record(std::size_t hash);
+    uint32_t _expire_at(int32_t ttl) const;
+    lru_node *_find(const std::string &key, std::size_t hash, bool reclaim);
+    void _insert_node(lru_node *node);
+    void _touch(lru_node *node) const;
     void _get_up(lru_node *cur);
-    bool _put_node(const std::string &key, const std::string &value);
-    bool _set_node(const std::string &key, const std::string &value, index::iterator &it_find);
+    void _unlink_node(lru_node *node);
+    void _delete_node(lru_node *node);
+    lru_node *_victim();
+    lru_node *_victim(const lru_node *keep);
+    void _demote();
+    void _admit(size_t new_size, const lru_node *keep);
+    void _evict(size_t new_size, const lru_node *keep);
+    // Writers below take value either as const std::string & or as std::string rvalue, the latter is moved
+    // into node when it could be adopted
+    template <typename Value> bool _put(const std::string &key, Value &&value, int32_t ttl);
+    template <typename Value> bool _put_if_absent(const std::string &key, Value &&value, int32_t ttl);
+    template <typename Value> bool _set(const std::string &key, Value &&value, int32_t ttl);
+    template <typename Value>
+    CasResult _compare_and_set(const std::string &key, Value &&value, uint64_t cas, int32_t ttl);
+    template <typename Value> bool _put_node(const std::string &key, Value &&value, std::size_t hash, uint32_t expire);
+    void _discharge(lru_node *node);
+    void _recharge(lru_node *node);
+    lru_node *_replace_node(lru_node *node, lru_node *fresh);
+    template <typename Value> bool _set_node(lru_node *node, Value &&value, uint32_t expire);
+    bool _concat_node(lru_node *node, const std::string &data, bool prepend);
+    bool _concat(const std::string &key, const std::string &data, bool prepend);
+    CounterResult _count(const std::string &key, uint64_t delta, bool decrement, uint64_t &value);
 
  };
 
@@ -0,0 +1,372 @@
+#include "SlabLRU.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace Afina {
+namespace Backend {
+
+SlabLRU::SlabLRU(size_t max_size, IndexType index_type, size_t page_size)
+    : _max_size(max_size), _memory(new char[max_size]),
+      _slab(_memory.get(), max_size, std::max<size_t>(std::min(page_size, max_size / 16), 1024)),
+      _classes(new Class[_slab.classes()]), _index(make_index<Item>(index_type)),
+      _epoch(std::chrono::steady_clock::now()) {}
+
+// See SlabLRU.h
+uint32_t SlabLRU::_expire_at(int32_t ttl) const { return ttl > 0 ? Now() + ttl : 0; }
+
+// See SlabLRU.h
+SlabLRU::Item *SlabLRU::_find(const std::string &key, std::size_t hash) {
+    Item *item = _index->find(key, hash);
+    if (item != nullptr && item->expire != 0 && item->expire <= Now()) {
+        _delete_item(item);
+        return nullptr;
+    }
+    return item;
+}
+
+// See SlabLRU.h
+void SlabLRU::_touch(Item *item) {
+    item->atime = ++_clock;
+
+    Link &lru = _classes[item->cls].lru;
+    if (lru.next != item) {
+        item->unlink();
+        item->link_after(&lru);
+    }
+}
+
+// See SlabLRU.h
+void SlabLRU::_delete_item(Item *item) {
+    _index->erase(item);
+    item->unlink();
+    _bytes -= sizeof(Item) + item->key_size + item->value_size;
+    _slab.free(item);
+}
+
+// See SlabLRU.h
+uint64_t SlabLRU::_tail_atime(unsigned cls) const {
+    const Link &lru = _classes[cls].lru;
+    return lru.empty() ? 0 : static_cast<const Item *>(lru.prev)->atime;
+}
+
+// See SlabLRU.h
+int SlabLRU::_oldest_class(unsigned except, int keep) const {
+    int oldest = -1;
+    for (unsigned cls = 0; cls < _slab.classes(); cls++) {
+        if (cls != except && int(cls) != keep && _slab.pages(cls) > 0 && (oldest < 0 || _tail_atime(cls) < _tail_atime(oldest))) {
+            oldest = cls;
+        }
+    }
+    return oldest;
+}
+
+// See SlabLRU.h
+void *SlabLRU::_alloc(unsigned cls, int keep) {
+    Class &c = _classes[cls];
+    void *chunk = _slab.alloc(cls);
+    while (chunk == nullptr) {
+        // Class under pressure asks for a page of the class keeping the oldest items, empty class always
+        // does as it has nothing to evict
+        int donor = -1;
+        if (c.lru.empty() || c.pressure >= _slab.per_page(cls)) {
+            donor = _oldest_class(cls, keep);
+        }
+
+        if (donor >= 0 && (c.lru.empty() || _tail_atime(donor) < _tail_atime(cls))) {
+            _slab.reclaim(donor, [this](void *p) { _delete_item(static_cast<Item *>(p)); });
+            c.pressure = 0;
+        } else if (!c.lru.empty()) {
+            _delete_item(static_cast<Item *>(c.lru.prev));
+            c.pressure++;
+            c.evictions++;
+        } else {
+            return nullptr;
+        }
+        chunk = _slab.alloc(cls);
+    }
+    return chunk;
+}
+
+// See SlabLRU.h
+void SlabLRU::_init_item(void *chunk, unsigned cls, const std::string &key, const std::string &value,
+                         std::size_t hash, uint32_t expire) {
+    Item *item = new (chunk) Item();
+    item->hash = hash;
+    item->key_size = key.size();
+    item->value_size = value.size();
+    item->expire = expire;
+    item->cls = cls;
+    item->cas = ++_cas;
+    std::memcpy(reinterpret_cast<char *>(item + 1), key.data(), key.size());
+    std::memcpy(item->value_data(), value.data(), value.size());
+
+    item->link_after(&_classes[cls].lru);
+    item->atime = ++_clock;
+    _index->insert(item);
+    _bytes += sizeof(Item) + key.size() + value.size();
+}
+
+// See SlabLRU.h
+bool SlabLRU::_put_item(const std::string &key, const std::string &value, std::size_t hash, uint32_t expire) {
+    int cls = _slab.class_of(sizeof(Item) + key.size() + value.size());
+    void *chunk = _alloc(cls);
+    if (chunk == nullptr) {
+        return false;
+    }
+    _init_item(chunk, cls, key, value, hash, expire);
+    return true;
+}
+
+// See SlabLRU.h
+bool SlabLRU::_move_item(Item *item, unsigned cls, const std::string &key, const std::string &value,
+                         std::size_t hash) {
+    // Chunk of the other class is taken while item is still there, so failure leaves it as is. Class of the
+    // item doesn't give pages away meanwhile, as the page taken could be the one of the item
+    uint32_t expire = item->expire;
+    void *chunk = _alloc(cls, item->cls);
+    if (chunk == nullptr) {
+        // All pages belong to the class of the item, it has a page to give once item is freed
+        _delete_item(item);
+        return _put_item(key, value, hash, expire);
+    }
+    _delete_item(item);
+    _init_item(chunk, cls, key, value, hash, expire);
+    return true;
+}
+
+// See SlabLRU.h
+bool SlabLRU::Put(const std::string &key, const std::string &value, int32_t ttl) {
+    int cls = _slab.class_of(sizeof(Item) + key.size() + value.size());
+    if (cls < 0) {
+        return false;
+    }
+
+    std::size_t hash = _index->hash(key);
+    Item *found = _find(key, hash);
+    if (found != nullptr && (ttl < 0 || found->cls != unsigned(cls))) {
+        _delete_item(found);
+        found = nullptr;
+    }
+    if (ttl < 0) {
+        return true;
+    }
+
+    if (found == nullptr) {
+        return _put_item(key, value, hash, _expire_at(ttl));
+    }
+
+    // Value of the same class fits into the chunk
+    _bytes += value.size() - found->value_size;
+    std::memcpy(found->value_data(), value.data(), value.size());
+    found->value_size = value.size();
+    found->expire = _expire_at(ttl);
+    found->cas = ++_cas;
+    _touch(found);
+    return true;
+}
+
+// See SlabLRU.h
+bool SlabLRU::PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl) {
+    if (_slab.class_of(sizeof(Item) + key.size() + value.size()) < 0) {
+        return false;
+    }
+
+    std::size_t hash = _index->hash(key);
+    if (_find(key, hash) != nullptr) {
+        return false;
+    }
+    return ttl < 0 || _put_item(key, value, hash, _expire_at(ttl));
+}
+
+// See SlabLRU.h
+bool SlabLRU::Set(const std::string &key, const std::string &value, int32_t ttl) {
+    if (_slab.class_of(sizeof(Item) + key.size() + value.size()) < 0) {
+        return false;
+    }
+
+    if (_find(key, _index->hash(key)) == nullptr) {
+        return false;
+    }
+    return Put(key, value, ttl);
+}
+
+// See SlabLRU.h
+bool SlabLRU::_concat(const std::string &key, const std::string &data, bool prepend) {
+    std::size_t hash = _index->hash(key);
+    Item *item = _find(key, hash);
+    if (item == nullptr) {
+        return false;
+    }
+
+    std::size_t old_size = item->value_size;
+    std::size_t new_size = old_size + data.size();
+    int cls = _slab.class_of(sizeof(Item) + key.size() + new_size);
+    if (cls < 0) {
+        return false;
+    }
+
+    if (unsigned(cls) == item->cls) {
+        // Chunk has room for the grown value
+        char *value = item->value_data();
+        if (prepend) {
+            std::memmove(value + data.size(), value, old_size);
+            std::memcpy(value, data.data(), data.size());
+        } else {
+            std::memcpy(value + old_size, data.data(), data.size());
+        }
+        item->value_size = new_size;
+        item->cas = ++_cas;
+        _bytes += data.size();
+        _touch(item);
+        return true;
+    }
+
+    std::string value;
+    value.reserve(new_size);
+    if (prepend) {
+        value.append(data).append(item->value_data(), old_size);
+    } else {
+        value.append(item->value_data(), old_size).append(data);
+    }
+    return _move_item(item, cls, key, value, hash);
+}
+
+// See SlabLRU.h
+bool SlabLRU::Append(const std::string &key, const std::string &data) { return _concat(key, data, false); }
+
+// See SlabLRU.h
+bool SlabLRU::Prepend(const std::string &key, const std::string &data) { return _concat(key, data, true); }
+
+// See SlabLRU.h
+SlabLRU::CounterResult SlabLRU::_count(const std::string &key, uint64_t delta, bool decrement, uint64_t &value) {
+    std::size_t hash = _index->hash(key);
+    Item *item = _find(key, hash);
+    if (item == nullptr) {
+        return CounterResult::NotFound;
+    }
+    if (!Count(item->value_data(), item->value_size, delta, decrement, value)) {
+        return CounterResult::NotNumber;
+    }
+
+    std::string counter = std::to_string(value);
+    int cls = _slab.class_of(sizeof(Item) + key.size() + counter.size());
+    if (cls < 0) {
+        return CounterResult::NotStored;
+    }
+
+    if (unsigned(cls) == item->cls) {
+        _bytes += counter.size() - item->value_size;
+        std::memcpy(item->value_data(), counter.data(), counter.size());
+        item->value_size = counter.size();
+        item->cas = ++_cas;
+        _touch(item);
+        return CounterResult::Stored;
+    }
+
+    return _move_item(item, cls, key, counter, hash) ? CounterResult::Stored : CounterResult::NotStored;
+}
+
+// See SlabLRU.h
+SlabLRU::CounterResult SlabLRU::Incr(const std::string &key, uint64_t delta, uint64_t &value) {
+    return _count(key, delta, false, value);
+}
+
+// See SlabLRU.h
+SlabLRU::CounterResult SlabLRU::Decr(const std::string &key, uint64_t delta, uint64_t &value) {
+    return _count(key, delta, true, value);
+}
+
+// See SlabLRU.h
+bool SlabLRU::Delete(const std::string &key) {
+    Item *item = _find(key, _index->hash(key));
+    if (item == nullptr) {
+        return false;
+    }
+
+    _delete_item(item);
+    return true;
+}
+
+// See SlabLRU.h
+bool SlabLRU::Get(const std::string &key, std::string &value) {
+    Item *item = _find(key, _index->hash(key));
+    if (item == nullptr) {
+        return false;
+    }
+
+    _touch(item);
+    value.assign(item->value_data(), item->value_size);
+    return true;
+}
+
+// See SlabLRU.h
+bool SlabLRU::GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) {
+    Item *item = _find(key, _index->hash(key));
+    if (item == nullptr) {
+        return false;
+    }
+
+    _touch(item);
+    value = PinnedValue(std::string(item->value_data(), item->value_size));
+    cas = item->cas;
+    return true;
+}
+
+// See SlabLRU.h
+SlabLRU::CasResult SlabLRU::CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                                          int32_t ttl) {
+    if (_slab.class_of(sizeof(Item) + key.size() + value.size()) < 0) {
+        return CasResult::NotStored;
+    }
+
+    Item *item = _find(key, _index->hash(key));
+    if (item == nullptr) {
+        return CasResult::NotFound;
+    }
+    if (item->cas != cas) {
+        return CasResult::Exists;
+    }
+    return Put(key, value, ttl) ? CasResult::Stored : CasResult::NotStored;
+}
+
+// See SlabLRU.h
+void SlabLRU::GetStats(std::vector<std::pair<std::string, std::string>> &stats) {
+    stats.emplace_back("limit_maxbytes", std::to_string(_max_size));
+    stats.emplace_back("bytes", std::to_string(_bytes));
+    stats.emplace_back("heap_bytes", std::to_string(_max_size + _index->memory()));
+    stats.emplace_back("curr_items", std::to_string(_index->size()));
+
+    for (unsigned cls = 0; cls < _slab.classes(); cls++) {
+        if (_slab.pages(cls) == 0 && _classes[cls].evictions == 0) {
+            continue;
+        }
+
+        std::string prefix = std::to_string(cls) + ":";
+        stats.emplace_back(prefix + "chunk_size", std::to_string(_slab.chunk_size(cls)));
+        stats.emplace_back(prefix + "total_pages", std::to_string(_slab.pages(cls)));
+        stats.emplace_back(prefix + "used_chunks", std::to_string(_slab.used(cls)));
+        stats.emplace_back(prefix + "evictions", std::to_string(_classes[cls].evictions));
+    }
+}
+
+// See SlabLRU.h
+bool SlabLRU::Scan(const Visitor &visitor) {
+    uint32_t now = Now();
+    for (unsigned cls = 0; cls < _slab.classes(); cls++) {
+        Link &lru = _classes[cls].lru;
+        for (Link *link = lru.prev; link != &lru; link = link->prev) {
+            Item *item = static_cast<Item *>(link);
+            if (item->expire != 0 && item->expire <= now) {
+                continue;
+            }
+            int32_t ttl = item->expire != 0 ? item->expire - now : 0;
+            visitor(item->key_data(), item->key_size, item->value_data(), item->value_size, ttl);
+        }
+    }
+    return true;
+}
+
+} // namespace Backend
+} // namespace Afina
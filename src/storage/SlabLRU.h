@@ -0,0 +1,177 @@
+#ifndef AFINA_STORAGE_SLAB_LRU_H
+#define AFINA_STORAGE_SLAB_LRU_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <afina/Storage.h>
+#include <afina/allocator/Slab.h>
+
+#include "Index.h"
+#include "Node.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Slab class based implementation
+ * That is NOT thread safe implementation!!
+ *
+ * All memory is allocated once on construction and split by Allocator::Slab into pages of size classes,
+ * item takes a chunk of the smallest class it fits in. Each class has its own LRU list, eviction drops
+ * the tail of the class new item belongs to, so Put never calls malloc (index aside) and churn never
+ * fragments memory.
+ *
+ * Classes compete for pages: once a class evicted a page worth of items since it last got a page, while
+ * another class keeps items older than the tail of this one, the least used page of that other class is
+ * emptied and handed over. Memory follows the value size distribution that way.
+ *
+ * Expired items are never returned and get dropped lazily on access. Values are copied out, so pinned
+ * reads use default Storage#GetPinned
+ */
+class SlabLRU : public Afina::Storage {
+public:
+    /**
+     * @param max_size number of bytes preallocated for items
+     * @param index_type key index
+     * @param page_size number of bytes in a slab page, that is the largest item. Gets reduced for small
+     *        storages, so that there are at least 16 pages
+     */
+    SlabLRU(size_t max_size = 1024 * 1024, IndexType index_type = IndexType::Map, size_t page_size = 1024 * 1024);
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    /**
+     * Grows value in place while it fits into the chunk, otherwise item moves to the chunk of the larger
+     * class
+     */
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Same as Append
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    /**
+     * Rewrites counter in place while it stays in the same class, see Append
+     */
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Same as Incr
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override;
+
+    /**
+     * Reports totals as SimpleLRU does, followed by state of each class in use prefixed by class number:
+     * - chunk_size: number of bytes in the chunk
+     * - total_pages: number of pages class takes
+     * - used_chunks: number of items in the class
+     * - evictions: number of items evicted from the class
+     */
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override;
+
+    /**
+     * Scans classes one after another, so eviction order is restored within each class only
+     */
+    bool Scan(const Visitor &visitor) override;
+
+protected:
+    /**
+     * Returns engine time: number of seconds since engine creation
+     */
+    virtual uint32_t Now() const {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - _epoch).count();
+    }
+
+private:
+    SlabLRU(const SlabLRU &);            // = delete;
+    SlabLRU &operator=(const SlabLRU &); // = delete;
+
+    /**
+     * # Item in the slab chunk
+     * Header followed by key and value bytes, chunk could be larger than that
+     */
+    struct Item : public Link {
+        // hash of the key, see Index#hash
+        std::size_t hash;
+        uint32_t key_size;
+        uint32_t value_size;
+        // engine time in seconds item expires at, 0 if never
+        uint32_t expire;
+        // slab class of the chunk
+        uint32_t cls;
+        // logical time of the last access, compares ages of items in different classes
+        uint64_t atime;
+        // version of the value, see Storage#GetCas
+        uint64_t cas;
+
+        const char *key_data() const { return reinterpret_cast<const char *>(this + 1); }
+        KeyRef key() const { return KeyRef(key_data(), key_size); }
+
+        char *value_data() { return reinterpret_cast<char *>(this + 1) + key_size; }
+    };
+
+    // Per class LRU and counters
+    struct Class {
+        // lru.next is the most recently used item, lru.prev is the eviction candidate
+        Link lru;
+        // evictions since class got a page last time
+        std::size_t pressure = 0;
+        std::size_t evictions = 0;
+    };
+
+    std::size_t _max_size;
+
+    // Memory the allocator works on
+    std::unique_ptr<char[]> _memory;
+    Allocator::Slab _slab;
+    std::unique_ptr<Class[]> _classes;
+
+    std::unique_ptr<Index<Item>> _index;
+
+    // Access counter, source of Item#atime
+    uint64_t _clock = 0;
+    // The last version issued
+    uint64_t _cas = 0;
+    std::size_t _bytes = 0;
+    std::chrono::steady_clock::time_point _epoch;
+
+    uint32_t _expire_at(int32_t ttl) const;
+    Item *_find(const std::string &key, std::size_t hash);
+    void _touch(Item *item);
+    void _delete_item(Item *item);
+    uint64_t _tail_atime(unsigned cls) const;
+    int _oldest_class(unsigned except, int keep = -1) const;
+    void *_alloc(unsigned cls, int keep = -1);
+    void _init_item(void *chunk, unsigned cls, const std::string &key, const std::string &value, std::size_t hash,
+                    uint32_t expire);
+    bool _put_item(const std::string &key, const std::string &value, std::size_t hash, uint32_t expire);
+    // Moves item into a chunk of the other class with the new value, item stays as is on failure
+    bool _move_item(Item *item, unsigned cls, const std::string &key, const std::string &value, std::size_t hash);
+    bool _concat(const std::string &key, const std::string &data, bool prepend);
+    CounterResult _count(const std::string &key, uint64_t delta, bool decrement, uint64_t &value);
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SLAB_LRU_H
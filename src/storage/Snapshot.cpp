@@ -0,0 +1,219 @@
+#include "Snapshot.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+const char magic[8] = {'A', 'F', 'S', 'N', 'A', 'P', '0', '1'};
+
+// Key size of the record closing the file
+const uint32_t end_mark = UINT32_MAX;
+
+struct RecordHeader {
+    uint32_t key_size;
+    uint32_t value_size;
+    int64_t expire;
+};
+
+// Buffer is allocated by parent before fork, child only copies records into it
+const std::size_t buffer_size = 1024 * 1024;
+
+bool write_all(int fd, const char *data, std::size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Buffered appends to the file, large pieces bypass the buffer
+class Writer {
+public:
+    Writer(int fd, char *buffer, std::size_t capacity) : _fd(fd), _buffer(buffer), _capacity(capacity), _ok(true) {}
+
+    void append(const void *data, std::size_t size) {
+        if (_size + size > _capacity) {
+            flush();
+        }
+        if (size > _capacity) {
+            _ok = _ok && write_all(_fd, static_cast<const char *>(data), size);
+            return;
+        }
+        std::memcpy(_buffer + _size, data, size);
+        _size += size;
+    }
+
+    bool flush() {
+        _ok = _ok && write_all(_fd, _buffer, _size);
+        _size = 0;
+        return _ok;
+    }
+
+private:
+    int _fd;
+    char *_buffer;
+    std::size_t _capacity;
+    std::size_t _size = 0;
+    bool _ok;
+};
+
+} // namespace
+
+// See Snapshot.h
+bool Snapshot::_write(Afina::Storage &storage, const std::string &path, char *buffer, std::size_t capacity) {
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    Writer writer(fd, buffer, capacity);
+    writer.append(magic, sizeof(magic));
+
+    std::time_t now = std::time(nullptr);
+    bool scanned = storage.Scan([&](const char *key, std::size_t key_size, const char *value, std::size_t value_size,
+                                    int32_t ttl) {
+        RecordHeader header{uint32_t(key_size), uint32_t(value_size), ttl > 0 ? int64_t(now) + ttl : 0};
+        writer.append(&header, sizeof(header));
+        writer.append(key, key_size);
+        writer.append(value, value_size);
+    });
+
+    RecordHeader end{end_mark, 0, 0};
+    writer.append(&end, sizeof(end));
+    bool ok = scanned && writer.flush() && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return ::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// See Snapshot.h
+bool Snapshot::Save(Afina::Storage &storage) {
+    if (_child > 0) {
+        return false;
+    }
+
+    std::unique_ptr<char[]> buffer(new char[buffer_size]);
+    pid_t pid = -1;
+    storage.Freeze([&]() {
+        pid = ::fork();
+        if (pid == 0) {
+            // Only the forking thread exists in the child, so locks held by others are never released there:
+            // child must not take any and leaves without running destructors
+            ::_exit(_write(storage, _path, buffer.get(), buffer_size) ? 0 : 1);
+        }
+    });
+
+    if (pid < 0) {
+        throw std::runtime_error(std::string("Failed to fork snapshot process: ") + std::strerror(errno));
+    }
+    _child = pid;
+    return true;
+}
+
+// See Snapshot.h
+bool Snapshot::Wait() {
+    if (_child <= 0) {
+        return false;
+    }
+
+    int status = 0;
+    pid_t pid;
+    do {
+        pid = ::waitpid(_child, &status, 0);
+    } while (pid < 0 && errno == EINTR);
+    _child = -1;
+    return pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// See Snapshot.h
+std::size_t Snapshot::Load(Afina::Storage &storage) const {
+    int fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        throw std::runtime_error("Failed to open snapshot " + _path + ": " + std::strerror(errno));
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(magic)) {
+        ::close(fd);
+        throw std::runtime_error("Snapshot " + _path + " is corrupted");
+    }
+
+    std::size_t size = st.st_size;
+    void *mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Failed to map snapshot " + _path + ": " + std::strerror(errno));
+    }
+    ::madvise(mapped, size, MADV_SEQUENTIAL);
+
+    const char *data = static_cast<const char *>(mapped);
+    std::size_t pos = sizeof(magic);
+    std::size_t loaded = 0;
+    bool complete = false;
+    std::time_t now = std::time(nullptr);
+    while (std::memcmp(data, magic, sizeof(magic)) == 0 && pos + sizeof(RecordHeader) <= size) {
+        RecordHeader header;
+        std::memcpy(&header, data + pos, sizeof(header));
+        pos += sizeof(header);
+        if (header.key_size == end_mark) {
+            complete = pos == size;
+            break;
+        }
+        if (size - pos < std::size_t(header.key_size) + header.value_size) {
+            break;
+        }
+
+        const char *key = data + pos;
+        const char *value = key + header.key_size;
+        pos += std::size_t(header.key_size) + header.value_size;
+
+        int64_t ttl = 0;
+        if (header.expire != 0) {
+            ttl = header.expire - now;
+            if (ttl <= 0) {
+                continue;
+            }
+            ttl = ttl > INT32_MAX ? INT32_MAX : ttl;
+        }
+        if (storage.Put(std::string(key, header.key_size), std::string(value, header.value_size), int32_t(ttl))) {
+            loaded++;
+        }
+    }
+
+    ::munmap(mapped, size);
+    if (!complete) {
+        throw std::runtime_error("Snapshot " + _path + " is corrupted");
+    }
+    return loaded;
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,69 @@
+#ifndef AFINA_STORAGE_SNAPSHOT_H
+#define AFINA_STORAGE_SNAPSHOT_H
+
+#include <cstddef>
+#include <string>
+
+#include <sys/types.h>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Point in time image of the storage on disk
+ * Save forks the process while storage is frozen, so that child gets copy-on-write image of the storage as
+ * of that moment and writes it to disk at its own pace, while parent unfreezes storage right after fork.
+ * Workers are blocked for the time of fork only, regardless of storage size.
+ *
+ * File is written next to the target one and renamed over it once complete, so the target file is always
+ * either the previous image or the new one. Format is a magic header followed by records:
+ *
+ *   [ key size: u32 | value size: u32 | expiration unix time or 0: i64 | key bytes | value bytes ]
+ *
+ * and a record with key size 0xFFFFFFFF closing the file. Records go in Storage#Scan order, so loading
+ * restores eviction order. Integers are in host byte order: file is meant for restart on the same host
+ */
+class Snapshot {
+public:
+    explicit Snapshot(const std::string &path) : _path(path), _child(-1) {}
+    ~Snapshot() { Wait(); }
+
+    /**
+     * Starts writing image of the storage in background. Returns false if previous save is still in progress,
+     * throws std::runtime_error if process can't be forked. Save of the storage which can't be scanned fails,
+     * see Wait
+     */
+    bool Save(Afina::Storage &storage);
+
+    /**
+     * Waits until save in progress is done. Returns true if image was written successfully, false if it
+     * failed or there was no save in progress
+     */
+    bool Wait();
+
+    /**
+     * Puts associations from the file into storage, expired ones are skipped. File is mapped into memory
+     * and read sequentially. Returns number of associations loaded, 0 if there is no file. Throws
+     * std::runtime_error if file is corrupted
+     */
+    std::size_t Load(Afina::Storage &storage) const;
+
+    const std::string &path() const { return _path; }
+
+private:
+    Snapshot(const Snapshot &);            // = delete;
+    Snapshot &operator=(const Snapshot &); // = delete;
+
+    // Body of the forked child
+    static bool _write(Afina::Storage &storage, const std::string &path, char *buffer, std::size_t capacity);
+
+    const std::string _path;
+    pid_t _child;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SNAPSHOT_H
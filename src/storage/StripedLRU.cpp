@@ -4,46 +4,657 @@
 
 #include "StripedLRU.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <numeric>
+#include <thread>
+#include <utility>
+
 namespace Afina {
 namespace Backend {
 
-StripedLRU::StripedLRU(std::size_t memory_limit, std::size_t stripe_count)
+StripedLRU::StripedLRU(std::size_t stripe_count, std::size_t memory_limit, LockType lock_type, IndexType index_type,
+                       EvictionPolicy policy, Admission admission, Accounting accounting)
+    : _layout(nullptr), _memory_limit(memory_limit),
+      _budget(memory_limit % stripe_count, memory_limit / stripe_count / _chunk_parts), _lock_type(lock_type),
+      _index_type(index_type), _policy(policy), _admission(admission), _accounting(accounting)
 {
-    size_t stripe_size = memory_limit / stripe_count;
-    for (int i = 0; i < stripe_count; i++) {
-        _shards.emplace_back(stripe_size);
+    Layout *layout = new Layout();
+    layout->shards = _make_shards(stripe_count);
+    for (size_t i = 0; i < stripe_count; i++) {
+        // key always lives in the same shard, but versions must differ across shards anyway
+        layout->shards[i]->storage.CasSequence(i, stripe_count);
     }
+    _layout.store(layout);
+}
+
+StripedLRU::~StripedLRU()
+{
+    Stop();
+    _retired.clear([](Layout *layout) { delete layout; });
+    delete _layout.load();
+}
+
+// See StripedLRU.h
+void *StripedLRU::Shard::operator new(std::size_t size)
+{
+    void *p = nullptr;
+    if (posix_memalign(&p, alignof(Shard), size) != 0) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// See StripedLRU.h
+void StripedLRU::Shard::operator delete(void *p)
+{
+    free(p);
 }
 
 // Implements Afina::Storage interface
-bool StripedLRU::Put(const std::string &key, const std::string &value)
+void StripedLRU::Start()
 {
-    return _shards[hash(key) % _shards.size()].Put(key, value);
+    _sweeper.Start(
+        [this]() {
+            bool more = Expire(_expire_budget) > 0;
+            return Rebalance() || more;
+        },
+        std::chrono::seconds(1));
 }
 
 // Implements Afina::Storage interface
-bool StripedLRU::PutIfAbsent(const std::string &key, const std::string &value)
+void StripedLRU::Stop()
+{
+    _sweeper.Stop();
+}
+
+// See StripedLRU.h
+std::size_t StripedLRU::Expire(std::size_t budget)
+{
+    // shard lock is held for one slice only, so workers wait for it no longer than for a regular write
+    Concurrency::Epoch::Guard guard(_readers);
+    const Layout &layout = *_layout.load(std::memory_order_acquire);
+    std::size_t expired = 0;
+    for (auto *shards : {&layout.previous, &layout.shards}) {
+        for (auto &shard : *shards) {
+            std::lock_guard<ShardLock> lock(shard->lock);
+            expired += shard->storage.Expire(budget);
+        }
+    }
+    return expired;
+}
+
+// See StripedLRU.h
+bool StripedLRU::Rebalance()
+{
+    // Shard limits are changed by one thread at a time, resizing goes first
+    std::unique_lock<std::mutex> resize(_resize_lock, std::try_to_lock);
+    if (!resize.owns_lock()) {
+        return false;
+    }
+    const std::size_t chunk = _budget.Chunk();
+    if (_budget.Free() >= chunk) {
+        // nobody has taken the last chunk yet
+        return false;
+    }
+
+    // Layout is replaced under the same lock, so there is no resharding in progress
+    const Layout &layout = *_layout.load(std::memory_order_acquire);
+    const std::size_t floor = _memory_limit / layout.shards.size() / 2;
+
+    // Donor could spare a chunk and has the coldest tail, unused memory is colder than anything. Taker has
+    // no room left and the hottest tail
+    Shard *donor = nullptr;
+    Shard *taker = nullptr;
+    uint32_t donor_age = 0;
+    uint32_t taker_age = 0;
+    for (auto &shard : layout.shards) {
+        std::size_t size, limit;
+        uint32_t age;
+        {
+            std::lock_guard<ShardLock> lock(shard->lock);
+            size = shard->storage.Size();
+            limit = shard->storage.Limit();
+            age = shard->storage.TailAge();
+        }
+
+        bool full = size + chunk > limit;
+        if (!full) {
+            age = std::numeric_limits<uint32_t>::max();
+        }
+        if (limit >= floor + chunk && (donor == nullptr || age > donor_age)) {
+            donor = shard.get();
+            donor_age = age;
+        }
+        if (full && (taker == nullptr || age < taker_age)) {
+            taker = shard.get();
+            taker_age = age;
+        }
+    }
+    if (donor == nullptr || taker == nullptr || donor == taker || donor_age <= 2 * uint64_t(taker_age)) {
+        return false;
+    }
+
+    // Chunk gets into the budget once it is freed, taker borrows it on the next write then
+    {
+        std::lock_guard<ShardLock> lock(donor->lock);
+        donor->storage.SetMaxSize(donor->storage.Limit() - chunk);
+    }
+    for (bool done = false; !done;) {
+        std::lock_guard<ShardLock> lock(donor->lock);
+        done = donor->storage.Shrink(_expire_budget);
+    }
+    _budget.Return(chunk);
+    return true;
+}
+
+// See StripedLRU.h
+std::vector<std::shared_ptr<StripedLRU::Shard>> StripedLRU::_make_shards(std::size_t shard_count)
 {
-    return _shards[hash(key) % _shards.size()].PutIfAbsent(key, value);
+    std::size_t shard_size = _memory_limit / shard_count;
+    std::vector<std::shared_ptr<Shard>> shards;
+    shards.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; i++) {
+        shards.emplace_back(new Shard(shard_size, _lock_type, _index_type, _policy, _admission, _accounting));
+        shards.back()->storage.SetBudget(&_budget);
+    }
+    return shards;
+}
+
+// See StripedLRU.h
+template <typename Apply> void StripedLRU::_route(const std::string &key, bool read, Apply apply)
+{
+    Concurrency::Epoch::Guard guard(_readers);
+    std::size_t key_hash = hash(key);
+    for (;;) {
+        const Layout &layout = *_layout.load(std::memory_order_acquire);
+        Shard &shard = *layout.shards[key_hash % layout.shards.size()];
+        if (!layout.previous.empty()) {
+            // previous shard is locked first as resharding does, so that key is never seen in both or neither
+            Shard &previous = *layout.previous[key_hash % layout.previous.size()];
+            std::lock_guard<ShardLock> from(previous.lock);
+            std::lock_guard<ShardLock> to(shard.lock);
+            if (!shard.retired) {
+                _move(previous, shard, key);
+                apply(shard);
+                return;
+            }
+        } else if (read && shard.storage.SharedReads()) {
+            Concurrency::SharedLockGuard<ShardLock> lock(shard.lock);
+            if (!shard.retired) {
+                apply(shard);
+                return;
+            }
+        } else {
+            std::lock_guard<ShardLock> lock(shard.lock);
+            if (!shard.retired) {
+                apply(shard);
+                return;
+            }
+        }
+        // shard got retired while call waited for its lock, new layout is published by then
+    }
+}
+
+// See StripedLRU.h
+void StripedLRU::_move(Shard &from, Shard &to, const std::string &key)
+{
+    from.storage.Take(key, [&to, &key](const char *, std::size_t, const char *value, std::size_t value_size,
+                                       int32_t ttl) { to.storage.Put(key, std::string(value, value_size), ttl); });
 }
 
 // Implements Afina::Storage interface
-bool StripedLRU::Set(const std::string &key, const std::string &value)
+bool StripedLRU::Put(const std::string &key, const std::string &value, int32_t ttl)
 {
-    return _shards[hash(key) % _shards.size()].Set(key, value);
+    bool result = false;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.Put(key, value, ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool StripedLRU::Put(const std::string &key, std::string &&value, int32_t ttl)
+{
+    bool result = false;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.Put(key, std::move(value), ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool StripedLRU::PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl)
+{
+    bool result = false;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.PutIfAbsent(key, value, ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool StripedLRU::PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl)
+{
+    bool result = false;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.PutIfAbsent(key, std::move(value), ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool StripedLRU::Set(const std::string &key, const std::string &value, int32_t ttl)
+{
+    bool result = false;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.Set(key, value, ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool StripedLRU::Set(const std::string &key, std::string &&value, int32_t ttl)
+{
+    bool result = false;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.Set(key, std::move(value), ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool StripedLRU::Append(const std::string &key, const std::string &data)
+{
+    bool result = false;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.Append(key, data); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool StripedLRU::Prepend(const std::string &key, const std::string &data)
+{
+    bool result = false;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.Prepend(key, data); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+StripedLRU::CounterResult StripedLRU::Incr(const std::string &key, uint64_t delta, uint64_t &value)
+{
+    CounterResult result = CounterResult::NotFound;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.Incr(key, delta, value); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+StripedLRU::CounterResult StripedLRU::Decr(const std::string &key, uint64_t delta, uint64_t &value)
+{
+    CounterResult result = CounterResult::NotFound;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.Decr(key, delta, value); });
+    return result;
 }
 
 // Implements Afina::Storage interface
 bool StripedLRU::Delete(const std::string &key)
 {
-    return _shards[hash(key) % _shards.size()].Delete(key);
+    bool result = false;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.Delete(key); });
+    return result;
 }
 
 // Implements Afina::Storage interface
 bool StripedLRU::Get(const std::string &key, std::string &value)
 {
-    return _shards[hash(key) % _shards.size()].Get(key, value);
+    bool result = false;
+    _route(key, true, [&](Shard &shard) { result = shard.storage.Get(key, value); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+bool StripedLRU::GetPinned(const std::string &key, PinnedValue &value)
+{
+    bool result = false;
+    _route(key, true, [&](Shard &shard) { result = shard.storage.GetPinned(key, value); });
+    return result;
+}
+
+// See StripedLRU.h
+template <typename KeyOf, typename Apply>
+void StripedLRU::_batch(std::size_t count, KeyOf key_of, bool read, Apply apply)
+{
+    Concurrency::Epoch::Guard guard(_readers);
+    const Layout &layout = *_layout.load(std::memory_order_acquire);
+    if (!layout.previous.empty()) {
+        // keys are moved one by one while resharding
+        for (size_t i = 0; i < count; i++) {
+            _route(key_of(i), read, [&apply, i](Shard &shard) { apply(shard, i); });
+        }
+        return;
+    }
+
+    // Counting sort of batch positions by shard keeps order of keys within the shard
+    const std::size_t shard_count = layout.shards.size();
+    std::vector<std::size_t> shard_of(count);
+    std::vector<std::size_t> starts(shard_count + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        shard_of[i] = hash(key_of(i)) % shard_count;
+        starts[shard_of[i] + 1]++;
+    }
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+
+    std::vector<std::size_t> order(count);
+    std::vector<std::size_t> next(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < count; i++) {
+        order[next[shard_of[i]]++] = i;
+    }
+
+    for (size_t s = 0; s < shard_count; s++) {
+        if (starts[s] == starts[s + 1]) {
+            continue;
+        }
+        Shard &shard = *layout.shards[s];
+        bool retired = false;
+        if (read && shard.storage.SharedReads()) {
+            Concurrency::SharedLockGuard<ShardLock> lock(shard.lock);
+            retired = shard.retired;
+            for (size_t j = starts[s]; j < starts[s + 1] && !retired; j++) {
+                apply(shard, order[j]);
+            }
+        } else {
+            std::lock_guard<ShardLock> lock(shard.lock);
+            retired = shard.retired;
+            for (size_t j = starts[s]; j < starts[s + 1] && !retired; j++) {
+                apply(shard, order[j]);
+            }
+        }
+
+        // resharding started meanwhile, the rest of the batch goes key by key
+        for (size_t j = starts[s]; j < starts[s + 1] && retired; j++) {
+            std::size_t i = order[j];
+            _route(key_of(i), read, [&apply, i](Shard &shard) { apply(shard, i); });
+        }
+    }
+}
+
+// See StripedLRU.h
+void StripedLRU::MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                          std::vector<uint64_t> *cas)
+{
+    values.clear();
+    values.resize(keys.size());
+    if (cas != nullptr) {
+        cas->assign(keys.size(), 0);
+    }
+    _batch(keys.size(), [&keys](std::size_t i) -> const std::string & { return keys[i]; }, true,
+           [&keys, &values, cas](Shard &shard, std::size_t i) {
+               if (cas != nullptr) {
+                   shard.storage.GetCas(keys[i], values[i], (*cas)[i]);
+               } else {
+                   shard.storage.GetPinned(keys[i], values[i]);
+               }
+           });
+}
+
+// See StripedLRU.h
+std::size_t StripedLRU::MultiPut(const std::vector<std::pair<std::string, std::string>> &items, int32_t ttl)
+{
+    std::size_t stored = 0;
+    _batch(items.size(), [&items](std::size_t i) -> const std::string & { return items[i].first; }, false,
+           [&items, &stored, ttl](Shard &shard, std::size_t i) {
+               stored += shard.storage.Put(items[i].first, items[i].second, ttl);
+           });
+    return stored;
+}
+
+// See StripedLRU.h
+std::size_t StripedLRU::MultiDelete(const std::vector<std::string> &keys)
+{
+    std::size_t deleted = 0;
+    _batch(keys.size(), [&keys](std::size_t i) -> const std::string & { return keys[i]; }, false,
+           [&keys, &deleted](Shard &shard, std::size_t i) { deleted += shard.storage.Delete(keys[i]); });
+    return deleted;
+}
+
+// Implements Afina::Storage interface
+bool StripedLRU::GetCas(const std::string &key, PinnedValue &value, uint64_t &cas)
+{
+    bool result = false;
+    _route(key, true, [&](Shard &shard) { result = shard.storage.GetCas(key, value, cas); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+StripedLRU::CasResult StripedLRU::CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                                                int32_t ttl)
+{
+    CasResult result = CasResult::NotFound;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.CompareAndSet(key, value, cas, ttl); });
+    return result;
+}
+
+// Implements Afina::Storage interface
+StripedLRU::CasResult StripedLRU::CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl)
+{
+    CasResult result = CasResult::NotFound;
+    _route(key, false, [&](Shard &shard) { result = shard.storage.CompareAndSet(key, std::move(value), cas, ttl); });
+    return result;
+}
+
+// See StripedLRU.h
+void StripedLRU::GetStats(std::vector<std::pair<std::string, std::string>> &stats)
+{
+    Concurrency::Epoch::Guard guard(_readers);
+    const Layout &layout = *_layout.load(std::memory_order_acquire);
+
+    // Shards being drained by resharding count in totals only
+    std::vector<Shard *> all;
+    for (auto *shards : {&layout.previous, &layout.shards}) {
+        for (auto &shard : *shards) {
+            all.push_back(shard.get());
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> shards;
+    std::vector<std::pair<std::string, std::string>> totals;
+    for (size_t i = 0; i < all.size(); i++) {
+        std::vector<std::pair<std::string, std::string>> shard_stats;
+        {
+            std::lock_guard<ShardLock> lock(all[i]->lock);
+            all[i]->storage.GetStats(shard_stats);
+        }
+
+        for (size_t j = 0; j < shard_stats.size(); j++) {
+            if (i == 0) {
+                totals.emplace_back(shard_stats[j].first, "0");
+            }
+            std::size_t total = std::stoull(totals[j].second) + std::stoull(shard_stats[j].second);
+            totals[j].second = std::to_string(total);
+            if (i >= layout.previous.size()) {
+                shards.emplace_back(std::to_string(i - layout.previous.size()) + ":" + shard_stats[j].first,
+                                    shard_stats[j].second);
+            }
+        }
+    }
+
+    // memory no shard holds is a part of the limit as well
+    for (auto &total : totals) {
+        if (total.first == "limit_maxbytes") {
+            total.second = std::to_string(std::stoull(total.second) + _budget.Free());
+        }
+    }
+
+    stats.insert(stats.end(), totals.begin(), totals.end());
+    stats.insert(stats.end(), shards.begin(), shards.end());
+}
+
+// See StripedLRU.h
+bool StripedLRU::Scan(const Visitor &visitor)
+{
+    // Keys left in previous shards are older than ones moved already
+    const Layout &layout = *_layout.load(std::memory_order_acquire);
+    for (auto *shards : {&layout.previous, &layout.shards}) {
+        for (auto &shard : *shards) {
+            shard->storage.Scan(visitor);
+        }
+    }
+    return true;
+}
+
+// See StripedLRU.h
+void StripedLRU::Freeze(const std::function<void()> &action)
+{
+    // Locks are taken in the same order by everyone, previous shards first, so freezes don't deadlock each
+    // other, resharding and calls
+    Concurrency::Epoch::Guard guard(_readers);
+    std::vector<Shard *> locked;
+    for (;;) {
+        const Layout &layout = *_layout.load(std::memory_order_acquire);
+        locked.clear();
+        for (auto *shards : {&layout.previous, &layout.shards}) {
+            for (auto &shard : *shards) {
+                locked.push_back(shard.get());
+                shard->lock.lock();
+            }
+        }
+        if (!layout.shards.front()->retired) {
+            break;
+        }
+        for (Shard *shard : locked) {
+            shard->lock.unlock();
+        }
+    }
+
+    try {
+        action();
+    } catch (...) {
+        for (Shard *shard : locked) {
+            shard->lock.unlock();
+        }
+        throw;
+    }
+    for (Shard *shard : locked) {
+        shard->lock.unlock();
+    }
+}
+
+// See StripedLRU.h
+bool StripedLRU::Resize(std::size_t memory_limit)
+{
+    // Layout is replaced under the same lock only
+    std::lock_guard<std::mutex> resize(_resize_lock);
+    const Layout &layout = *_layout.load(std::memory_order_acquire);
+    const std::size_t shard_count = layout.shards.size();
+    if (memory_limit / shard_count < _min_shard_size) {
+        return false;
+    }
+    if (memory_limit >= _memory_limit) {
+        _budget.Return(memory_limit - _memory_limit);
+        _memory_limit = memory_limit;
+        return true;
+    }
+
+    // Once budget is exhausted nobody borrows, so shard limits stay as they are read
+    std::size_t cut = _memory_limit - memory_limit;
+    cut -= _budget.Take(cut);
+    _memory_limit = memory_limit;
+    if (cut == 0) {
+        return true;
+    }
+
+    std::vector<std::size_t> limits;
+    std::size_t held = 0;
+    for (auto &shard : layout.shards) {
+        std::lock_guard<ShardLock> lock(shard->lock);
+        limits.push_back(shard->storage.Limit());
+        held += limits.back();
+    }
+    for (size_t i = 0; i < shard_count; i++) {
+        // the last shard takes rounding error
+        std::size_t part = cut;
+        if (i + 1 < shard_count) {
+            part = static_cast<std::size_t>(static_cast<double>(cut) * limits[i] / held);
+        }
+        part = std::min(part, limits[i]);
+        cut -= part;
+        held -= limits[i];
+
+        std::lock_guard<ShardLock> lock(layout.shards[i]->lock);
+        layout.shards[i]->storage.SetMaxSize(limits[i] - part);
+    }
+    for (auto &shard : layout.shards) {
+        for (bool done = false; !done;) {
+            std::lock_guard<ShardLock> lock(shard->lock);
+            done = shard->storage.Shrink(_expire_budget);
+        }
+    }
+    return true;
+}
+
+// See StripedLRU.h
+bool StripedLRU::Reshard(std::size_t shard_count)
+{
+    std::lock_guard<std::mutex> resize(_resize_lock);
+    const Layout &current = *_layout.load(std::memory_order_acquire);
+    if (shard_count == 0 || _memory_limit / shard_count < _min_shard_size) {
+        return false;
+    }
+    if (shard_count == current.shards.size()) {
+        return true;
+    }
+
+    Layout *next = new Layout();
+    next->shards = _make_shards(shard_count);
+    next->previous = current.shards;
+
+    // Shards are retired with all their locks held, so that none of them issues versions afterwards and
+    // new shards start above the last one
+    uint64_t last = 0;
+    for (auto &shard : next->previous) {
+        shard->lock.lock();
+        shard->retired = true;
+        last = std::max(last, shard->storage.LastCas());
+    }
+    for (size_t i = 0; i < shard_count; i++) {
+        next->shards[i]->storage.CasSequence(last - last % shard_count + shard_count + i, shard_count);
+    }
+    // previous shards borrow no more, memory they keep is over the limit until they are drained
+    _budget.Reset(_memory_limit % shard_count);
+    _replace(next);
+    for (auto &shard : next->previous) {
+        shard->lock.unlock();
+    }
+
+    // Calls move keys they touch, the rest is moved oldest first by batches
+    for (auto &from : next->previous) {
+        for (std::size_t taken = _reshard_batch; taken == _reshard_batch;) {
+            std::lock_guard<ShardLock> lock(from->lock);
+            taken = from->storage.TakeOldest(_reshard_batch, [this, next](const char *key, std::size_t key_size,
+                                                                          const char *value, std::size_t value_size,
+                                                                          int32_t ttl) {
+                std::string name(key, key_size);
+                Shard &to = *next->shards[hash(name) % next->shards.size()];
+                std::lock_guard<ShardLock> guard(to.lock);
+                to.storage.Put(name, std::string(value, value_size), ttl);
+            });
+        }
+    }
+
+    Layout *done = new Layout();
+    done->shards = next->shards;
+    _replace(done);
+    _reclaim();
+    return true;
+}
+
+// See StripedLRU.h
+void StripedLRU::_replace(Layout *layout)
+{
+    Layout *replaced = _layout.exchange(layout, std::memory_order_acq_rel);
+    _retired.retire(replaced, _readers.current());
+}
+
+// See StripedLRU.h
+void StripedLRU::_reclaim()
+{
+    // Calls are short, so readers of replaced layouts are gone soon
+    while (_retired.size() > 0) {
+        _retired.reclaim(_readers.advance(), [](Layout *layout) { delete layout; });
+        if (_retired.size() > 0) {
+            std::this_thread::yield();
+        }
+    }
 }
 
 } // namespace Backend
-} // namespace Afina
\ No newline at end of file
+} // namespace Afina
@@ -5,47 +5,126 @@
 #ifndef AFINA_STRIPEDLRU_H
 #define AFINA_STRIPEDLRU_H
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <functional>
+#include <stdexcept>
 #include <vector>
 
 #include <afina/Storage.h>
+#include <afina/concurrency/Epoch.h>
 
+#include "MemoryBudget.h"
+#include "ShardLock.h"
 #include "SimpleLRU.h"
+#include "Sweeper.h"
 
 
 
 namespace Afina {
 namespace Backend {
 
+/**
+ * # Striped LRU
+ * Keys are spread over independent SimpleLRU shards by hash, each shard has its own lock. Thread safe.
+ * If shard reads are write-free (Clock policy) they are done under shared lock. Once started, expired nodes
+ * are reclaimed in background shard by shard
+ *
+ * Shards start with equal parts of memory limit, but the limit is global: memory taken from one shard goes
+ * to the shared budget and any shard borrows from it by chunks once it runs out of own memory. Background
+ * rebalancing takes chunks from shards whose least recently used data is the coldest while other shards
+ * evict much hotter data, so that eviction follows the globally coldest data with skewed keys too
+ *
+ * Memory limit and number of shards could be changed on the fly. While resharding, keys move from previous
+ * shards to new ones in small batches, and calls move the key they touch first, so that it is never in
+ * both shards or neither. Memory taken may exceed the limit by the part not moved yet. Calls reach shards
+ * through layout pointer guarded by Concurrency::Epoch, layout replaced is freed once no call could use it
+ */
 class StripedLRU : public Afina::Storage {
 public:
 
-    static std::unique_ptr<StripedLRU> create_cache(std::size_t stripe_count, std::size_t memory_limit)
+    /**
+     * Creates cache of stripe_count shards sharing memory_limit bytes equally
+     *
+     * @param stripe_count number of shards
+     * @param memory_limit total number of bytes for keys and values of all shards
+     * @param lock_type kind of lock for each shard
+     * @param index_type kind of key index for each shard
+     * @param policy eviction policy of each shard
+     * @param admission admission policy of each shard
+     * @param accounting memory accounting of each shard
+     */
+    static std::unique_ptr<StripedLRU> create_cache(std::size_t stripe_count, std::size_t memory_limit,
+                                                    LockType lock_type = LockType::Mutex,
+                                                    IndexType index_type = IndexType::Map,
+                                                    EvictionPolicy policy = EvictionPolicy::LRU,
+                                                    Admission admission = Admission::All,
+                                                    Accounting accounting = Accounting::Payload)
     {
-        constexpr size_t min_memory_size = 1u * 1024 * 1024;
-        if (memory_limit / stripe_count < min_memory_size || memory_limit % stripe_count != 0) {
+        if (stripe_count == 0) {
+            throw std::runtime_error("Invalid stripe count");
+        }
+        if (memory_limit / stripe_count < _min_shard_size) {
             throw std::runtime_error("Invalid memory limit");
         }
-        // return std::move(new StripedLRU(stripe_count, memory_limit));
-        return std::move(std::unique_ptr<StripedLRU>(new StripedLRU(stripe_count, memory_limit)));
+        return std::unique_ptr<StripedLRU>(new StripedLRU(stripe_count, memory_limit, lock_type, index_type, policy,
+                                                          admission, accounting));
     }
 
     // StripedLRU(StripedLRU &&) = default;
 
-    ~StripedLRU() { }
+    ~StripedLRU();
 
     // Implements Afina::Storage interface
-    bool Put(const std::string &key, const std::string &value) override;
+    void Start() override;
 
     // Implements Afina::Storage interface
-    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+    void Stop() override;
+
+    /**
+     * Reclaims expired nodes of all shards, see SimpleLRU#Expire. Budget is per shard
+     */
+    std::size_t Expire(std::size_t budget);
+
+    /**
+     * Moves one chunk of memory into the shared budget if some shard has no room left while another one
+     * has unused memory or its tail is more than twice older. Shard never gives away more than half of its
+     * equal part. Returns true if chunk was moved, false if there is nothing to do or resizing is running
+     */
+    bool Rebalance();
 
     // Implements Afina::Storage interface
-    bool Set(const std::string &key, const std::string &value) override;
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface, value is moved into the shard
+    bool Put(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface, value is moved into the shard
+    bool PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface, value is moved into the shard
+    bool Set(const std::string &key, std::string &&value, int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override;
+
+    // Implements Afina::Storage interface
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override;
 
     // Implements Afina::Storage interface
     bool Delete(const std::string &key) override;
@@ -53,13 +132,132 @@ public:
     // Implements Afina::Storage interface
     bool Get(const std::string &key, std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool GetPinned(const std::string &key, PinnedValue &value) override;
+
+    // Implements Afina::Storage interface
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override;
+
+    // Implements Afina::Storage interface, value is moved into the shard
+    CasResult CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl = 0) override;
+
+    /**
+     * Groups keys by shard and takes lock of each shard once per batch. Shards are visited in order of
+     * their numbers, keys of the same shard keep their order
+     */
+    void MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                  std::vector<uint64_t> *cas = nullptr) override;
+
+    // Groups keys by shard, see MultiGet
+    std::size_t MultiPut(const std::vector<std::pair<std::string, std::string>> &items,
+                         int32_t ttl = 0) override;
+
+    // Groups keys by shard, see MultiGet
+    std::size_t MultiDelete(const std::vector<std::string> &keys) override;
+
+    /**
+     * Reports totals of all shards, see SimpleLRU#GetStats, followed by statistics of each shard
+     * prefixed by its number, i.e "0:bytes"
+     */
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override;
+
+    /**
+     * Scans shards one after another, see SimpleLRU#Scan. Keys of a shard get into the same shard on load
+     * as long as number of shards is the same, so eviction order of each shard is restored
+     */
+    bool Scan(const Visitor &visitor) override;
+
+    /**
+     * Calls action with locks of all shards held, both previous and new ones while resharding
+     */
+    void Freeze(const std::function<void()> &action) override;
+
+    /**
+     * Growth goes to the shared budget. Shrink takes budget first, the rest is taken from shards in
+     * proportion to their limits, each one shrinks by slices under its lock. Fails if shards would get less
+     * than 1MB each on average, as create_cache does
+     */
+    bool Resize(std::size_t memory_limit) override;
+
+    /**
+     * Creates new shards and moves keys into them by batches under locks of both shards, then drops
+     * previous ones. Versions issued by new shards are greater than any issued by previous ones, so that
+     * pending CompareAndSet never succeeds by mistake. New shards start with equal parts of the limit
+     * again. Fails if shards would get less than 1MB each
+     */
+    bool Reshard(std::size_t shard_count) override;
+
 private:
+    // Each shard with its lock takes own cache lines, so that threads working with neighbour shards don't
+    // invalidate each other's caches
+    struct alignas(64) Shard {
+        ShardLock lock;
+        SimpleLRU storage;
+
+        // Set under the lock once shard is replaced by resharding, call locked such shard loads layout again
+        bool retired;
+
+        Shard(std::size_t max_size, LockType lock_type, IndexType index_type, EvictionPolicy policy,
+              Admission admission, Accounting accounting)
+            : lock(lock_type), storage(max_size, index_type, policy, admission, accounting), retired(false) {}
+
+        // Plain new doesn't respect alignment above alignof(std::max_align_t) until C++17
+        static void *operator new(std::size_t size);
+        static void operator delete(void *p);
+    };
+
+    // Shards keys are spread over. While resharding previous ones keep keys not moved yet, otherwise
+    // previous is empty. Layout is immutable, resharding replaces it
+    struct Layout {
+        std::vector<std::shared_ptr<Shard>> shards;
+        std::vector<std::shared_ptr<Shard>> previous;
+    };
 
-    std::vector<SimpleLRU> _shards;
+    std::atomic<Layout *> _layout;
+    Concurrency::Epoch _readers;
     std::hash<std::string> hash;
 
-    StripedLRU(std::size_t memory_limit, std::size_t stripe_count);
+    // Resize and Reshard run one at a time, settings new shards are made with are guarded by the same lock
+    std::mutex _resize_lock;
+    Concurrency::Limbo<Layout> _retired;
+    std::size_t _memory_limit;
+    MemoryBudget _budget;
+    LockType _lock_type;
+    IndexType _index_type;
+    EvictionPolicy _policy;
+    Admission _admission;
+    Accounting _accounting;
+
+    // Number of keys moved under one lock of previous shard while resharding
+    static constexpr std::size_t _reshard_batch = 64;
+    static constexpr std::size_t _min_shard_size = 1u * 1024 * 1024;
+    // Budget chunk is this part of equal shard part the cache is created with
+    static constexpr std::size_t _chunk_parts = 64;
+
+    // Work budget of one background expiration slice of a shard
+    static constexpr std::size_t _expire_budget = 256;
+    Sweeper _sweeper;
+
+    StripedLRU(std::size_t stripe_count, std::size_t memory_limit, LockType lock_type, IndexType index_type,
+               EvictionPolicy policy, Admission admission, Accounting accounting);
+
+    std::vector<std::shared_ptr<Shard>> _make_shards(std::size_t shard_count);
+    void _replace(Layout *layout);
+    void _reclaim();
+    static void _move(Shard &from, Shard &to, const std::string &key);
+
+    // Calls apply(shard) with the shard of the key locked. Reads take shared lock if shard reads are
+    // write-free and there is no resharding in progress, then key is moved from its previous shard first
+    template <typename Apply> void _route(const std::string &key, bool read, Apply apply);
 
+    // Calls apply(shard, i) for each i < count with each shard lock taken once, key_of(i) is the key
+    // of i-th element of the batch
+    template <typename KeyOf, typename Apply>
+    void _batch(std::size_t count, KeyOf key_of, bool read, Apply apply);
 };
 
 } // namespace Backend
@@ -0,0 +1,76 @@
+#ifndef AFINA_STORAGE_SWEEPER_H
+#define AFINA_STORAGE_SWEEPER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Background storage maintenance
+ * Thread calling given slice of work periodically. Slice must be short and take locks by itself, so that
+ * workers never wait for the sweeper for long. Slice returns true if there is more work to do, then it gets
+ * called again right away
+ */
+class Sweeper {
+public:
+    Sweeper() : _running(false) {}
+    ~Sweeper() { Stop(); }
+
+    /**
+     * Starts thread calling slice once per period until Stop
+     */
+    void Start(std::function<bool()> slice, std::chrono::milliseconds period) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_running) {
+            return;
+        }
+        _running = true;
+        _thread = std::thread(&Sweeper::_loop, this, std::move(slice), period);
+    }
+
+    /**
+     * Stops thread and waits until it is done, slice in progress is completed
+     */
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running = false;
+        }
+        _stop_condition.notify_all();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+private:
+    Sweeper(const Sweeper &);            // = delete;
+    Sweeper &operator=(const Sweeper &); // = delete;
+
+    void _loop(std::function<bool()> slice, std::chrono::milliseconds period) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_running) {
+            lock.unlock();
+            bool more = slice();
+            lock.lock();
+
+            if (!more) {
+                _stop_condition.wait_for(lock, period, [this] { return !_running; });
+            }
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _stop_condition;
+    bool _running;
+    std::thread _thread;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SWEEPER_H
@@ -4,54 +4,234 @@
 #include <map>
 #include <mutex>
 #include <string>
+#include <utility>
 
+#include "ShardLock.h"
 #include "SimpleLRU.h"
+#include "Sweeper.h"
 
 namespace Afina {
 namespace Backend {
 
 /**
  * # SimpleLRU thread safe version
- *
- *
+ * All operations are serialized by a global lock. With Clock policy and RW lock reads run in parallel.
+ * Once started, expired nodes are reclaimed in background by short slices under the same lock
  */
 class ThreadSafeSimplLRU : public SimpleLRU {
 public:
-    ThreadSafeSimplLRU(size_t max_size = 1024) : SimpleLRU(max_size) {}
+    ThreadSafeSimplLRU(size_t max_size = 1024, IndexType index_type = IndexType::Map,
+                       EvictionPolicy policy = EvictionPolicy::LRU, LockType lock_type = LockType::Mutex,
+                       Admission admission = Admission::All, Accounting accounting = Accounting::Payload)
+        : SimpleLRU(max_size, index_type, policy, admission, accounting), m(lock_type) {}
     ~ThreadSafeSimplLRU() {}
 
+    // Implements Afina::Storage interface
+    void Start() override {
+        _sweeper.Start([this]() { return Expire(_expire_budget) > 0; }, std::chrono::seconds(1));
+    }
+
+    // Implements Afina::Storage interface
+    void Stop() override { _sweeper.Stop(); }
+
+    // see SimpleLRU.h
+    std::size_t Expire(std::size_t budget) {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::Expire(budget);
+    }
+
+    // see SimpleLRU.h
+    bool Put(const std::string &key, const std::string &value, int32_t ttl = 0) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::Put(key, value, ttl);
+    }
+
+    // see SimpleLRU.h
+    bool Put(const std::string &key, std::string &&value, int32_t ttl = 0) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::Put(key, std::move(value), ttl);
+    }
+
+    // see SimpleLRU.h
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl = 0) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::PutIfAbsent(key, value, ttl);
+    }
+
+    // see SimpleLRU.h
+    bool PutIfAbsent(const std::string &key, std::string &&value, int32_t ttl = 0) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::PutIfAbsent(key, std::move(value), ttl);
+    }
+
+    // see SimpleLRU.h
+    bool Set(const std::string &key, const std::string &value, int32_t ttl = 0) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::Set(key, value, ttl);
+    }
+
     // see SimpleLRU.h
-    bool Put(const std::string &key, const std::string &value) override {
-        std::lock_guard<std::mutex> guard(m);
-        return SimpleLRU::Put(key, value);
+    bool Set(const std::string &key, std::string &&value, int32_t ttl = 0) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::Set(key, std::move(value), ttl);
     }
 
     // see SimpleLRU.h
-    bool PutIfAbsent(const std::string &key, const std::string &value) override {
-        std::lock_guard<std::mutex> guard(m);
-        return SimpleLRU::PutIfAbsent(key, value);
+    bool Append(const std::string &key, const std::string &data) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::Append(key, data);
     }
 
     // see SimpleLRU.h
-    bool Set(const std::string &key, const std::string &value) override {
-        std::lock_guard<std::mutex> guard(m);
-        return SimpleLRU::Set(key, value);
+    bool Prepend(const std::string &key, const std::string &data) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::Prepend(key, data);
+    }
+
+    // see SimpleLRU.h
+    CounterResult Incr(const std::string &key, uint64_t delta, uint64_t &value) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::Incr(key, delta, value);
+    }
+
+    // see SimpleLRU.h
+    CounterResult Decr(const std::string &key, uint64_t delta, uint64_t &value) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::Decr(key, delta, value);
     }
 
     // see SimpleLRU.h
     bool Delete(const std::string &key) override {
-        std::lock_guard<std::mutex> guard(m);
+        std::lock_guard<ShardLock> guard(m);
         return SimpleLRU::Delete(key);
     }
 
     // see SimpleLRU.h
     bool Get(const std::string &key, std::string &value) override {
-        std::lock_guard<std::mutex> guard(m);
+        if (SharedReads()) {
+            Concurrency::SharedLockGuard<ShardLock> guard(m);
+            return SimpleLRU::Get(key, value);
+        }
+        std::lock_guard<ShardLock> guard(m);
         return SimpleLRU::Get(key, value);
     }
 
+    // see SimpleLRU.h
+    bool GetPinned(const std::string &key, PinnedValue &value) override {
+        if (SharedReads()) {
+            Concurrency::SharedLockGuard<ShardLock> guard(m);
+            return SimpleLRU::GetPinned(key, value);
+        }
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::GetPinned(key, value);
+    }
+
+    // see SimpleLRU.h
+    bool GetCas(const std::string &key, PinnedValue &value, uint64_t &cas) override {
+        if (SharedReads()) {
+            Concurrency::SharedLockGuard<ShardLock> guard(m);
+            return SimpleLRU::GetCas(key, value, cas);
+        }
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::GetCas(key, value, cas);
+    }
+
+    // see SimpleLRU.h
+    CasResult CompareAndSet(const std::string &key, const std::string &value, uint64_t cas,
+                            int32_t ttl = 0) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::CompareAndSet(key, value, cas, ttl);
+    }
+
+    // see SimpleLRU.h
+    CasResult CompareAndSet(const std::string &key, std::string &&value, uint64_t cas, int32_t ttl = 0) override {
+        std::lock_guard<ShardLock> guard(m);
+        return SimpleLRU::CompareAndSet(key, std::move(value), cas, ttl);
+    }
+
+    // Implements Afina::Storage interface, lock is taken once per batch
+    void MultiGet(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                  std::vector<uint64_t> *cas = nullptr) override {
+        if (SharedReads()) {
+            Concurrency::SharedLockGuard<ShardLock> guard(m);
+            _multi_get(keys, values, cas);
+            return;
+        }
+        std::lock_guard<ShardLock> guard(m);
+        _multi_get(keys, values, cas);
+    }
+
+    // Implements Afina::Storage interface, lock is taken once per batch
+    std::size_t MultiPut(const std::vector<std::pair<std::string, std::string>> &items,
+                         int32_t ttl = 0) override {
+        std::size_t stored = 0;
+        std::lock_guard<ShardLock> guard(m);
+        for (auto &item : items) {
+            stored += SimpleLRU::Put(item.first, item.second, ttl);
+        }
+        return stored;
+    }
+
+    // Implements Afina::Storage interface, lock is taken once per batch
+    std::size_t MultiDelete(const std::vector<std::string> &keys) override {
+        std::size_t deleted = 0;
+        std::lock_guard<ShardLock> guard(m);
+        for (auto &key : keys) {
+            deleted += SimpleLRU::Delete(key);
+        }
+        return deleted;
+    }
+
+    /**
+     * Lock is taken once per eviction slice, so that other calls are served while storage shrinks
+     */
+    bool Resize(std::size_t memory_limit) override {
+        {
+            std::lock_guard<ShardLock> guard(m);
+            SimpleLRU::SetMaxSize(memory_limit);
+        }
+        for (bool done = false; !done;) {
+            std::lock_guard<ShardLock> guard(m);
+            done = SimpleLRU::Shrink(_expire_budget);
+        }
+        return true;
+    }
+
+    // see SimpleLRU.h
+    void GetStats(std::vector<std::pair<std::string, std::string>> &stats) override {
+        std::lock_guard<ShardLock> guard(m);
+        SimpleLRU::GetStats(stats);
+    }
+
+    // Implements Afina::Storage interface
+    void Freeze(const std::function<void()> &action) override {
+        std::lock_guard<ShardLock> guard(m);
+        action();
+    }
+
 private:
-    std::mutex m;
+    // Reads values under the lock held by caller
+    void _multi_get(const std::vector<std::string> &keys, std::vector<PinnedValue> &values,
+                    std::vector<uint64_t> *cas) {
+        values.clear();
+        values.resize(keys.size());
+        if (cas != nullptr) {
+            cas->assign(keys.size(), 0);
+        }
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            if (cas != nullptr) {
+                SimpleLRU::GetCas(keys[i], values[i], (*cas)[i]);
+            } else {
+                SimpleLRU::GetPinned(keys[i], values[i]);
+            }
+        }
+    }
+
+    // Work budget of one background expiration slice
+    static constexpr std::size_t _expire_budget = 256;
+
+    ShardLock m;
+    Sweeper _sweeper;
 };
 
 } // namespace Backend
@@ -0,0 +1,163 @@
+#ifndef AFINA_STORAGE_TIMER_WHEEL_H
+#define AFINA_STORAGE_TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Node.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Hierarchical timing wheel of node expiration
+ * Four levels of 64 slots each, slot of level L covers 64^L seconds, so wheel spans 64^4 seconds (about
+ * 194 days), nodes expiring later get rescheduled from time to time. Nodes are linked into slots by their
+ * TimerLink, schedule and cancel are O(1).
+ *
+ * Wheel time moves forward by advance: each second of level 0 is a slot of nodes expiring at that
+ * second, once lower level turns around next slot of upper level is cascaded down. Work done by advance,
+ * cascades included, is bounded by a budget, so that expiration never blocks the caller for long: wheel just
+ * lags behind and catches up on next calls. Expired nodes which are still in the wheel must be checked by the owner, see
+ * Node#expired.
+ *
+ * Wheel doesn't own nodes
+ */
+class TimerWheel {
+public:
+    explicit TimerWheel(uint32_t now = 0) : _now(now), _size(0), _cascade_level(_levels - 1) {}
+
+    /**
+     * Puts node into the slot of its expiration time, node must not be in the wheel. Nodes without
+     * expiration time are ignored
+     */
+    void schedule(Node *node) {
+        if (node->expire != 0) {
+            _place(node, _now + 1);
+            _size++;
+        }
+    }
+
+    /**
+     * Removes node from the wheel, if it is there
+     */
+    void cancel(Node *node) {
+        if (!node->timer_empty()) {
+            node->timer_unlink();
+            _size--;
+        }
+    }
+
+    /**
+     * Moves wheel time towards now and passes nodes expired on the way into callback, one by one. Node is
+     * out of the wheel once passed. Stops after budget units of work, each node passed or cascaded and each
+     * second passed is a unit, so cascade of a crowded upper slot is spread over several calls.
+     *
+     * Returns number of nodes passed into callback
+     */
+    template <typename Callback> std::size_t advance(uint32_t now, std::size_t budget, Callback callback) {
+        // nothing to do on the way
+        if (_size == 0 && _now < now) {
+            _now = now;
+            _cascade_level = _levels - 1;
+        }
+
+        std::size_t expired = 0;
+        while (_now < now && budget > 0) {
+            uint32_t tick = _now + 1;
+
+            // Slot of the tick is complete once all upper levels got cascaded into lower ones, top down. Call
+            // out of budget stops in the middle and the next one resumes from the same level
+            for (; _cascade_level > 0; _cascade_level--) {
+                if ((tick & ((uint32_t(1) << (_bits * _cascade_level)) - 1)) == 0 &&
+                    !_cascade(_slots[_cascade_level][(tick >> (_bits * _cascade_level)) & _mask], tick, budget)) {
+                    return expired;
+                }
+            }
+
+            TimerLink &slot = _slots[0][tick & _mask];
+            while (!slot.timer_empty() && budget > 0) {
+                Node *node = static_cast<Node *>(slot.timer_next);
+                node->timer_unlink();
+                _size--;
+                callback(node);
+                expired++;
+                budget--;
+            }
+
+            if (slot.timer_empty()) {
+                _now = tick;
+                _cascade_level = _levels - 1;
+                budget = budget > 0 ? budget - 1 : 0;
+            }
+        }
+        return expired;
+    }
+
+    // Wheel time: all nodes expiring at this second or earlier were passed to callback already
+    uint32_t now() const { return _now; }
+
+    // Number of nodes in the wheel
+    std::size_t size() const { return _size; }
+
+private:
+    static constexpr unsigned _levels = 4;
+    static constexpr unsigned _bits = 6;
+    static constexpr uint32_t _mask = (1u << _bits) - 1;
+
+    /**
+     * Links node into the slot, which gets processed or cascaded at the first tick not earlier than node
+     * expiration. Base is the first tick which isn't processed yet.
+     *
+     * Node goes to the lowest level having expiration and base in the same slot of the level above, so
+     * slot is reached without wrapping around. Late nodes go to the base slot, far ones are parked at the
+     * top level and rescheduled once cascaded
+     */
+    void _place(Node *node, uint32_t base) {
+        uint32_t expire = node->expire > base ? node->expire : base;
+
+        unsigned level = 0;
+        while (level < _levels && (expire >> (_bits * (level + 1))) != (base >> (_bits * (level + 1)))) {
+            level++;
+        }
+
+        uint32_t slot;
+        if (level == _levels) {
+            level = _levels - 1;
+            slot = (base >> (_bits * level)) + 1;
+        } else {
+            slot = expire >> (_bits * level);
+        }
+        node->timer_link_after(&_slots[level][slot & _mask]);
+    }
+
+    /**
+     * Moves nodes of the upper level slot down relative to the given tick, one unit of budget each. Nodes
+     * never get back into the same slot, neither do nodes scheduled meanwhile. Returns false if budget is
+     * over before the slot is empty
+     */
+    bool _cascade(TimerLink &slot, uint32_t tick, std::size_t &budget) {
+        while (!slot.timer_empty()) {
+            if (budget == 0) {
+                return false;
+            }
+            Node *node = static_cast<Node *>(slot.timer_next);
+            node->timer_unlink();
+            _place(node, tick);
+            budget--;
+        }
+        return true;
+    }
+
+    uint32_t _now;
+    // number of nodes in the wheel
+    std::size_t _size;
+    // upper level to be cascaded next for tick _now + 1, 0 once all of them are
+    unsigned _cascade_level;
+    TimerLink _slots[_levels][1u << _bits];
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TIMER_WHEEL_H
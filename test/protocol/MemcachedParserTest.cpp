@@ -4,7 +4,11 @@
 #include <string>
 
 #include <afina/execute/Add.h>
+#include <afina/execute/Cas.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Prepend.h>
+#include <afina/execute/Resize.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
 
@@ -58,6 +62,28 @@ TEST(MemcachedParserTest, SimpleAdd) {
     ASSERT_EQ(-1, tmp->expire());
 }
 
+// Verify multi digit expiration time
+TEST(MemcachedParserTest, SetExpire) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("set foo 0 3600 6\r\nfooval\r\n", consumed));
+
+    size_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+
+    Execute::Set *tmp = reinterpret_cast<Execute::Set *>(cmd.get());
+    ASSERT_EQ(3600, tmp->expire());
+    ASSERT_EQ(3600, tmp->ttl());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("set foo 0 -25 6\r\nfooval\r\n", consumed));
+    cmd = parser.Build(value_size);
+    tmp = reinterpret_cast<Execute::Set *>(cmd.get());
+    ASSERT_EQ(-25, tmp->expire());
+}
+
 // Verify simple get command passed in a single string
 TEST(MemcachedParserTest, SimpleGet) {
     Protocol::Parser parser;
@@ -98,3 +124,130 @@ TEST(MemcachedParserTest, Stats) {
     Execute::Stats *tmp = reinterpret_cast<Execute::Stats *>(cmd.get());
     ASSERT_FALSE(tmp == nullptr);
 }
+
+// Verify gets command asks for versions
+TEST(MemcachedParserTest, Gets) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("gets ke key2\r\n", consumed));
+    ASSERT_EQ("gets", parser.Name());
+
+    size_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+
+    Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd.get());
+    ASSERT_TRUE(tmp->with_cas());
+    ASSERT_EQ(2, tmp->keys().size());
+}
+
+// Verify cas command carries version after the value size
+TEST(MemcachedParserTest, Cas) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("cas foo 5 0 6 18446744073709551615\r\nfooval\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(36, consumed);
+    ASSERT_EQ("cas", parser.Name());
+
+    size_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(6, value_size);
+
+    Execute::Cas *tmp = reinterpret_cast<Execute::Cas *>(cmd.get());
+    ASSERT_EQ("foo", tmp->key());
+    ASSERT_EQ(5, tmp->flags());
+    ASSERT_EQ(UINT64_MAX, tmp->cas());
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("cas foo 5 0 6 18446744073709551616\r\n", consumed), std::runtime_error);
+}
+
+// Verify prepend command gets built
+TEST(MemcachedParserTest, Prepend) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("prepend foo 0 0 3\r\npre\r\n", consumed));
+    ASSERT_EQ("prepend", parser.Name());
+
+    size_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(3, value_size);
+
+    Execute::Prepend *tmp = dynamic_cast<Execute::Prepend *>(cmd.get());
+    ASSERT_FALSE(tmp == nullptr);
+    ASSERT_EQ("foo", tmp->key());
+}
+
+// Verify incr and decr commands have no data block
+TEST(MemcachedParserTest, IncrDecr) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("incr foo 18446744073709551615\r\ndecr", consumed));
+    ASSERT_EQ(31, consumed);
+    ASSERT_EQ("incr", parser.Name());
+
+    size_t value_size = 1;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+
+    Execute::Incr *tmp = dynamic_cast<Execute::Incr *>(cmd.get());
+    ASSERT_FALSE(tmp == nullptr);
+    ASSERT_EQ("foo", tmp->key());
+    ASSERT_EQ(UINT64_MAX, tmp->delta());
+    ASSERT_FALSE(tmp->decrement());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("decr bar 5\r\n", consumed));
+    cmd = parser.Build(value_size);
+    tmp = dynamic_cast<Execute::Incr *>(cmd.get());
+    ASSERT_FALSE(tmp == nullptr);
+    ASSERT_EQ("bar", tmp->key());
+    ASSERT_EQ(5, tmp->delta());
+    ASSERT_TRUE(tmp->decrement());
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("incr foo 18446744073709551616\r\n", consumed), std::runtime_error);
+
+    // Delta must be a non empty decimal number
+    for (const char *command : {"incr foo abc\r\n", "incr foo 1x2\r\n", "decr foo -5\r\n", "incr foo \r\n"}) {
+        parser.Reset();
+        EXPECT_THROW(parser.Parse(command, consumed), std::runtime_error) << command;
+    }
+}
+
+TEST(MemcachedParserTest, Resize) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("cache_memlimit 64\r\n", consumed));
+    ASSERT_EQ(19, consumed);
+
+    size_t value_size = 1;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    Execute::Resize *tmp = dynamic_cast<Execute::Resize *>(cmd.get());
+    ASSERT_FALSE(tmp == nullptr);
+    ASSERT_EQ(0, value_size);
+    ASSERT_EQ(64, tmp->amount());
+    ASSERT_FALSE(tmp->shards());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("cache_shards 8\r\n", consumed));
+    cmd = parser.Build(value_size);
+    tmp = dynamic_cast<Execute::Resize *>(cmd.get());
+    ASSERT_FALSE(tmp == nullptr);
+    ASSERT_EQ(8, tmp->amount());
+    ASSERT_TRUE(tmp->shards());
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("cache_memlimit\r\n", consumed), std::runtime_error);
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("cache_memlimit 64M\r\n", consumed), std::runtime_error);
+}
@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "storage/CoreLRU.h"
+
+using namespace Afina::Backend;
+
+TEST(CoreLRUTest, InvalidConfig) { EXPECT_THROW(CoreLRU(0, 16 * 1024 * 1024), std::runtime_error); }
+
+TEST(CoreLRUTest, PutGetDelete) {
+    CoreLRU storage(4, 4 * 1024 * 1024, IndexType::Hash);
+
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val"));
+    EXPECT_TRUE(storage.Set("KEY1", "val101"));
+    EXPECT_TRUE(storage.Delete("KEY2"));
+    EXPECT_TRUE(storage.Append("KEY3", "_a"));
+
+    uint64_t counter = 0;
+    EXPECT_TRUE(storage.Put("COUNTER", "10"));
+    EXPECT_EQ(CoreLRU::CounterResult::Stored, storage.Incr("COUNTER", 5, counter));
+    EXPECT_EQ(15, counter);
+
+    Afina::PinnedValue pinned;
+    uint64_t cas = 0;
+    EXPECT_TRUE(storage.GetCas("KEY1", pinned, cas));
+    EXPECT_EQ("val101", pinned.str());
+    EXPECT_EQ(CoreLRU::CasResult::Stored, storage.CompareAndSet("KEY1", "val102", cas));
+    EXPECT_EQ(CoreLRU::CasResult::Exists, storage.CompareAndSet("KEY1", "val103", cas));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val102", value);
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_EQ("val3_a", value);
+    for (int i = 4; i < 100; ++i) {
+        EXPECT_TRUE(storage.Get("KEY" + std::to_string(i), value));
+        EXPECT_EQ("val" + std::to_string(i), value);
+    }
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+    std::map<std::string, std::string> values(stats.begin(), stats.end());
+    EXPECT_EQ("100", values["curr_items"]);
+}
+
+TEST(CoreLRUTest, Batch) {
+    CoreLRU storage(4, 4 * 1024 * 1024);
+
+    std::vector<std::pair<std::string, std::string>> items;
+    std::vector<std::string> keys;
+    for (int i = 0; i < 100; ++i) {
+        items.emplace_back("KEY" + std::to_string(i), "val" + std::to_string(i));
+        keys.push_back("KEY" + std::to_string(i));
+    }
+    EXPECT_EQ(100, storage.MultiPut(items));
+    EXPECT_EQ(50, storage.MultiDelete(std::vector<std::string>(keys.begin(), keys.begin() + 50)));
+
+    std::vector<Afina::PinnedValue> values;
+    std::vector<uint64_t> cas;
+    storage.MultiGet(keys, values, &cas);
+    ASSERT_EQ(100, values.size());
+    for (int i = 0; i < 100; ++i) {
+        if (i < 50) {
+            EXPECT_FALSE(values[i]);
+        } else {
+            EXPECT_EQ("val" + std::to_string(i), values[i].str());
+            EXPECT_NE(0, cas[i]);
+        }
+    }
+}
+
+TEST(CoreLRUTest, ConcurrentAccess) {
+    CoreLRU storage(4, 4 * 1024 * 1024);
+
+    std::atomic<int> errors(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&storage, &errors, t] {
+            for (int i = 0; i < 5000; ++i) {
+                std::string key = "KEY" + std::to_string(t) + "_" + std::to_string(i % 100);
+                std::string value;
+                storage.Put(key, std::to_string(i));
+                if (!storage.Get(key, value) || value != std::to_string(i)) {
+                    errors++;
+                }
+                if (i % 7 == 0) {
+                    storage.Delete(key);
+                }
+            }
+        });
+    }
+
+    // Freeze in the middle of the load sees no changes while action runs
+    std::size_t frozen = 0;
+    storage.Freeze([&]() {
+        storage.Scan([&](const char *, std::size_t, const char *, std::size_t, int32_t) { frozen++; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::size_t again = 0;
+        storage.Scan([&](const char *, std::size_t, const char *, std::size_t, int32_t) { again++; });
+        EXPECT_EQ(frozen, again);
+    });
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, errors.load());
+}
@@ -0,0 +1,190 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "storage/LockFreeLRU.h"
+
+using namespace Afina::Backend;
+
+static std::map<std::string, std::string> get_stats(LockFreeLRU &storage) {
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+    return std::map<std::string, std::string>(stats.begin(), stats.end());
+}
+
+class ManualClockLockFree : public LockFreeLRU {
+public:
+    ManualClockLockFree(size_t max_size) : LockFreeLRU(max_size), now(0) {}
+
+    uint32_t now;
+
+protected:
+    uint32_t Now() const override { return now; }
+};
+
+TEST(LockFreeLRUTest, PutGetDelete) {
+    LockFreeLRU storage(64 * 1024);
+
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val"));
+    EXPECT_TRUE(storage.Set("KEY1", "val101"));
+    EXPECT_FALSE(storage.Set("KEY100", "val"));
+    EXPECT_TRUE(storage.Delete("KEY2"));
+    EXPECT_FALSE(storage.Delete("KEY2"));
+    EXPECT_FALSE(storage.Put("KEY3", std::string(64 * 1024, 'x')));
+    EXPECT_TRUE(storage.Put("KEY4", "val", -1));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY4", "val", -1));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val101", value);
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_FALSE(storage.Get("KEY4", value));
+    for (int i = 5; i < 100; ++i) {
+        EXPECT_TRUE(storage.Get("KEY" + std::to_string(i), value));
+        EXPECT_EQ("val" + std::to_string(i), value);
+    }
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_EQ("val3", value);
+    EXPECT_EQ("98", get_stats(storage)["curr_items"]);
+}
+
+TEST(LockFreeLRUTest, Evict) {
+    const std::size_t length = 20;
+    LockFreeLRU storage(100 * 2 * length);
+
+    for (int i = 0; i < 1000; ++i) {
+        std::string key = "KEY" + std::string(length - 7, '_') + std::to_string(1000 + i);
+        ASSERT_TRUE(storage.Put(key, std::string(length, 'a' + i % 26)));
+
+        std::string value;
+        EXPECT_TRUE(storage.Get(key, value));
+        EXPECT_TRUE(storage.Get("KEY" + std::string(length - 7, '_') + "1000", value));
+    }
+
+    auto stats = get_stats(storage);
+    EXPECT_GE(100, std::stoul(stats["curr_items"]));
+    EXPECT_GE(100 * 2 * length, std::stoul(stats["bytes"]));
+    EXPECT_LT(0, std::stoul(stats["evictions"]));
+
+    // Key read on every step has its reference bit set each time the hand comes
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY" + std::string(length - 7, '_') + "1000", value));
+}
+
+TEST(LockFreeLRUTest, PinnedValueOutlivesUpdate) {
+    LockFreeLRU storage(64 * 1024);
+    EXPECT_TRUE(storage.Put("KEY", "val1"));
+
+    Afina::PinnedValue pinned;
+    uint64_t cas = 0;
+    EXPECT_TRUE(storage.GetCas("KEY", pinned, cas));
+    EXPECT_NE(0, cas);
+
+    // Retired items get reclaimed in batches, pinned one lives on until the handle is gone
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put("KEY", "val" + std::to_string(i)));
+    }
+    EXPECT_EQ("val1", pinned.str());
+    EXPECT_GT(1000, std::stoul(get_stats(storage)["retired_items"]));
+    EXPECT_EQ(Afina::Storage::CasResult::Exists, storage.CompareAndSet("KEY", "val", cas));
+}
+
+TEST(LockFreeLRUTest, Update) {
+    ManualClockLockFree storage(64 * 1024);
+    using CasResult = LockFreeLRU::CasResult;
+    using CounterResult = LockFreeLRU::CounterResult;
+
+    EXPECT_FALSE(storage.Append("KEY1", "val"));
+    EXPECT_TRUE(storage.Put("KEY1", "val", 10));
+    EXPECT_TRUE(storage.Append("KEY1", "_a"));
+    EXPECT_TRUE(storage.Prepend("KEY1", "p_"));
+
+    Afina::PinnedValue value;
+    uint64_t cas = 0;
+    EXPECT_TRUE(storage.GetCas("KEY1", value, cas));
+    EXPECT_EQ("p_val_a", value.str());
+    EXPECT_EQ(CasResult::NotFound, storage.CompareAndSet("KEY2", "val", cas));
+    EXPECT_EQ(CasResult::Stored, storage.CompareAndSet("KEY1", "1", cas, 10));
+    EXPECT_EQ(CasResult::Exists, storage.CompareAndSet("KEY1", "2", cas));
+
+    uint64_t counter = 0;
+    EXPECT_EQ(CounterResult::Stored, storage.Incr("KEY1", 10, counter));
+    EXPECT_EQ(11, counter);
+    EXPECT_EQ(CounterResult::Stored, storage.Decr("KEY1", 20, counter));
+    EXPECT_EQ(0, counter);
+    EXPECT_TRUE(storage.Put("KEY2", "val"));
+    EXPECT_EQ(CounterResult::NotNumber, storage.Incr("KEY2", 1, counter));
+
+    // Expiration time is kept by updates
+    storage.now = 10;
+    std::string str;
+    EXPECT_FALSE(storage.Get("KEY1", str));
+    EXPECT_EQ(CounterResult::NotFound, storage.Incr("KEY1", 1, counter));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "val"));
+}
+
+TEST(LockFreeLRUTest, FreezeThrows) {
+    LockFreeLRU storage(64 * 1024);
+
+    // Exception of the action releases stripes, so writers go on
+    EXPECT_THROW(storage.Freeze([]() { throw std::runtime_error("fork failed"); }), std::runtime_error);
+    EXPECT_TRUE(storage.Put("KEY", "val"));
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY", value));
+    EXPECT_EQ("val", value);
+}
+
+TEST(LockFreeLRUTest, ConcurrentAccess) {
+    LockFreeLRU storage(64 * 1024);
+
+    // Memory is short, so that eviction races with readers and writers
+    std::atomic<int> errors(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&storage, &errors, t] {
+            for (int i = 0; i < 20000; ++i) {
+                std::string key = "KEY" + std::to_string((t * 7919 + i) % 3000);
+                Afina::PinnedValue value;
+                switch (i % 4) {
+                case 0:
+                    storage.Put(key, key + "_value");
+                    break;
+                case 1:
+                    storage.Append(key, "");
+                    break;
+                case 2:
+                    storage.Delete(key);
+                    break;
+                default:
+                    if (storage.GetPinned(key, value) && value.str() != key + "_value") {
+                        errors++;
+                    }
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, errors.load());
+
+    std::size_t items = 0, bytes = 0;
+    EXPECT_TRUE(storage.Scan([&](const char *key, std::size_t key_size, const char *value, std::size_t value_size,
+                                 int32_t ttl) {
+        items++;
+        bytes += key_size + value_size;
+        EXPECT_EQ(std::string(key, key_size) + "_value", std::string(value, value_size));
+    }));
+    auto stats = get_stats(storage);
+    EXPECT_EQ(std::to_string(items), stats["curr_items"]);
+    EXPECT_EQ(std::to_string(bytes), stats["bytes"]);
+}
@@ -0,0 +1,302 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "storage/LoggedStorage.h"
+#include "storage/StripedLRU.h"
+#include "storage/ThreadSafeSimpleLRU.h"
+
+using namespace Afina::Backend;
+
+static std::string log_path(const std::string &name) {
+    return "/tmp/afina_" + name + "_" + std::to_string(::getpid()) + ".log";
+}
+
+static std::map<std::string, std::string> get_stats(Afina::Storage &storage) {
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+    return std::map<std::string, std::string>(stats.begin(), stats.end());
+}
+
+static std::unique_ptr<LoggedStorage> open_logged(const std::string &path, SyncPolicy policy,
+                                                  std::size_t compact_size = 64 * 1024 * 1024) {
+    std::unique_ptr<LoggedStorage> storage(new LoggedStorage(std::make_shared<ThreadSafeSimplLRU>(1024 * 1024),
+                                                             path, policy, std::chrono::milliseconds(10),
+                                                             compact_size));
+    storage->Start();
+    return storage;
+}
+
+TEST(MutationLogTest, Replay) {
+    std::string path = log_path("replay");
+    for (auto policy : {SyncPolicy::None, SyncPolicy::Interval, SyncPolicy::Always}) {
+        std::remove(path.c_str());
+        {
+            auto storage = open_logged(path, policy);
+            EXPECT_EQ(0, storage->Replayed());
+            for (int i = 0; i < 100; ++i) {
+                ASSERT_TRUE(storage->Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+            }
+            EXPECT_TRUE(storage->Set("KEY1", "val101"));
+            EXPECT_FALSE(storage->Set("KEY100", "val"));
+            EXPECT_FALSE(storage->PutIfAbsent("KEY1", "val"));
+            EXPECT_TRUE(storage->Delete("KEY2"));
+            EXPECT_TRUE(storage->Put("TTL", "val", 100));
+            EXPECT_TRUE(storage->Put("KEY3", "val", -1));
+            EXPECT_TRUE(storage->Append("KEY4", "_a"));
+            EXPECT_TRUE(storage->Prepend("KEY4", "p_"));
+            EXPECT_FALSE(storage->Append("KEY100", "_a"));
+            uint64_t counter;
+            EXPECT_TRUE(storage->Put("COUNTER", "10"));
+            EXPECT_EQ(Afina::Storage::CounterResult::Stored, storage->Incr("COUNTER", 5, counter));
+            EXPECT_EQ(Afina::Storage::CounterResult::Stored, storage->Decr("COUNTER", 3, counter));
+            EXPECT_EQ(Afina::Storage::CounterResult::NotNumber, storage->Incr("KEY5", 1, counter));
+            storage->Stop();
+        }
+
+        auto storage = open_logged(path, policy);
+        EXPECT_EQ(109, storage->Replayed());
+
+        std::string value;
+        EXPECT_TRUE(storage->Get("KEY1", value));
+        EXPECT_EQ("val101", value);
+        EXPECT_FALSE(storage->Get("KEY2", value));
+        EXPECT_FALSE(storage->Get("KEY3", value));
+        EXPECT_FALSE(storage->Get("KEY100", value));
+        EXPECT_TRUE(storage->Get("TTL", value));
+        EXPECT_TRUE(storage->Get("KEY4", value));
+        EXPECT_EQ("p_val4_a", value);
+        EXPECT_TRUE(storage->Get("COUNTER", value));
+        EXPECT_EQ("12", value);
+        for (int i = 5; i < 100; ++i) {
+            EXPECT_TRUE(storage->Get("KEY" + std::to_string(i), value));
+            EXPECT_EQ("val" + std::to_string(i), value);
+        }
+        storage->Stop();
+    }
+    std::remove(path.c_str());
+}
+
+TEST(MutationLogTest, CounterReplay) {
+    std::string path = log_path("counter");
+    std::remove(path.c_str());
+    {
+        ThreadSafeSimplLRU storage(1024 * 1024);
+        MutationLog log(path, SyncPolicy::Always);
+        log.Start(storage);
+        log.Wait(log.Put("COUNTER", "10", 100));
+        log.Wait(log.Counter("COUNTER", 15));
+        log.Stop();
+    }
+
+    // Counter record replayed over the counter it has already set changes nothing
+    ThreadSafeSimplLRU storage(1024 * 1024);
+    MutationLog log(path);
+    EXPECT_EQ(2, log.Replay(storage));
+    EXPECT_EQ(2, log.Replay(storage));
+    std::string value;
+    EXPECT_TRUE(storage.Get("COUNTER", value));
+    EXPECT_EQ("15", value);
+
+    // Expiration time of the counter stays as it is
+    std::size_t counters = 0;
+    storage.Scan([&](const char *, std::size_t, const char *, std::size_t, int32_t ttl) {
+        counters++;
+        EXPECT_GT(ttl, 0);
+    });
+    EXPECT_EQ(1, counters);
+    std::remove(path.c_str());
+}
+
+TEST(MutationLogTest, TornTail) {
+    std::string path = log_path("torn");
+    std::remove(path.c_str());
+    {
+        auto storage = open_logged(path, SyncPolicy::Always);
+        ASSERT_TRUE(storage->Put("KEY1", "val1"));
+        ASSERT_TRUE(storage->Put("KEY2", "val2"));
+        storage->Stop();
+    }
+
+    // Crash in the middle of the record
+    std::ofstream(path, std::ios::app) << "garbage";
+    {
+        auto storage = open_logged(path, SyncPolicy::Always);
+        EXPECT_EQ(2, storage->Replayed());
+        ASSERT_TRUE(storage->Put("KEY3", "val3"));
+        storage->Stop();
+    }
+
+    // Tail was cut off, so records written after it are found
+    auto storage = open_logged(path, SyncPolicy::Always);
+    EXPECT_EQ(3, storage->Replayed());
+    std::string value;
+    EXPECT_TRUE(storage->Get("KEY3", value));
+    storage->Stop();
+    std::remove(path.c_str());
+}
+
+TEST(MutationLogTest, GroupCommit) {
+    std::string path = log_path("group");
+    std::remove(path.c_str());
+
+    const int threads = 8, writes = 200;
+    {
+        std::unique_ptr<LoggedStorage> storage(
+            new LoggedStorage(std::shared_ptr<StripedLRU>(StripedLRU::create_cache(4, 4 * 1024 * 1024)), path,
+                              SyncPolicy::Always));
+        storage->Start();
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&storage, t]() {
+                for (int i = 0; i < writes; ++i) {
+                    storage->Put("KEY" + std::to_string(t) + "_" + std::to_string(i), "val" + std::to_string(i));
+                }
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        // Each write is synced before it returns, but concurrent writers share syncs
+        auto stats = get_stats(*storage);
+        EXPECT_LT(std::stoul(stats["log_syncs"]), threads * writes);
+        EXPECT_EQ("0", stats["log_errors"]);
+        storage->Stop();
+    }
+
+    std::unique_ptr<LoggedStorage> storage(new LoggedStorage(
+        std::shared_ptr<StripedLRU>(StripedLRU::create_cache(4, 4 * 1024 * 1024)), path, SyncPolicy::Always));
+    storage->Start();
+    EXPECT_EQ(threads * writes, storage->Replayed());
+    std::string value;
+    EXPECT_TRUE(storage->Get("KEY7_199", value));
+    EXPECT_EQ("val199", value);
+    storage->Stop();
+    std::remove(path.c_str());
+}
+
+TEST(MutationLogTest, Compaction) {
+    std::string path = log_path("compact");
+    std::remove(path.c_str());
+    {
+        // Small threshold: log gets compacted by itself once it doubles
+        auto storage = open_logged(path, SyncPolicy::Interval, 64 * 1024);
+        for (int round = 0; round < 100; ++round) {
+            for (int i = 0; i < 50; ++i) {
+                ASSERT_TRUE(storage->Put("KEY" + std::to_string(i), std::string(100, 'a' + round % 26)));
+            }
+        }
+        ASSERT_TRUE(storage->Delete("KEY0"));
+
+        for (int i = 0; i < 500 && get_stats(*storage)["log_compactions"] == "0"; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        auto stats = get_stats(*storage);
+        EXPECT_NE("0", stats["log_compactions"]);
+
+        // Compaction forked while writes went on could keep all of them in the tail, the one done after
+        // them keeps the image only
+        std::string compactions = stats["log_compactions"];
+        storage->Compact();
+        for (int i = 0; i < 500 && get_stats(*storage)["log_compactions"] == compactions; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        stats = get_stats(*storage);
+        EXPECT_NE(compactions, stats["log_compactions"]);
+        EXPECT_EQ("0", stats["log_errors"]);
+        EXPECT_LT(std::stoul(stats["log_bytes"]), 100 * 50 * 100);
+
+        ASSERT_TRUE(storage->Put("KEY1", "last"));
+        storage->Stop();
+    }
+
+    auto storage = open_logged(path, SyncPolicy::Interval);
+    std::string value;
+    EXPECT_FALSE(storage->Get("KEY0", value));
+    EXPECT_TRUE(storage->Get("KEY1", value));
+    EXPECT_EQ("last", value);
+    EXPECT_TRUE(storage->Get("KEY49", value));
+    EXPECT_EQ(std::string(100, 'a' + 99 % 26), value);
+    storage->Stop();
+    std::remove(path.c_str());
+}
+
+// Storage which lingers after applying an append, so that compaction is likely to fork meanwhile
+class SlowAppend : public Afina::Storage {
+public:
+    SlowAppend() : _storage(1024 * 1024) {}
+
+    bool Put(const std::string &key, const std::string &value, int32_t ttl) override {
+        return _storage.Put(key, value, ttl);
+    }
+    bool PutIfAbsent(const std::string &key, const std::string &value, int32_t ttl) override {
+        return _storage.PutIfAbsent(key, value, ttl);
+    }
+    bool Set(const std::string &key, const std::string &value, int32_t ttl) override {
+        return _storage.Set(key, value, ttl);
+    }
+    bool Delete(const std::string &key) override { return _storage.Delete(key); }
+    bool Get(const std::string &key, std::string &value) override { return _storage.Get(key, value); }
+    bool Append(const std::string &key, const std::string &data) override {
+        bool result = _storage.Append(key, data);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        return result;
+    }
+    bool Scan(const Visitor &visitor) override { return _storage.Scan(visitor); }
+    void Freeze(const std::function<void()> &action) override { _storage.Freeze(action); }
+
+private:
+    ThreadSafeSimplLRU _storage;
+};
+
+TEST(MutationLogTest, AppendDuringCompaction) {
+    std::string path = log_path("append");
+    std::remove(path.c_str());
+
+    const int appends = 200;
+    {
+        std::unique_ptr<LoggedStorage> storage(new LoggedStorage(std::make_shared<SlowAppend>(), path,
+                                                                 SyncPolicy::Interval, std::chrono::milliseconds(10)));
+        storage->Start();
+        ASSERT_TRUE(storage->Put("KEY", ""));
+
+        // Images are forked while appends are applied, each append must get into the log exactly once
+        std::atomic<bool> done(false);
+        std::thread writer([&storage, &done]() {
+            for (int i = 0; i < appends; ++i) {
+                storage->Append("KEY", "a");
+            }
+            done = true;
+        });
+        while (!done) {
+            storage->Compact();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        writer.join();
+
+        auto stats = get_stats(*storage);
+        EXPECT_NE("0", stats["log_compactions"]);
+        EXPECT_EQ("0", stats["log_errors"]);
+        storage->Stop();
+    }
+
+    auto storage = open_logged(path, SyncPolicy::Interval);
+    std::string value;
+    EXPECT_TRUE(storage->Get("KEY", value));
+    EXPECT_EQ(std::string(appends, 'a'), value);
+    storage->Stop();
+    std::remove(path.c_str());
+}
@@ -0,0 +1,180 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <afina/concurrency/ThreadLocal.h>
+
+#include "storage/NearCache.h"
+#include "storage/ThreadSafeSimpleLRU.h"
+
+using namespace Afina::Backend;
+
+static std::map<std::string, std::string> get_stats(Afina::Storage &storage) {
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+    return std::map<std::string, std::string>(stats.begin(), stats.end());
+}
+
+TEST(NearCacheTest, ThreadLocal) {
+    Afina::Concurrency::ThreadLocal<int> local;
+    local.local() = 1;
+
+    std::thread other([&local] {
+        EXPECT_EQ(0, local.local());
+        local.local() = 2;
+        int sum = 0;
+        local.for_each([&sum](int &value) { sum += value; });
+        EXPECT_EQ(3, sum);
+    });
+    other.join();
+
+    // Instance of finished thread is gone
+    int count = 0;
+    local.for_each([&count](int &value) { count++; });
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(1, local.local());
+}
+
+TEST(NearCacheTest, HitAndInvalidate) {
+    NearCache storage(std::make_shared<ThreadSafeSimplLRU>(1024 * 1024), 16);
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+
+    std::string value;
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(storage.Get("KEY1", value));
+        EXPECT_EQ("val1", value);
+    }
+    auto stats = get_stats(storage);
+    EXPECT_EQ("2", stats["near_hits"]);
+    EXPECT_EQ("1", stats["near_misses"]);
+
+    // Writes of another thread are seen once they are done
+    std::thread writer([&storage] {
+        EXPECT_TRUE(storage.Set("KEY1", "val2"));
+        uint64_t counter = 0;
+        EXPECT_TRUE(storage.Put("COUNTER", "1"));
+        EXPECT_EQ(NearCache::CounterResult::Stored, storage.Incr("COUNTER", 1, counter));
+    });
+    writer.join();
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val2", value);
+    EXPECT_TRUE(storage.Get("COUNTER", value));
+    EXPECT_EQ("2", value);
+
+    Afina::PinnedValue pinned;
+    uint64_t cas = 0;
+    EXPECT_TRUE(storage.GetCas("KEY1", pinned, cas));
+    EXPECT_EQ(NearCache::CasResult::Stored, storage.CompareAndSet("KEY1", "val3", cas));
+    EXPECT_TRUE(storage.GetCas("KEY1", pinned, cas));
+    EXPECT_EQ("val3", pinned.str());
+    EXPECT_EQ(NearCache::CasResult::Stored, storage.CompareAndSet("KEY1", "val4", cas));
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_EQ(1, storage.MultiPut({{"KEY1", "val5"}}));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val5", value);
+}
+
+TEST(NearCacheTest, MultiGet) {
+    NearCache storage(std::make_shared<ThreadSafeSimplLRU>(1024 * 1024), 16);
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    std::vector<Afina::PinnedValue> values;
+    std::vector<uint64_t> cas;
+    storage.MultiGet({"KEY1", "KEY3", "KEY2"}, values, &cas);
+    ASSERT_EQ(3, values.size());
+    EXPECT_EQ("val1", values[0].str());
+    EXPECT_FALSE(values[1]);
+    EXPECT_EQ("val2", values[2].str());
+    EXPECT_NE(0, cas[0]);
+    EXPECT_NE(0, cas[2]);
+    EXPECT_EQ("1", get_stats(storage)["near_hits"]);
+
+    // Keys missed in the batch are cached as well
+    storage.MultiGet({"KEY2"}, values);
+    EXPECT_EQ("val2", values[0].str());
+    EXPECT_EQ("2", get_stats(storage)["near_hits"]);
+}
+
+TEST(NearCacheTest, MaxAge) {
+    auto backend = std::make_shared<ThreadSafeSimplLRU>(1024 * 1024);
+    NearCache storage(backend, 16, std::chrono::milliseconds(20));
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+
+    // Changes made behind the decorator are seen once cached copy gets old
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(backend->Delete("KEY1"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TEST(NearCacheTest, HotKeyStays) {
+    NearCache storage(std::make_shared<ThreadSafeSimplLRU>(1024 * 1024), 1);
+    EXPECT_TRUE(storage.Put("HOT", "hot"));
+    EXPECT_TRUE(storage.Put("COLD", "cold"));
+
+    std::string value;
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(storage.Get("HOT", value));
+    }
+    // Rare key is served from the storage and doesn't replace the hot one
+    EXPECT_TRUE(storage.Get("COLD", value));
+    EXPECT_EQ("cold", value);
+    EXPECT_TRUE(storage.Get("HOT", value));
+    EXPECT_EQ("hot", value);
+    EXPECT_EQ("5", get_stats(storage)["near_hits"]);
+}
+
+TEST(NearCacheTest, ConcurrentAccess) {
+    NearCache storage(std::make_shared<ThreadSafeSimplLRU>(1024 * 1024), 64);
+    EXPECT_TRUE(storage.Put("HOT", "0"));
+
+    // Value of the hot key only grows, readers never see it going back
+    std::atomic<bool> stop(false);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&storage, &stop, &errors, t] {
+            int last = 0;
+            std::string value;
+            for (int i = 0; !stop; ++i) {
+                std::string key = "KEY" + std::to_string(t) + "_" + std::to_string(i % 10);
+                storage.Put(key, std::to_string(i));
+                if (!storage.Get(key, value) || value != std::to_string(i)) {
+                    errors++;
+                }
+
+                if (!storage.Get("HOT", value) || std::stoi(value) < last) {
+                    errors++;
+                } else {
+                    last = std::stoi(value);
+                }
+            }
+        });
+    }
+
+    for (int i = 1; i <= 2000; ++i) {
+        EXPECT_TRUE(storage.Set("HOT", std::to_string(i)));
+    }
+    stop = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(0, errors.load());
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("HOT", value));
+    EXPECT_EQ("2000", value);
+}
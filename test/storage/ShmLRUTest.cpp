@@ -0,0 +1,149 @@
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "storage/ShmLRU.h"
+
+using namespace Afina::Backend;
+
+static std::string segment_path(const std::string &name) {
+    return "/dev/shm/afina_test_" + name + "_" + std::to_string(::getpid());
+}
+
+static std::map<std::string, std::string> get_stats(ShmLRU &storage) {
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+    return std::map<std::string, std::string>(stats.begin(), stats.end());
+}
+
+TEST(ShmLRUTest, PutGetDelete) {
+    std::string path = segment_path("basic");
+    ShmLRU::Remove(path);
+    ShmLRU storage(path, 64 * 1024, 4096);
+    EXPECT_FALSE(storage.Attached());
+
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val"));
+    EXPECT_TRUE(storage.Set("KEY1", "val101"));
+    EXPECT_FALSE(storage.Set("KEY100", "val"));
+    EXPECT_TRUE(storage.Delete("KEY2"));
+    EXPECT_FALSE(storage.Delete("KEY2"));
+    EXPECT_TRUE(storage.Put("KEY3", std::string(1000, 'x')));
+    EXPECT_FALSE(storage.Put("KEY4", std::string(4096, 'x')));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val101", value);
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_EQ(std::string(1000, 'x'), value);
+    for (int i = 4; i < 100; ++i) {
+        EXPECT_TRUE(storage.Get("KEY" + std::to_string(i), value));
+        EXPECT_EQ("val" + std::to_string(i), value);
+    }
+    EXPECT_EQ("99", get_stats(storage)["curr_items"]);
+    ShmLRU::Remove(path);
+}
+
+TEST(ShmLRUTest, Evict) {
+    std::string path = segment_path("evict");
+    ShmLRU::Remove(path);
+    ShmLRU storage(path, 64 * 1024, 4096);
+
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(1000 + i), std::string(100, 'a' + i % 26)));
+        if (i > 0) {
+            std::string value;
+            EXPECT_TRUE(storage.Get("KEY1000", value));
+        }
+    }
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1000", value));
+    EXPECT_FALSE(storage.Get("KEY1001", value));
+    for (int i = 990; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Get("KEY" + std::to_string(1000 + i), value));
+        EXPECT_EQ(std::string(100, 'a' + i % 26), value);
+    }
+    ShmLRU::Remove(path);
+}
+
+TEST(ShmLRUTest, Reattach) {
+    std::string path = segment_path("reattach");
+    ShmLRU::Remove(path);
+    Afina::PinnedValue pinned;
+    uint64_t cas = 0;
+    {
+        ShmLRU storage(path, 64 * 1024, 4096);
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+        }
+        ASSERT_TRUE(storage.Delete("KEY0"));
+        ASSERT_TRUE(storage.Put("TTL", "val", 100));
+        ASSERT_TRUE(storage.GetCas("KEY1", pinned, cas));
+
+        // Segment is owned by a single process at a time
+        EXPECT_THROW(ShmLRU(path, 64 * 1024, 4096), std::runtime_error);
+    }
+
+    // Segment gets mapped at another address, offsets stay valid
+    ShmLRU storage(path, 64 * 1024, 4096);
+    EXPECT_TRUE(storage.Attached());
+    EXPECT_EQ("100", get_stats(storage)["curr_items"]);
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY0", value));
+    EXPECT_TRUE(storage.Get("TTL", value));
+    for (int i = 1; i < 100; ++i) {
+        EXPECT_TRUE(storage.Get("KEY" + std::to_string(i), value));
+        EXPECT_EQ("val" + std::to_string(i), value);
+    }
+    EXPECT_TRUE(storage.Put("KEY0", "new"));
+
+    // Versions survive restart as well
+    EXPECT_EQ(ShmLRU::CasResult::Stored, storage.CompareAndSet("KEY1", "new", cas));
+    EXPECT_EQ(ShmLRU::CasResult::Exists, storage.CompareAndSet("KEY1", "newer", cas));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("new", value);
+    ShmLRU::Remove(path);
+}
+
+TEST(ShmLRUTest, WipeIncompatible) {
+    std::string path = segment_path("wipe");
+    ShmLRU::Remove(path);
+    {
+        ShmLRU storage(path, 64 * 1024, 4096);
+        ASSERT_TRUE(storage.Put("KEY", "val"));
+    }
+    {
+        // Other page size means other layout
+        ShmLRU storage(path, 64 * 1024, 2048);
+        EXPECT_FALSE(storage.Attached());
+        std::string value;
+        EXPECT_FALSE(storage.Get("KEY", value));
+        ASSERT_TRUE(storage.Put("KEY", "val"));
+    }
+
+    // Owner died in the middle of operation: busy flag follows magic and version in the header
+    int fd = ::open(path.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    uint32_t busy = 1;
+    ASSERT_EQ(sizeof(busy), ::pwrite(fd, &busy, sizeof(busy), 12));
+    ::close(fd);
+
+    ShmLRU storage(path, 64 * 1024, 2048);
+    EXPECT_FALSE(storage.Attached());
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY", value));
+    ShmLRU::Remove(path);
+}
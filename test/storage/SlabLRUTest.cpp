@@ -0,0 +1,243 @@
+#include "gtest/gtest.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <afina/allocator/Slab.h>
+
+#include "storage/SlabLRU.h"
+
+using namespace Afina::Backend;
+using Afina::Allocator::Slab;
+
+static std::map<std::string, std::string> get_stats(SlabLRU &storage) {
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+    return std::map<std::string, std::string>(stats.begin(), stats.end());
+}
+
+// Returns stats prefix of the class taking the most pages
+static std::string busiest_class(SlabLRU &storage) {
+    std::string prefix;
+    std::size_t pages = 0;
+    for (auto &stat : get_stats(storage)) {
+        auto colon = stat.first.find(':');
+        if (colon != std::string::npos && stat.first.substr(colon + 1) == "total_pages" &&
+            std::stoul(stat.second) > pages) {
+            prefix = stat.first.substr(0, colon + 1);
+            pages = std::stoul(stat.second);
+        }
+    }
+    return prefix;
+}
+
+TEST(SlabTest, Classes) {
+    std::vector<char> memory(64 * 1024);
+    Slab slab(memory.data(), memory.size(), 4096, 64, 1.25);
+
+    EXPECT_EQ(16, slab.free_pages());
+    EXPECT_EQ(64, slab.chunk_size(0));
+    EXPECT_EQ(4096, slab.chunk_size(slab.classes() - 1));
+    for (unsigned cls = 1; cls < slab.classes(); cls++) {
+        EXPECT_LT(slab.chunk_size(cls - 1), slab.chunk_size(cls));
+        EXPECT_EQ(0, slab.chunk_size(cls) % sizeof(void *));
+    }
+
+    EXPECT_EQ(0, slab.class_of(1));
+    EXPECT_EQ(0, slab.class_of(64));
+    EXPECT_EQ(1, slab.class_of(65));
+    EXPECT_EQ(int(slab.classes() - 1), slab.class_of(4096));
+    EXPECT_EQ(-1, slab.class_of(4097));
+}
+
+TEST(SlabTest, AllocFree) {
+    std::vector<char> memory(8 * 1024);
+    Slab slab(memory.data(), memory.size(), 4096, 64, 1.25);
+
+    // Class takes a page on demand and gives chunks of it until both pages are used
+    std::vector<void *> chunks;
+    for (void *p = slab.alloc(0); p != nullptr; p = slab.alloc(0)) {
+        chunks.push_back(p);
+    }
+    EXPECT_EQ(2 * slab.per_page(0), chunks.size());
+    EXPECT_EQ(2, slab.pages(0));
+    EXPECT_EQ(0, slab.free_pages());
+    EXPECT_EQ(nullptr, slab.alloc(1));
+
+    // Freed chunk is reused right away
+    slab.free(chunks[10]);
+    EXPECT_EQ(chunks[10], slab.alloc(0));
+    EXPECT_EQ(0u, slab.class_of(chunks[10]));
+}
+
+TEST(SlabTest, Reclaim) {
+    std::vector<char> memory(8 * 1024);
+    Slab slab(memory.data(), memory.size(), 4096, 64, 1.25);
+
+    std::vector<void *> chunks;
+    for (void *p = slab.alloc(0); p != nullptr; p = slab.alloc(0)) {
+        chunks.push_back(p);
+    }
+
+    // Page with the least used chunks goes back to the pool, used ones are released by the owner
+    for (std::size_t i = slab.per_page(0); i < chunks.size() - 1; i++) {
+        slab.free(chunks[i]);
+    }
+    std::vector<void *> released;
+    EXPECT_TRUE(slab.reclaim(0, [&](void *p) {
+        released.push_back(p);
+        slab.free(p);
+    }));
+    ASSERT_EQ(1, released.size());
+    EXPECT_EQ(chunks.back(), released[0]);
+    EXPECT_EQ(1, slab.pages(0));
+    EXPECT_EQ(1, slab.free_pages());
+    EXPECT_EQ(slab.per_page(0), slab.used(0));
+
+    // Page is free for any class now, chunks of the reclaimed page are out of the free list
+    EXPECT_NE(nullptr, slab.alloc(slab.classes() - 1));
+    EXPECT_EQ(nullptr, slab.alloc(0));
+}
+
+TEST(SlabLRUTest, PutGetDelete) {
+    for (auto index : {IndexType::Map, IndexType::Hash}) {
+        SlabLRU storage(64 * 1024, index, 4096);
+
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+        }
+        EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val"));
+        EXPECT_TRUE(storage.Set("KEY1", "val101"));
+        EXPECT_FALSE(storage.Set("KEY100", "val"));
+        EXPECT_TRUE(storage.Delete("KEY2"));
+        EXPECT_FALSE(storage.Delete("KEY2"));
+
+        // Value of other class moves the key into other chunk
+        EXPECT_TRUE(storage.Put("KEY3", std::string(1000, 'x')));
+
+        std::string value;
+        EXPECT_TRUE(storage.Get("KEY1", value));
+        EXPECT_EQ("val101", value);
+        EXPECT_FALSE(storage.Get("KEY2", value));
+        EXPECT_TRUE(storage.Get("KEY3", value));
+        EXPECT_EQ(std::string(1000, 'x'), value);
+        for (int i = 4; i < 100; ++i) {
+            EXPECT_TRUE(storage.Get("KEY" + std::to_string(i), value));
+            EXPECT_EQ("val" + std::to_string(i), value);
+        }
+        EXPECT_EQ("99", get_stats(storage)["curr_items"]);
+    }
+}
+
+TEST(SlabLRUTest, AppendPrepend) {
+    SlabLRU storage(64 * 1024, IndexType::Hash, 4096);
+
+    EXPECT_FALSE(storage.Append("KEY", "val"));
+    EXPECT_TRUE(storage.Put("KEY", "val"));
+
+    // Value grows within its chunk first, then moves through larger classes
+    std::string expected = "val";
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_TRUE(storage.Append("KEY", "a"));
+        EXPECT_TRUE(storage.Prepend("KEY", "p"));
+        expected = "p" + expected + "a";
+    }
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY", value));
+    EXPECT_EQ(expected, value);
+    EXPECT_EQ("1", get_stats(storage)["curr_items"]);
+
+    // Larger than the page
+    EXPECT_FALSE(storage.Append("KEY", std::string(4096, 'x')));
+    EXPECT_TRUE(storage.Get("KEY", value));
+    EXPECT_EQ(expected, value);
+}
+
+TEST(SlabLRUTest, GrowFullStorage) {
+    SlabLRU storage(64 * 1024, IndexType::Hash, 4096);
+
+    // All pages belong to the class of the item, growing value moves it to a class with no pages
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), std::string(100, 'a')));
+    }
+    std::string value;
+    EXPECT_TRUE(storage.Append("KEY999", std::string(1000, 'b')));
+    EXPECT_TRUE(storage.Get("KEY999", value));
+    EXPECT_EQ(std::string(100, 'a') + std::string(1000, 'b'), value);
+
+    // Other classes have pages now, item moves while it is still in place
+    uint64_t counter = 0;
+    EXPECT_TRUE(storage.Put("COUNTER", "9"));
+    EXPECT_TRUE(storage.Prepend("KEY999", std::string(1000, 'c')));
+    EXPECT_EQ(SlabLRU::CounterResult::Stored, storage.Incr("COUNTER", 1, counter));
+    EXPECT_EQ(10, counter);
+    EXPECT_TRUE(storage.Get("KEY999", value));
+    EXPECT_EQ(std::string(1000, 'c') + std::string(100, 'a') + std::string(1000, 'b'), value);
+    EXPECT_TRUE(storage.Get("COUNTER", value));
+    EXPECT_EQ("10", value);
+}
+
+TEST(SlabLRUTest, TooLarge) {
+    SlabLRU storage(64 * 1024, IndexType::Map, 4096);
+
+    EXPECT_FALSE(storage.Put("KEY", std::string(4096, 'x')));
+    EXPECT_TRUE(storage.Put("KEY", std::string(4000, 'x')));
+    EXPECT_FALSE(storage.Set("KEY", std::string(4096, 'x')));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY", value));
+    EXPECT_EQ(4000, value.size());
+}
+
+TEST(SlabLRUTest, EvictLRUOfClass) {
+    SlabLRU storage(64 * 1024, IndexType::Map, 4096);
+
+    // Same class items only, storage keeps the most recent ones
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(1000 + i), std::string(100, 'a' + i % 26)));
+        if (i > 0) {
+            std::string value;
+            EXPECT_TRUE(storage.Get("KEY1000", value));
+        }
+    }
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1000", value));
+    EXPECT_FALSE(storage.Get("KEY1001", value));
+    for (int i = 990; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Get("KEY" + std::to_string(1000 + i), value));
+        EXPECT_EQ(std::string(100, 'a' + i % 26), value);
+    }
+
+    std::string cls = busiest_class(storage);
+    auto stats = get_stats(storage);
+    EXPECT_EQ("16", stats[cls + "total_pages"]);
+    EXPECT_NE("0", stats[cls + "evictions"]);
+}
+
+TEST(SlabLRUTest, MovePages) {
+    SlabLRU storage(64 * 1024, IndexType::Hash, 4096);
+
+    // Small values take all pages first
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put("small" + std::to_string(i), std::string(100, 's')));
+    }
+    std::string small = busiest_class(storage);
+    EXPECT_EQ("16", get_stats(storage)[small + "total_pages"]);
+
+    // Then distribution changes, large values get pages of small ones
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put("large" + std::to_string(i), std::string(1500, 'l')));
+    }
+
+    std::string value;
+    for (int i = 990; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Get("large" + std::to_string(i), value));
+        EXPECT_EQ(std::string(1500, 'l'), value);
+    }
+
+    EXPECT_NE(small, busiest_class(storage));
+    EXPECT_LT(std::stoul(get_stats(storage)[small + "total_pages"]), 4);
+}
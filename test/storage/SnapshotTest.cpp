@@ -0,0 +1,125 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "storage/SimpleLRU.h"
+#include "storage/SlabLRU.h"
+#include "storage/Snapshot.h"
+#include "storage/StripedLRU.h"
+#include "storage/ThreadSafeSimpleLRU.h"
+
+using namespace Afina::Backend;
+
+static std::string snapshot_path(const std::string &name) {
+    return "/tmp/afina_" + name + "_" + std::to_string(::getpid()) + ".snap";
+}
+
+TEST(SnapshotTest, SaveLoad) {
+    std::string path = snapshot_path("save_load");
+    Snapshot snapshot(path);
+    {
+        ThreadSafeSimplLRU storage(1024 * 1024, IndexType::Hash);
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+        }
+        ASSERT_TRUE(storage.Put("TTL", "val", 100));
+        ASSERT_TRUE(snapshot.Save(storage));
+        EXPECT_FALSE(snapshot.Save(storage));
+
+        // Changes after fork don't get into the image
+        storage.Put("KEY0", "changed");
+        EXPECT_TRUE(snapshot.Wait());
+    }
+
+    SimpleLRU storage(1024 * 1024, IndexType::Map);
+    EXPECT_EQ(1001, snapshot.Load(storage));
+
+    std::string value;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Get("KEY" + std::to_string(i), value));
+        EXPECT_EQ("val" + std::to_string(i), value);
+    }
+    EXPECT_TRUE(storage.Get("TTL", value));
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, KeepsEvictionOrder) {
+    std::string path = snapshot_path("order");
+    Snapshot snapshot(path);
+    {
+        ThreadSafeSimplLRU storage(1024 * 1024);
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_TRUE(storage.Put("KEY" + std::to_string(i), "val"));
+        }
+        // KEY0 becomes the most recent one
+        std::string value;
+        ASSERT_TRUE(storage.Get("KEY0", value));
+        ASSERT_TRUE(snapshot.Save(storage));
+        ASSERT_TRUE(snapshot.Wait());
+    }
+
+    // Storage for 10 items keeps the most recent ones
+    SimpleLRU storage(10 * 7);
+    snapshot.Load(storage);
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY0", value));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, StripedStorage) {
+    std::string path = snapshot_path("striped");
+    Snapshot snapshot(path);
+    {
+        auto storage = StripedLRU::create_cache(4, 4 * 1024 * 1024);
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_TRUE(storage->Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+        }
+        ASSERT_TRUE(snapshot.Save(*storage));
+        ASSERT_TRUE(snapshot.Wait());
+    }
+
+    auto storage = StripedLRU::create_cache(4, 4 * 1024 * 1024);
+    EXPECT_EQ(1000, snapshot.Load(*storage));
+
+    std::string value;
+    EXPECT_TRUE(storage->Get("KEY500", value));
+    EXPECT_EQ("val500", value);
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, SlabStorage) {
+    std::string path = snapshot_path("slab");
+    Snapshot snapshot(path);
+    {
+        SlabLRU storage(64 * 1024, IndexType::Hash, 4096);
+        ASSERT_TRUE(storage.Put("small", "val"));
+        ASSERT_TRUE(storage.Put("large", std::string(2000, 'x')));
+        ASSERT_TRUE(snapshot.Save(storage));
+        ASSERT_TRUE(snapshot.Wait());
+    }
+
+    SlabLRU storage(64 * 1024, IndexType::Hash, 4096);
+    EXPECT_EQ(2, snapshot.Load(storage));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("large", value));
+    EXPECT_EQ(std::string(2000, 'x'), value);
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, MissingAndCorrupted) {
+    std::string path = snapshot_path("corrupted");
+    Snapshot snapshot(path);
+    SimpleLRU storage(1024);
+    EXPECT_EQ(0, snapshot.Load(storage));
+
+    std::ofstream(path) << "AFSNAP01 truncated";
+    EXPECT_THROW(snapshot.Load(storage), std::runtime_error);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,95 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "storage/CombinedLRU.h"
+#include "storage/CoreLRU.h"
+#include "storage/LockFreeLRU.h"
+#include "storage/StripedLRU.h"
+#include "storage/ThreadSafeSimpleLRU.h"
+
+using namespace Afina::Backend;
+
+/**
+ * Throughput of thread safe engines on memcached-like load: 90% of pinned reads, 10% of writes over a key
+ * set which fits into memory, keys are picked by each thread independently.
+ *
+ * Usage: runStorageBench [milliseconds per run] [max threads]
+ */
+static double run(Afina::Storage &storage, unsigned threads, std::chrono::milliseconds duration) {
+    const std::size_t keys = 100000;
+    for (std::size_t i = 0; i < keys; i++) {
+        storage.Put("key" + std::to_string(i), std::string(32, 'v'));
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<std::size_t> total(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&storage, &stop, &total, t] {
+            std::size_t ops = 0;
+            uint64_t x = 88172645463325252ull + t;
+            std::string value(32, 'w');
+            Afina::PinnedValue pinned;
+            while (!stop.load(std::memory_order_relaxed)) {
+                // xorshift, so that key choice costs next to nothing
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                std::string key = "key" + std::to_string(x % keys);
+                if (x % 10 == 0) {
+                    storage.Put(key, value);
+                } else {
+                    storage.GetPinned(key, pinned);
+                }
+                ops++;
+            }
+            total += ops;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    return total.load() / (duration.count() / 1000.0);
+}
+
+int main(int argc, char **argv) {
+    std::chrono::milliseconds duration(argc > 1 ? std::atoi(argv[1]) : 1000);
+    unsigned max_threads = argc > 2 ? std::atoi(argv[2]) : 64;
+    const std::size_t memory = 64 * 1024 * 1024;
+
+    std::vector<std::pair<std::string, std::function<std::unique_ptr<Afina::Storage>()>>> engines = {
+        {"mt_lru", [=]() { return std::unique_ptr<Afina::Storage>(new ThreadSafeSimplLRU(memory, IndexType::Hash)); }},
+        {"mt_fc", [=]() { return std::unique_ptr<Afina::Storage>(new CombinedLRU(memory, IndexType::Hash)); }},
+        {"mt_slru", [=]() { return std::unique_ptr<Afina::Storage>(
+                         StripedLRU::create_cache(16, memory, LockType::Mutex, IndexType::Hash)); }},
+        {"mt_lockfree", [=]() { return std::unique_ptr<Afina::Storage>(new LockFreeLRU(memory)); }},
+        {"mt_core", [=]() { return std::unique_ptr<Afina::Storage>(new CoreLRU(16, memory, IndexType::Hash)); }},
+    };
+
+    std::printf("%8s", "threads");
+    for (auto &engine : engines) {
+        std::printf(" %14s", engine.first.c_str());
+    }
+    std::printf("   (ops/s)\n");
+
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        std::printf("%8u", threads);
+        for (auto &engine : engines) {
+            std::unique_ptr<Afina::Storage> storage = engine.second();
+            std::printf(" %14.0f", run(*storage, threads, duration));
+            std::fflush(stdout);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -11,6 +11,7 @@
 #include <afina/execute/Set.h>
 
 #include "storage/SimpleLRU.h"
+#include "storage/TimerWheel.h"
 
 using namespace Afina::Backend;
 using namespace Afina::Execute;
@@ -195,3 +196,738 @@ TEST(StorageTest, MaxTest) {
         EXPECT_FALSE(storage.Get(key, res));
     }
 }
+
+TEST(StorageTest, HashIndexPutGetDelete) {
+    SimpleLRU storage(1024, IndexType::Hash);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val3"));
+    EXPECT_TRUE(storage.Set("KEY2", "val22"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "val1");
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_TRUE(value == "val22");
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+}
+
+TEST(StorageTest, HashIndexChurn) {
+    const size_t length = 20;
+    SimpleLRU storage(2 * 1000 * length, IndexType::Hash);
+
+    // Deletes in the middle of probe sequences must keep the rest of keys reachable
+    for (long i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Key " + std::to_string(i), length), pad_space("Val", length)));
+    }
+    for (long i = 0; i < 1000; i += 3) {
+        EXPECT_TRUE(storage.Delete(pad_space("Key " + std::to_string(i), length)));
+    }
+    for (long i = 0; i < 1000; ++i) {
+        std::string res;
+        EXPECT_EQ(i % 3 != 0, storage.Get(pad_space("Key " + std::to_string(i), length), res));
+    }
+
+    // Eviction removes nodes through the index as well
+    for (long i = 1000; i < 3000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Key " + std::to_string(i), length), pad_space("Val", length)));
+    }
+    for (long i = 2000; i < 3000; ++i) {
+        std::string res;
+        EXPECT_TRUE(storage.Get(pad_space("Key " + std::to_string(i), length), res));
+    }
+    for (long i = 0; i < 2000; ++i) {
+        std::string res;
+        EXPECT_FALSE(storage.Get(pad_space("Key " + std::to_string(i), length), res));
+    }
+}
+
+TEST(StorageTest, SwissIndexChurn) {
+    const size_t length = 20;
+    SimpleLRU storage(2 * 1000 * length, IndexType::Swiss);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val2"));
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+
+    // Keys live for a while and get deleted, so that full groups get deleted slots and table gets rebuilt
+    // in place from time to time
+    for (long i = 0; i < 20000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Key " + std::to_string(i), length), pad_space("Val", length)));
+        if (i >= 300) {
+            EXPECT_TRUE(storage.Delete(pad_space("Key " + std::to_string(i - 300), length)));
+        }
+    }
+    for (long i = 0; i < 20000; ++i) {
+        std::string res;
+        EXPECT_EQ(i >= 19700, storage.Get(pad_space("Key " + std::to_string(i), length), res));
+    }
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(std::make_pair(std::string("curr_items"), std::string("300")), stats.back());
+
+    // Eviction removes nodes through the index as well
+    for (long i = 20000; i < 22000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Key " + std::to_string(i), length), pad_space("Val", length)));
+    }
+    for (long i = 19700; i < 21000; ++i) {
+        std::string res;
+        EXPECT_FALSE(storage.Get(pad_space("Key " + std::to_string(i), length), res));
+    }
+    for (long i = 21000; i < 22000; ++i) {
+        std::string res;
+        EXPECT_TRUE(storage.Get(pad_space("Key " + std::to_string(i), length), res));
+    }
+}
+
+TEST(StorageTest, SetResizesValue) {
+    SimpleLRU storage(1024, IndexType::Hash);
+
+    EXPECT_TRUE(storage.Put("KEY1", "v"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+
+    // Value grows beyond node capacity, then shrinks back
+    std::string big(500, 'x');
+    EXPECT_TRUE(storage.Set("KEY1", big));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == big);
+
+    EXPECT_TRUE(storage.Put("KEY1", "small"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(value == "small");
+
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_TRUE(value == "val2");
+}
+
+TEST(StorageTest, PinnedValueOutlivesUpdate) {
+    SimpleLRU storage(1024, IndexType::Hash);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+
+    Afina::PinnedValue pinned;
+    EXPECT_FALSE(storage.GetPinned("KEY2", pinned));
+    EXPECT_FALSE(bool(pinned));
+    EXPECT_TRUE(storage.GetPinned("KEY1", pinned));
+    EXPECT_TRUE(bool(pinned));
+
+    // Same sized value would be written in place unless node is pinned
+    EXPECT_TRUE(storage.Set("KEY1", "val2"));
+    EXPECT_EQ("val1", pinned.str());
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val2", value);
+
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_EQ("val1", pinned.str());
+    pinned.reset();
+    EXPECT_FALSE(bool(pinned));
+}
+
+TEST(StorageTest, ClockSecondChance) {
+    // Room for exactly four items
+    SimpleLRU storage(4 * 8, IndexType::Hash, EvictionPolicy::Clock);
+    EXPECT_TRUE(storage.SharedReads());
+
+    for (int i = 1; i <= 4; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+
+    // Referenced items survive, the rest go in insertion order
+    EXPECT_TRUE(storage.Put("KEY5", "val5"));
+    EXPECT_TRUE(storage.Put("KEY6", "val6"));
+
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_FALSE(storage.Get("KEY4", value));
+    EXPECT_TRUE(storage.Get("KEY5", value));
+    EXPECT_TRUE(storage.Get("KEY6", value));
+    EXPECT_EQ("val6", value);
+}
+
+TEST(StorageTest, ClockSetKeepsNode) {
+    SimpleLRU storage(3 * 8, IndexType::Map, EvictionPolicy::Clock);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_TRUE(storage.Put("KEY3", "val3"));
+
+    // Growing value evicts others, but never the updated node itself
+    EXPECT_TRUE(storage.Set("KEY2", "val2val2val2"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_EQ("val2val2val2", value);
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TEST(StorageTest, SegmentedScanResistance) {
+    const size_t length = 20;
+    SimpleLRU storage(2 * 100 * length, IndexType::Hash, EvictionPolicy::Segmented);
+
+    // Hot set is read twice and gets into protected segment
+    for (long i = 0; i < 50; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Hot " + std::to_string(i), length), pad_space("Val", length)));
+    }
+    for (long i = 0; i < 50; ++i) {
+        std::string res;
+        EXPECT_TRUE(storage.Get(pad_space("Hot " + std::to_string(i), length), res));
+    }
+
+    // One pass scan much larger than the storage churns probation only
+    for (long i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Scan " + std::to_string(i), length), pad_space("Val", length)));
+    }
+
+    for (long i = 0; i < 50; ++i) {
+        std::string res;
+        EXPECT_TRUE(storage.Get(pad_space("Hot " + std::to_string(i), length), res));
+    }
+    std::string res;
+    EXPECT_TRUE(storage.Get(pad_space("Scan 999", length), res));
+    EXPECT_FALSE(storage.Get(pad_space("Scan 0", length), res));
+}
+
+TEST(StorageTest, SegmentedSetAndDelete) {
+    SimpleLRU storage(4 * 8, IndexType::Map, EvictionPolicy::Segmented);
+
+    for (int i = 1; i <= 4; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+
+    // Set hits node as well, growing value evicts probation nodes first
+    EXPECT_TRUE(storage.Set("KEY2", "val2val2"));
+    EXPECT_TRUE(storage.Delete("KEY3"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY2", value));
+    EXPECT_EQ("val2val2", value);
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_TRUE(storage.Get("KEY4", value));
+
+    // Protected segment gets demoted and evicted once probation is empty
+    EXPECT_TRUE(storage.Put("KEY5", std::string(20, 'x')));
+    EXPECT_TRUE(storage.Get("KEY5", value));
+    EXPECT_FALSE(storage.Get("KEY2", value));
+}
+
+// Stream of one-hit-wonders with popular keys read back once per two storage capacities
+long popular_hits(SimpleLRU &storage) {
+    const size_t length = 20;
+    long hits = 0;
+    for (long i = 0; i < 4000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Once " + std::to_string(i), length), pad_space("Val", length)));
+        if (i % 4 == 0) {
+            auto key = pad_space("Hot " + std::to_string(i / 4 % 50), length);
+            std::string res;
+            if (storage.Get(key, res)) {
+                hits++;
+            } else {
+                EXPECT_TRUE(storage.Put(key, pad_space("Val", length)));
+            }
+        }
+    }
+    return hits;
+}
+
+TEST(StorageTest, TinyLFUKeepsPopular) {
+    const size_t length = 20;
+    SimpleLRU lru(2 * 100 * length, IndexType::Map, EvictionPolicy::LRU);
+    SimpleLRU tiny_lfu(2 * 100 * length, IndexType::Map, EvictionPolicy::LRU, Admission::TinyLFU);
+    EXPECT_FALSE(tiny_lfu.SharedReads());
+
+    // LRU drops popular keys before they are read again, TinyLFU doesn't let one-hit-wonders in
+    long lru_hits = popular_hits(lru);
+    long tiny_lfu_hits = popular_hits(tiny_lfu);
+    EXPECT_LT(lru_hits, 100);
+    EXPECT_GT(tiny_lfu_hits, 800);
+
+    std::string res;
+    EXPECT_TRUE(tiny_lfu.Get(pad_space("Once 3999", length), res));
+    EXPECT_FALSE(tiny_lfu.Get(pad_space("Once 3000", length), res));
+}
+
+TEST(StorageTest, TinyLFUSetAndDelete) {
+    SimpleLRU storage(1024, IndexType::Hash, EvictionPolicy::Segmented, Admission::TinyLFU);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_TRUE(storage.Set("KEY1", std::string(500, 'x')));
+    EXPECT_TRUE(storage.Delete("KEY2"));
+    EXPECT_TRUE(storage.Put("KEY3", "val3"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(std::string(500, 'x'), value);
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_EQ("val3", value);
+}
+
+// Storage with time under test control
+class ManualClockLRU : public SimpleLRU {
+public:
+    ManualClockLRU(size_t max_size, EvictionPolicy policy = EvictionPolicy::LRU)
+        : SimpleLRU(max_size, IndexType::Hash, policy), now(0) {}
+
+    uint32_t now;
+
+protected:
+    uint32_t Now() const override { return now; }
+};
+
+TEST(StorageTest, ExpireLazy) {
+    ManualClockLRU storage(1024);
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1", 10));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+    EXPECT_TRUE(storage.Put("KEY3", "val3", -1));
+
+    std::string value;
+    storage.now = 9;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Get("KEY3", value));
+
+    // Expired key is absent for all operations
+    storage.now = 10;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Set("KEY1", "val11"));
+    EXPECT_TRUE(storage.PutIfAbsent("KEY1", "val12", 5));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val12", value);
+
+    // Update replaces expiration time
+    EXPECT_TRUE(storage.Set("KEY1", "val13"));
+    EXPECT_TRUE(storage.Put("KEY2", "val22", 1));
+    storage.now = 100;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Get("KEY2", value));
+    EXPECT_FALSE(storage.Delete("KEY2"));
+
+    // Negative ttl removes the key
+    EXPECT_TRUE(storage.Put("KEY1", "val14", -1));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TEST(StorageTest, ExpireActive) {
+    const size_t length = 20;
+    ManualClockLRU storage(2 * 1000 * length, EvictionPolicy::Clock);
+
+    for (long i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("Key " + std::to_string(i), length), pad_space("Val", length), i % 2 + 1));
+    }
+
+    // Nothing is due yet
+    EXPECT_EQ(0, storage.Expire(1000));
+
+    // Reclaim goes in bounded slices
+    storage.now = 1;
+    EXPECT_EQ(100, storage.Expire(100));
+    EXPECT_EQ(400, storage.Expire(1000));
+
+    std::string res;
+    EXPECT_FALSE(storage.Get(pad_space("Key 0", length), res));
+    EXPECT_TRUE(storage.Get(pad_space("Key 1", length), res));
+
+    storage.now = 5;
+    EXPECT_EQ(500, storage.Expire(1000));
+    EXPECT_FALSE(storage.Get(pad_space("Key 1", length), res));
+
+    // Freed space is available for new keys without eviction
+    for (long i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage.Put(pad_space("New " + std::to_string(i), length), pad_space("Val", length)));
+    }
+    EXPECT_TRUE(storage.Get(pad_space("New 0", length), res));
+}
+
+TEST(StorageTest, TimerWheelLevels) {
+    TimerWheel wheel;
+    std::vector<Node *> nodes;
+    std::vector<uint32_t> expires = {1, 63, 64, 65, 4095, 4096, 300000, 20000000};
+    for (uint32_t expire : expires) {
+        Node *node = Node::Create(std::string("key"), "value", 1);
+        node->expire = expire;
+        wheel.schedule(node);
+        nodes.push_back(node);
+    }
+    EXPECT_EQ(expires.size(), wheel.size());
+
+    // Each node is reported exactly at its second, however far it is
+    std::vector<uint32_t> fired;
+    uint32_t now = 0;
+    while (wheel.size() > 0) {
+        now++;
+        wheel.advance(now, 1000, [&](Node *node) {
+            EXPECT_EQ(node->expire, now);
+            fired.push_back(node->expire);
+        });
+    }
+    EXPECT_EQ(expires, fired);
+
+    for (Node *node : nodes) {
+        Node::Destroy(node);
+    }
+}
+
+TEST(StorageTest, TimerWheelCascadeBudget) {
+    TimerWheel wheel;
+    std::vector<Node *> nodes;
+    for (int i = 0; i < 10000; ++i) {
+        Node *node = Node::Create(std::string("key"), "value", 1);
+        node->expire = 100;
+        wheel.schedule(node);
+        nodes.push_back(node);
+    }
+    wheel.advance(63, 1000, [](Node *) { ADD_FAILURE(); });
+    EXPECT_EQ(63, wheel.now());
+
+    // All nodes sit in one slot of level 1, cascade at second 64 is spread over calls of small budget
+    std::size_t calls = 0;
+    while (wheel.now() < 64) {
+        wheel.advance(64, 10, [](Node *) { ADD_FAILURE(); });
+        calls++;
+    }
+    EXPECT_GE(calls, 10000 / 10);
+
+    std::size_t expired = 0;
+    while (wheel.size() > 0) {
+        expired += wheel.advance(100, 1000, [](Node *node) { EXPECT_EQ(100, node->expire); });
+    }
+    EXPECT_EQ(10000, expired);
+    EXPECT_EQ(100, wheel.now());
+
+    for (Node *node : nodes) {
+        Node::Destroy(node);
+    }
+}
+
+size_t stat_value(const std::vector<std::pair<std::string, std::string>> &stats, const std::string &name) {
+    for (auto &stat : stats) {
+        if (stat.first == name) {
+            return std::stoull(stat.second);
+        }
+    }
+    ADD_FAILURE() << "No stat " << name;
+    return 0;
+}
+
+TEST(StorageTest, PreciseAccounting) {
+    const size_t limit = 64 * 1024;
+    SimpleLRU payload(limit, IndexType::Map, EvictionPolicy::LRU, Admission::All, Accounting::Payload);
+    SimpleLRU precise(limit, IndexType::Map, EvictionPolicy::LRU, Admission::All, Accounting::Precise);
+
+    for (long i = 0; i < 10000; ++i) {
+        EXPECT_TRUE(payload.Put("Key" + std::to_string(i), "v"));
+        EXPECT_TRUE(precise.Put("Key" + std::to_string(i), "v"));
+    }
+
+    // Small items take several times more memory than their payload
+    std::vector<std::pair<std::string, std::string>> stats;
+    payload.GetStats(stats);
+    EXPECT_EQ(limit, stat_value(stats, "limit_maxbytes"));
+    EXPECT_LE(stat_value(stats, "bytes"), limit);
+    EXPECT_GT(stat_value(stats, "heap_bytes"), 3 * limit);
+
+    // Precise limit bounds real usage, so it keeps fewer items
+    stats.clear();
+    precise.GetStats(stats);
+    EXPECT_LE(stat_value(stats, "bytes"), limit);
+    EXPECT_LE(stat_value(stats, "heap_bytes"), limit);
+    EXPECT_GT(stat_value(stats, "heap_bytes"), limit / 10 * 9);
+    EXPECT_LT(stat_value(stats, "curr_items"), 1000);
+
+    std::string value;
+    EXPECT_TRUE(precise.Get("Key9999", value));
+    EXPECT_TRUE(precise.Set("Key9999", std::string(1000, 'x')));
+    EXPECT_TRUE(precise.Delete("Key9999"));
+    stats.clear();
+    precise.GetStats(stats);
+    EXPECT_LE(stat_value(stats, "heap_bytes"), limit);
+}
+
+TEST(StorageTest, CompareAndSet) {
+    SimpleLRU storage(1024, IndexType::Hash);
+    using CasResult = SimpleLRU::CasResult;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2"));
+
+    Afina::PinnedValue value;
+    uint64_t cas1 = 0, cas2 = 0;
+    EXPECT_TRUE(storage.GetCas("KEY1", value, cas1));
+    EXPECT_EQ("val1", value.str());
+    EXPECT_TRUE(storage.GetCas("KEY2", value, cas2));
+    EXPECT_NE(0, cas1);
+    EXPECT_NE(cas1, cas2);
+    EXPECT_FALSE(storage.GetCas("KEY3", value, cas2));
+
+    EXPECT_EQ(CasResult::NotFound, storage.CompareAndSet("KEY3", "val", cas1));
+    EXPECT_EQ(CasResult::NotStored, storage.CompareAndSet("KEY1", std::string(2048, 'x'), cas1));
+    EXPECT_EQ(CasResult::Stored, storage.CompareAndSet("KEY1", "val11", cas1));
+    // Value has new version now, even if it is updated in place
+    EXPECT_EQ(CasResult::Exists, storage.CompareAndSet("KEY1", "val12", cas1));
+
+    uint64_t cas = 0;
+    EXPECT_TRUE(storage.GetCas("KEY1", value, cas));
+    EXPECT_EQ("val11", value.str());
+    EXPECT_NE(cas1, cas);
+
+    // Any store changes version
+    EXPECT_TRUE(storage.Set("KEY1", "val13"));
+    EXPECT_EQ(CasResult::Exists, storage.CompareAndSet("KEY1", "val14", cas));
+    EXPECT_TRUE(storage.GetCas("KEY1", value, cas));
+    EXPECT_EQ(CasResult::Stored, storage.CompareAndSet("KEY1", "val15", cas, -1));
+    EXPECT_FALSE(storage.GetCas("KEY1", value, cas));
+}
+
+TEST(StorageTest, AppendPrepend) {
+    ManualClockLRU storage(64 * 1024);
+
+    EXPECT_FALSE(storage.Append("KEY1", "val"));
+    EXPECT_FALSE(storage.Prepend("KEY1", "val"));
+    EXPECT_TRUE(storage.Put("KEY1", "val", 10));
+
+    Afina::PinnedValue pinned;
+    uint64_t cas = 0;
+    EXPECT_TRUE(storage.GetCas("KEY1", pinned, cas));
+
+    // Pinned value stays the same, node gets reallocated
+    std::string expected = "val";
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(storage.Append("KEY1", std::to_string(i)));
+        EXPECT_TRUE(storage.Prepend("KEY1", "p"));
+        expected = "p" + expected + std::to_string(i);
+    }
+    EXPECT_EQ("val", pinned.str());
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(expected, value);
+    EXPECT_EQ(Afina::Storage::CasResult::Exists, storage.CompareAndSet("KEY1", "val", cas));
+
+    // Value doesn't fit into storage
+    EXPECT_FALSE(storage.Append("KEY1", std::string(64 * 1024, 'x')));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ(expected, value);
+
+    // Expiration time is kept
+    storage.now = 10;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Append("KEY1", "val"));
+}
+
+TEST(StorageTest, IncrDecr) {
+    ManualClockLRU storage(1024);
+    using CounterResult = SimpleLRU::CounterResult;
+
+    uint64_t counter = 0;
+    EXPECT_EQ(CounterResult::NotFound, storage.Incr("KEY1", 1, counter));
+    EXPECT_TRUE(storage.Put("KEY1", "9", 10));
+    EXPECT_TRUE(storage.Put("KEY2", "val"));
+    EXPECT_TRUE(storage.Put("KEY3", "18446744073709551615"));
+    EXPECT_TRUE(storage.Put("KEY4", "18446744073709551616"));
+    EXPECT_EQ(CounterResult::NotNumber, storage.Incr("KEY2", 1, counter));
+    EXPECT_EQ(CounterResult::NotNumber, storage.Decr("KEY4", 1, counter));
+
+    Afina::PinnedValue pinned;
+    uint64_t cas = 0;
+    EXPECT_TRUE(storage.GetCas("KEY1", pinned, cas));
+
+    EXPECT_EQ(CounterResult::Stored, storage.Incr("KEY1", 1, counter));
+    EXPECT_EQ(10, counter);
+    EXPECT_EQ(CounterResult::Stored, storage.Incr("KEY1", 95, counter));
+    EXPECT_EQ(105, counter);
+    EXPECT_EQ(CounterResult::Stored, storage.Decr("KEY1", 6, counter));
+    EXPECT_EQ(99, counter);
+    EXPECT_EQ("9", pinned.str());
+    EXPECT_EQ(Afina::Storage::CasResult::Exists, storage.CompareAndSet("KEY1", "val", cas));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("99", value);
+
+    // Decrement stops at 0, increment wraps around
+    EXPECT_EQ(CounterResult::Stored, storage.Decr("KEY1", 100, counter));
+    EXPECT_EQ(0, counter);
+    EXPECT_EQ(CounterResult::Stored, storage.Incr("KEY3", 2, counter));
+    EXPECT_EQ(1, counter);
+    EXPECT_TRUE(storage.Get("KEY3", value));
+    EXPECT_EQ("1", value);
+
+    // Expiration time is kept
+    storage.now = 10;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_EQ(CounterResult::NotFound, storage.Incr("KEY1", 1, counter));
+}
+
+TEST(StorageTest, ShrinkBySlices) {
+    // Each item takes 15 bytes
+    SimpleLRU storage(100 * 15);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(100 + i), "value_" + std::to_string(100 + i)));
+    }
+
+    // Limit comes down slice by slice, writes in between evict only down to the limit reached so far
+    storage.SetMaxSize(50 * 15);
+    EXPECT_FALSE(storage.Shrink(10));
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(90 * 15, stat_value(stats, "limit_maxbytes"));
+    EXPECT_EQ(90 * 15, stat_value(stats, "bytes"));
+    EXPECT_TRUE(storage.Put("KEY200", "value_200"));
+
+    EXPECT_FALSE(storage.Shrink(10));
+    EXPECT_FALSE(storage.Shrink(10));
+    EXPECT_FALSE(storage.Shrink(10));
+    EXPECT_TRUE(storage.Shrink(10));
+    stats.clear();
+    storage.GetStats(stats);
+    EXPECT_EQ(50 * 15, stat_value(stats, "limit_maxbytes"));
+    EXPECT_EQ(50 * 15, stat_value(stats, "bytes"));
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY200", value));
+    EXPECT_TRUE(storage.Get("KEY151", value));
+    EXPECT_FALSE(storage.Get("KEY150", value));
+
+    // Growth is immediate
+    EXPECT_TRUE(storage.Resize(100 * 15));
+    for (int i = 0; i < 50; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(300 + i), "value_" + std::to_string(300 + i)));
+    }
+    EXPECT_TRUE(storage.Get("KEY151", value));
+}
+
+TEST(StorageTest, BorrowFromBudget) {
+    // Each item takes 15 bytes, budget is borrowed by chunks of 10 items
+    SimpleLRU storage(10 * 15);
+    MemoryBudget budget(25 * 15, 10 * 15);
+    storage.SetBudget(&budget);
+    for (int i = 0; i < 30; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(100 + i), "value_" + std::to_string(100 + i)));
+    }
+    EXPECT_EQ(5 * 15, budget.Free());
+    EXPECT_EQ(30 * 15, storage.Limit());
+
+    // The rest of the budget is less than a chunk, then storage evicts its own nodes
+    for (int i = 30; i < 40; ++i) {
+        EXPECT_TRUE(storage.Put("KEY" + std::to_string(100 + i), "value_" + std::to_string(100 + i)));
+    }
+    EXPECT_EQ(0, budget.Free());
+    EXPECT_EQ(35 * 15, storage.Limit());
+    EXPECT_EQ(35 * 15, storage.Size());
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY104", value));
+    EXPECT_TRUE(storage.Get("KEY105", value));
+    EXPECT_FALSE(storage.Put("KEY", std::string(36 * 15, 'a')));
+}
+
+TEST(StorageTest, Take) {
+    SimpleLRU storage;
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_TRUE(storage.Put("KEY2", "val2", 100));
+    EXPECT_TRUE(storage.Put("KEY3", "val3"));
+
+    std::vector<std::string> taken;
+    EXPECT_TRUE(storage.Take("KEY2", [&](const char *key, std::size_t key_size, const char *value,
+                                         std::size_t value_size, int32_t ttl) {
+        taken.push_back(std::string(key, key_size) + "=" + std::string(value, value_size));
+        EXPECT_EQ(100, ttl);
+    }));
+    EXPECT_FALSE(storage.Take("KEY2", [](const char *, std::size_t, const char *, std::size_t, int32_t) {}));
+
+    // Oldest go first, storage is empty once fewer than asked are taken
+    EXPECT_EQ(1, storage.TakeOldest(1, [&](const char *key, std::size_t key_size, const char *value,
+                                           std::size_t value_size, int32_t ttl) {
+        taken.push_back(std::string(key, key_size) + "=" + std::string(value, value_size));
+    }));
+    EXPECT_EQ(1, storage.TakeOldest(10, [&](const char *key, std::size_t key_size, const char *, std::size_t,
+                                            int32_t) { taken.push_back(std::string(key, key_size)); }));
+    EXPECT_EQ(std::vector<std::string>({"KEY2=val2", "KEY1=val1", "KEY3"}), taken);
+
+    std::string value;
+    EXPECT_FALSE(storage.Get("KEY1", value));
+    EXPECT_FALSE(storage.Get("KEY3", value));
+}
+
+TEST(StorageTest, AdoptLargeValue) {
+    SimpleLRU storage(1024 * 1024, IndexType::Map, EvictionPolicy::LRU, Admission::All, Accounting::Precise);
+
+    // Large value passed as rvalue keeps its buffer
+    std::string value(4096, 'a');
+    const char *buffer = value.data();
+    EXPECT_TRUE(storage.Put("KEY1", std::move(value)));
+    Afina::PinnedValue pinned;
+    EXPECT_TRUE(storage.GetPinned("KEY1", pinned));
+    EXPECT_EQ(buffer, pinned.data());
+    EXPECT_EQ(std::string(4096, 'a'), pinned.str());
+
+    // Pinned view outlives replacement, value of the same size is copied in place once view is gone
+    std::string other(4000, 'b');
+    EXPECT_TRUE(storage.Set("KEY1", other));
+    EXPECT_EQ(std::string(4096, 'a'), pinned.str());
+    pinned = Afina::PinnedValue();
+    EXPECT_TRUE(storage.GetPinned("KEY1", pinned));
+    EXPECT_EQ(other, pinned.str());
+    pinned = Afina::PinnedValue();
+
+    // Copied value and value wasting much of its buffer are not adopted
+    EXPECT_TRUE(storage.Put("KEY2", other));
+    std::string wasteful(2048, 'c');
+    wasteful.reserve(8192);
+    buffer = wasteful.data();
+    EXPECT_TRUE(storage.Put("KEY3", std::move(wasteful)));
+    EXPECT_TRUE(storage.GetPinned("KEY3", pinned));
+    EXPECT_NE(buffer, pinned.data());
+    EXPECT_EQ(std::string(2048, 'c'), pinned.str());
+    pinned = Afina::PinnedValue();
+
+    // Adopted value is updated like any other
+    value.assign(2048, 'd');
+    buffer = value.data();
+    EXPECT_TRUE(storage.PutIfAbsent("KEY4", std::move(value)));
+    EXPECT_TRUE(storage.GetPinned("KEY4", pinned));
+    EXPECT_EQ(buffer, pinned.data());
+    pinned = Afina::PinnedValue();
+    EXPECT_TRUE(storage.Append("KEY4", "e"));
+    uint64_t cas = 0;
+    EXPECT_TRUE(storage.GetCas("KEY4", pinned, cas));
+    EXPECT_EQ(std::string(2048, 'd') + "e", pinned.str());
+    EXPECT_EQ(SimpleLRU::CasResult::Stored, storage.CompareAndSet("KEY4", std::string(3000, 'f'), cas));
+    EXPECT_TRUE(storage.Delete("KEY1"));
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.GetStats(stats);
+    EXPECT_EQ(3, stat_value(stats, "curr_items"));
+    EXPECT_GT(stat_value(stats, "heap_bytes"), 4000 + 2048 + 3000);
+
+    // Adopted value is charged for the string and all of its buffer, charge is given back on removal
+    SimpleLRU precise(1024 * 1024, IndexType::Map, EvictionPolicy::LRU, Admission::All, Accounting::Precise);
+    value.assign(4096, 'g');
+    value.resize(3500);
+    std::size_t capacity = value.capacity();
+    EXPECT_TRUE(precise.Put("KEY", std::move(value)));
+    stats.clear();
+    precise.GetStats(stats);
+    EXPECT_GE(stat_value(stats, "bytes"), capacity + sizeof(std::string));
+    EXPECT_TRUE(precise.Set("KEY", std::string(4000, 'h')));
+    EXPECT_TRUE(precise.Delete("KEY"));
+    stats.clear();
+    precise.GetStats(stats);
+    EXPECT_EQ(0, stat_value(stats, "bytes"));
+}
@@ -0,0 +1,344 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "storage/StripedLRU.h"
+
+using namespace Afina::Backend;
+
+TEST(StripedLRUTest, InvalidConfig) {
+    EXPECT_THROW(StripedLRU::create_cache(0, 16 * 1024 * 1024), std::runtime_error);
+    EXPECT_THROW(StripedLRU::create_cache(4, 1024 * 1024), std::runtime_error);
+}
+
+TEST(StripedLRUTest, PutGetDelete) {
+    for (auto lock : {LockType::Mutex, LockType::RW, LockType::Spin}) {
+        auto storage = StripedLRU::create_cache(4, 4 * 1024 * 1024, lock, IndexType::Hash);
+
+        for (int i = 0; i < 100; ++i) {
+            EXPECT_TRUE(storage->Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+        }
+        EXPECT_FALSE(storage->PutIfAbsent("KEY1", "val"));
+        EXPECT_TRUE(storage->Set("KEY1", "val101"));
+        EXPECT_TRUE(storage->Delete("KEY2"));
+
+        std::string value;
+        EXPECT_TRUE(storage->Get("KEY1", value));
+        EXPECT_EQ("val101", value);
+        EXPECT_FALSE(storage->Get("KEY2", value));
+        for (int i = 3; i < 100; ++i) {
+            EXPECT_TRUE(storage->Get("KEY" + std::to_string(i), value));
+            EXPECT_EQ("val" + std::to_string(i), value);
+        }
+    }
+}
+
+TEST(StripedLRUTest, ConcurrentAccess) {
+    auto storage = StripedLRU::create_cache(8, 8 * 1024 * 1024, LockType::Spin);
+
+    std::atomic<int> errors(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&storage, &errors, t] {
+            for (int i = 0; i < 10000; ++i) {
+                std::string key = "KEY" + std::to_string(t) + "_" + std::to_string(i % 100);
+                std::string value;
+                storage->Put(key, std::to_string(i));
+                if (!storage->Get(key, value) || value != std::to_string(i)) {
+                    errors++;
+                }
+                if (i % 7 == 0) {
+                    storage->Delete(key);
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, errors.load());
+}
+
+TEST(StripedLRUTest, ClockSharedReads) {
+    auto storage = StripedLRU::create_cache(4, 4 * 1024 * 1024, LockType::RW, IndexType::Hash, EvictionPolicy::Clock);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(storage->Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+
+    std::atomic<int> errors(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&storage, &errors, t] {
+            for (int i = 0; i < 10000; ++i) {
+                int k = (i * 7 + t) % 100;
+                std::string value;
+                if (t == 0 && i % 10 == 0) {
+                    storage->Set("KEY" + std::to_string(k), "val" + std::to_string(k));
+                } else if (!storage->Get("KEY" + std::to_string(k), value) || value != "val" + std::to_string(k)) {
+                    errors++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, errors.load());
+}
+
+TEST(StripedLRUTest, ExpireWithSweeper) {
+    auto storage = StripedLRU::create_cache(4, 4 * 1024 * 1024, LockType::Mutex, IndexType::Hash);
+    storage->Start();
+
+    EXPECT_TRUE(storage->Put("KEY1", "val1", 3600));
+    EXPECT_TRUE(storage->Put("KEY2", "val2", -1));
+    EXPECT_FALSE(storage->PutIfAbsent("KEY1", "val11", 1));
+
+    std::string value;
+    EXPECT_TRUE(storage->Get("KEY1", value));
+    EXPECT_FALSE(storage->Get("KEY2", value));
+    EXPECT_EQ(0, storage->Expire(100));
+
+    storage->Stop();
+}
+
+TEST(StripedLRUTest, ShardStats) {
+    auto storage = StripedLRU::create_cache(2, 2 * 1024 * 1024, LockType::Mutex, IndexType::Hash,
+                                            EvictionPolicy::LRU, Admission::All, Accounting::Precise);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(storage->Put("KEY" + std::to_string(i), "val" + std::to_string(i)));
+    }
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage->GetStats(stats);
+
+    std::map<std::string, size_t> values;
+    for (auto &stat : stats) {
+        values[stat.first] = std::stoull(stat.second);
+    }
+    EXPECT_EQ(2 * 1024 * 1024, values["limit_maxbytes"]);
+    EXPECT_EQ(1024 * 1024, values["0:limit_maxbytes"]);
+    EXPECT_EQ(100, values["curr_items"]);
+    EXPECT_EQ(100, values["0:curr_items"] + values["1:curr_items"]);
+    EXPECT_EQ(values["bytes"], values["0:bytes"] + values["1:bytes"]);
+    // Precise accounting charges node headers as well
+    EXPECT_GT(values["bytes"], 100 * sizeof(Node));
+}
+
+TEST(StripedLRUTest, MultiKey) {
+    for (auto lock : {LockType::Mutex, LockType::RW}) {
+        for (auto policy : {EvictionPolicy::LRU, EvictionPolicy::Clock}) {
+            auto storage = StripedLRU::create_cache(4, 4 * 1024 * 1024, lock, IndexType::Hash, policy);
+
+            std::vector<std::pair<std::string, std::string>> items;
+            for (int i = 0; i < 100; ++i) {
+                items.emplace_back("KEY" + std::to_string(i), "val" + std::to_string(i));
+            }
+            // Last one wins
+            items.emplace_back("KEY1", "val101");
+            EXPECT_EQ(101, storage->MultiPut(items));
+            EXPECT_EQ(2, storage->MultiDelete({"KEY2", "KEY3", "KEY2", "KEY100"}));
+
+            std::vector<std::string> keys;
+            for (int i = 101; i >= 0; --i) {
+                keys.push_back("KEY" + std::to_string(i));
+            }
+            keys.push_back("KEY1");
+
+            std::vector<Afina::PinnedValue> values;
+            storage->MultiGet(keys, values);
+            ASSERT_EQ(keys.size(), values.size());
+            for (size_t i = 0; i < keys.size(); ++i) {
+                int n = std::stoi(keys[i].substr(3));
+                if (n >= 100 || n == 2 || n == 3) {
+                    EXPECT_FALSE(values[i]);
+                } else if (n == 1) {
+                    EXPECT_EQ("val101", values[i].str());
+                } else {
+                    EXPECT_EQ("val" + std::to_string(n), values[i].str());
+                }
+            }
+        }
+    }
+}
+
+TEST(StripedLRUTest, CasVersions) {
+    auto storage = StripedLRU::create_cache(4, 4 * 1024 * 1024);
+
+    std::vector<std::string> keys;
+    for (int i = 0; i < 100; ++i) {
+        keys.push_back("KEY" + std::to_string(i));
+        EXPECT_TRUE(storage->Put(keys.back(), "val"));
+    }
+
+    // Versions are unique across shards
+    std::vector<Afina::PinnedValue> values;
+    std::vector<uint64_t> cas;
+    storage->MultiGet(keys, values, &cas);
+    ASSERT_EQ(keys.size(), cas.size());
+    EXPECT_EQ(keys.size(), std::set<uint64_t>(cas.begin(), cas.end()).size());
+
+    EXPECT_EQ(StripedLRU::CasResult::Stored, storage->CompareAndSet("KEY7", "new", cas[7]));
+    EXPECT_EQ(StripedLRU::CasResult::Exists, storage->CompareAndSet("KEY7", "newer", cas[7]));
+
+    Afina::PinnedValue value;
+    uint64_t version;
+    EXPECT_TRUE(storage->GetCas("KEY7", value, version));
+    EXPECT_EQ("new", value.str());
+    EXPECT_NE(cas[7], version);
+}
+
+TEST(StripedLRUTest, Resize) {
+    auto storage = StripedLRU::create_cache(2, 4 * 1024 * 1024, LockType::Mutex, IndexType::Hash);
+    for (int i = 0; i < 4000; ++i) {
+        EXPECT_TRUE(storage->Put("KEY" + std::to_string(i), std::string(1000, 'a')));
+    }
+    EXPECT_FALSE(storage->Resize(1024 * 1024));
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    EXPECT_TRUE(storage->Resize(2 * 1024 * 1024));
+    storage->GetStats(stats);
+    std::map<std::string, std::string> values(stats.begin(), stats.end());
+    EXPECT_EQ(std::to_string(2 * 1024 * 1024), values["limit_maxbytes"]);
+    EXPECT_GE(2 * 1024 * 1024, std::stoull(values["bytes"]));
+
+    // The most recent keys survive the shrink, and freed space is usable again after growth
+    std::string value;
+    EXPECT_TRUE(storage->Get("KEY3999", value));
+    EXPECT_FALSE(storage->Get("KEY0", value));
+    EXPECT_TRUE(storage->Resize(8 * 1024 * 1024));
+    for (int i = 0; i < 4000; ++i) {
+        EXPECT_TRUE(storage->Put("KEY" + std::to_string(i), std::string(1000, 'b')));
+    }
+    EXPECT_TRUE(storage->Get("KEY0", value));
+}
+
+TEST(StripedLRUTest, Reshard) {
+    auto storage = StripedLRU::create_cache(2, 8 * 1024 * 1024, LockType::Mutex, IndexType::Hash);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage->Put("KEY" + std::to_string(i), "val" + std::to_string(i), i % 2 == 0 ? 3600 : 0));
+    }
+    Afina::PinnedValue pinned;
+    uint64_t cas = 0;
+    EXPECT_TRUE(storage->GetCas("KEY1", pinned, cas));
+
+    EXPECT_FALSE(storage->Reshard(0));
+    EXPECT_FALSE(storage->Reshard(16));
+    EXPECT_TRUE(storage->Reshard(8));
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage->GetStats(stats);
+    std::map<std::string, std::string> values(stats.begin(), stats.end());
+    EXPECT_EQ("1000", values["curr_items"]);
+    EXPECT_EQ(std::to_string(8 * 1024 * 1024), values["limit_maxbytes"]);
+    EXPECT_EQ(std::to_string(1024 * 1024), values["7:limit_maxbytes"]);
+
+    std::string value;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(storage->Get("KEY" + std::to_string(i), value));
+        EXPECT_EQ("val" + std::to_string(i), value);
+    }
+    std::size_t expiring = 0;
+    storage->Scan([&](const char *, std::size_t, const char *, std::size_t, int32_t ttl) { expiring += ttl > 0; });
+    EXPECT_EQ(500, expiring);
+
+    // Version issued before resharding never matches the one issued by new shard
+    EXPECT_EQ(StripedLRU::CasResult::Exists, storage->CompareAndSet("KEY1", "new", cas));
+    EXPECT_TRUE(storage->GetCas("KEY1", pinned, cas));
+    EXPECT_EQ(StripedLRU::CasResult::Stored, storage->CompareAndSet("KEY1", "new", cas));
+}
+
+TEST(StripedLRUTest, ReshardUnderLoad) {
+    auto storage = StripedLRU::create_cache(4, 16 * 1024 * 1024, LockType::Spin, IndexType::Hash);
+    for (int i = 0; i < 20000; ++i) {
+        storage->Put("KEY" + std::to_string(i), "val" + std::to_string(i));
+    }
+
+    // Each thread owns its keys, so it knows what each one must hold
+    std::atomic<bool> stop(false);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&storage, &stop, &errors, t] {
+            for (int i = 0; !stop.load(); i = (i + 1) % 5000) {
+                std::string key = "KEY" + std::to_string(t * 5000 + i);
+                std::string value;
+                if (!storage->Get(key, value)) {
+                    errors++;
+                } else if (value != "val" + std::to_string(t * 5000 + i)) {
+                    errors++;
+                }
+                uint64_t counter = 0;
+                storage->Put(key + "_counter", "0");
+                if (storage->Incr(key + "_counter", 1, counter) != StripedLRU::CounterResult::Stored || counter != 1) {
+                    errors++;
+                }
+                storage->Delete(key + "_counter");
+            }
+        });
+    }
+
+    for (std::size_t shards : {16, 3, 8}) {
+        EXPECT_TRUE(storage->Reshard(shards));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    stop = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, errors.load());
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage->GetStats(stats);
+    std::map<std::string, std::string> values(stats.begin(), stats.end());
+    EXPECT_EQ("20000", values["curr_items"]);
+}
+
+TEST(StripedLRUTest, Rebalance) {
+    auto storage = StripedLRU::create_cache(2, 4 * 1024 * 1024, LockType::Mutex, IndexType::Hash);
+    std::vector<std::string> cold, hot;
+    for (int i = 0; cold.size() < 2500 || hot.size() < 4000; ++i) {
+        std::string key = "KEY" + std::to_string(i);
+        (std::hash<std::string>()(key) % 2 == 0 ? cold : hot).push_back(key);
+    }
+
+    // Keys of the first shard get cold, the second shard is busy evicting fresh ones
+    std::string value(1000, 'a');
+    for (int i = 0; i < 2500; ++i) {
+        EXPECT_TRUE(storage->Put(cold[i], value));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+    for (int i = 0; i < 4000; ++i) {
+        EXPECT_TRUE(storage->Put(hot[i], value));
+    }
+    std::string found;
+    EXPECT_FALSE(storage->Get(hot[0], found));
+
+    // Chunk moved is borrowed once hot shard runs out of memory again, cold shard keeps half of its part
+    while (storage->Rebalance()) {
+        for (auto &key : hot) {
+            EXPECT_TRUE(storage->Put(key, value));
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage->GetStats(stats);
+    std::map<std::string, std::string> values(stats.begin(), stats.end());
+    EXPECT_EQ(std::to_string(4 * 1024 * 1024), values["limit_maxbytes"]);
+    EXPECT_GE(std::stoull(values["0:limit_maxbytes"]), 1024 * 1024);
+    EXPECT_LT(std::stoull(values["0:limit_maxbytes"]), 1024 * 1024 + 1024 * 1024 / 64);
+    EXPECT_LE(std::stoull(values["0:bytes"]), std::stoull(values["0:limit_maxbytes"]));
+
+    std::size_t hits = 0;
+    for (auto &key : hot) {
+        hits += storage->Get(key, found);
+    }
+    EXPECT_LT(2900, hits);
+    EXPECT_TRUE(storage->Get(cold[2499], found));
+}